@@ -0,0 +1,116 @@
+#include "blockpool.h"
+
+#include <sched.h>
+
+// 线程退出时把缓存的块还给全局链表
+struct BlockPool::ThreadCache {
+    std::vector<char*> blocks;
+    ~ThreadCache() {
+        BlockPool* pool = BlockPool::Instance();
+        for(char* b : blocks) {
+            pool->pooledBytes_ -= pool->blockSize_;
+            pool->ReleaseToGlobal_(b);
+        }
+    }
+};
+
+BlockPool* BlockPool::Instance() {
+    static BlockPool pool;
+    return &pool;
+}
+
+BlockPool::ThreadCache& BlockPool::LocalCache_() {
+    thread_local ThreadCache cache;
+    return cache;
+}
+
+void BlockPool::Init(size_t blockSize, size_t maxPooledBytes) {
+    std::lock_guard<std::mutex> locker(mtx_);
+    if(liveBytes_ == 0 && pooledBytes_ == 0) {
+        blockSize_ = blockSize;
+    }
+    maxPooledBytes_ = maxPooledBytes;
+}
+
+void BlockPool::SetNodes(const std::vector<int>& nodeOfCpu, int nodeCount) {
+    std::lock_guard<std::mutex> locker(mtx_);
+    if(liveBytes_ == 0 && pooledBytes_ == 0 && nodeCount > 0) {
+        nodeOfCpu_ = nodeOfCpu;
+        global_.assign(nodeCount, std::vector<char*>());
+    }
+}
+
+size_t BlockPool::CurrentNode_() const {
+    if(global_.size() == 1) { return 0; }
+    int cpu = sched_getcpu();
+    return cpu >= 0 && cpu < (int)nodeOfCpu_.size() ? nodeOfCpu_[cpu] % global_.size() : 0;
+}
+
+char* BlockPool::Allocate(size_t size, size_t* cap) {
+    if(size > blockSize_) {     // 超大块不进池
+        *cap = size;
+        liveBytes_ += size;
+        misses_++;
+        return new char[size];
+    }
+    *cap = blockSize_;
+    liveBytes_ += blockSize_;
+    ThreadCache& local = LocalCache_();
+    if(!local.blocks.empty()) {
+        char* b = local.blocks.back();
+        local.blocks.pop_back();
+        pooledBytes_ -= blockSize_;
+        hits_++;
+        return b;
+    }
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        // 先取本节点的，本节点没有再取其他节点的（总比向系统申请好）
+        size_t node = CurrentNode_();
+        for(size_t k = 0; k < global_.size(); k++) {
+            std::vector<char*>& list = global_[(node + k) % global_.size()];
+            if(!list.empty()) {
+                char* b = list.back();
+                list.pop_back();
+                pooledBytes_ -= blockSize_;
+                hits_++;
+                return b;
+            }
+        }
+    }
+    misses_++;
+    return new char[blockSize_];
+}
+
+void BlockPool::Release(char* block, size_t cap) {
+    if(!block) return;
+    liveBytes_ -= cap;
+    if(cap != blockSize_) {
+        delete[] block;
+        return;
+    }
+    ThreadCache& local = LocalCache_();
+    if(local.blocks.size() < LOCAL_BLOCKS) {
+        local.blocks.push_back(block);
+        pooledBytes_ += blockSize_;
+        return;
+    }
+    ReleaseToGlobal_(block);
+}
+
+// 全局空闲量超过上限时直接释放
+void BlockPool::ReleaseToGlobal_(char* block) {
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        if(pooledBytes_ + blockSize_ <= maxPooledBytes_) {
+            global_[CurrentNode_()].push_back(block);
+            pooledBytes_ += blockSize_;
+            return;
+        }
+    }
+    delete[] block;
+}
+
+BlockPool::Stats BlockPool::GetStats() const {
+    return Stats{ blockSize_, liveBytes_, pooledBytes_, maxPooledBytes_, hits_, misses_ };
+}
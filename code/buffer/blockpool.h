@@ -0,0 +1,80 @@
+#ifndef BLOCK_POOL_H
+#define BLOCK_POOL_H
+
+#include <stddef.h>
+#include <atomic>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+/*
+Buffer 块链使用的定长块内存池
+每个线程有自己的小缓存（无锁），多出来的块交给所在 NUMA 节点的空闲链表，全局空闲字节数有上限，
+超过上限的块直接还给系统；连接空闲时把块全部归还，RSS 跟着实际流量走而不是历史峰值
+*/
+class BlockPool {
+public:
+    struct Stats {
+        size_t blockSize;
+        size_t liveBytes;       // 正在被缓冲区使用的字节数（含超大块）
+        size_t pooledBytes;     // 空闲、留在池中备用的字节数（线程缓存 + 全局）
+        size_t maxPooledBytes;
+        size_t hits;            // 从池中拿到块的次数
+        size_t misses;          // 需要向系统申请的次数
+    };
+
+    static BlockPool* Instance();
+
+    // 块大小只能在第一次分配前设置
+    void Init(size_t blockSize, size_t maxPooledBytes);
+    // 按 NUMA 节点分开全局空闲链表，nodeOfCpu 下标为 CPU 编号；只能在第一次分配前设置
+    void SetNodes(const std::vector<int>& nodeOfCpu, int nodeCount);
+    size_t BlockSize() const { return blockSize_; }
+
+    // size <= BlockSize() 时分配一个标准块，否则向系统申请 size 字节；cap 返回实际容量
+    char* Allocate(size_t size, size_t* cap);
+    void Release(char* block, size_t cap);
+
+    Stats GetStats() const;
+
+private:
+    BlockPool() = default;
+
+    struct ThreadCache;
+    static ThreadCache& LocalCache_();
+    void ReleaseToGlobal_(char* block);
+    size_t CurrentNode_() const;
+
+    static const size_t LOCAL_BLOCKS = 32;  // 每个线程缓存的块数
+
+    size_t blockSize_ = 16 * 1024;
+    size_t maxPooledBytes_ = 64 << 20;
+
+    mutable std::mutex mtx_;
+    // 每个节点一条空闲链表：块由本节点的线程首次写入，物理页就在本节点，归还时也回到本节点
+    std::vector<std::vector<char*>> global_ = std::vector<std::vector<char*>>(1);
+    std::vector<int> nodeOfCpu_;
+
+    std::atomic<size_t> liveBytes_{0};
+    std::atomic<size_t> pooledBytes_{0};
+    std::atomic<size_t> hits_{0};
+    std::atomic<size_t> misses_{0};
+};
+
+// 把 BlockPool 包装成 pmr 上游，供请求级 monotonic arena 使用（块的对齐与 new char[] 相同）
+class BlockResource : public std::pmr::memory_resource {
+private:
+    void* do_allocate(size_t bytes, size_t align) override {
+        size_t cap = 0;
+        return BlockPool::Instance()->Allocate(bytes, &cap);
+    }
+    void do_deallocate(void* p, size_t bytes, size_t align) override {
+        size_t blockSize = BlockPool::Instance()->BlockSize();
+        BlockPool::Instance()->Release(static_cast<char*>(p), bytes > blockSize ? bytes : blockSize);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+#endif //BLOCK_POOL_H
@@ -1,26 +1,35 @@
 #include "buffer.h"
 
-// 读写下标初始化，vector<char>初始化
-Buffer::Buffer(int initBuffSize) : buffer_(initBuffSize), readPos_(0), writePos_(0)  {}  
+// 读写下标初始化，vector<char>初始化；链式模式不预分配，第一次写入时再申请块
+Buffer::Buffer(int initBuffSize, size_t blockSize)
+    : buffer_(blockSize ? 0 : initBuffSize), initSize_(blockSize ? 0 : initBuffSize),
+      readPos_(0), writePos_(0), blockSize_(blockSize) {}
 
-// 可写的数量：buffer大小 - 写下标
+// 可写的数量：buffer大小 - 写下标（链式模式为尾块剩余空间）
 size_t Buffer::WritableBytes() const {
+    if(IsChained()) {
+        return blocks_.empty() ? 0 : blocks_.back().cap - blocks_.back().writePos;
+    }
     return buffer_.size() - writePos_;
 }
 
 // 可读的数量：写下标 - 读下标
 size_t Buffer::ReadableBytes() const {
+    if(IsChained()) { return chainBytes_; }
     return writePos_ - readPos_;
 }
 
 // 可预留空间：已经读过的就没用了，等于读下标
 size_t Buffer::PrependableBytes() const {
+    if(IsChained()) { return blocks_.empty() ? 0 : blocks_.front().readPos; }
     return readPos_;
 }
 
 const char* Buffer::Peek() const {
-    
-    return &buffer_[readPos_];
+    if(IsChained()) {
+        return blocks_.empty() ? "" : blocks_.front().data.get() + blocks_.front().readPos;
+    }
+    return BeginPtr_() + readPos_;
 }
 
 // 确保可写的长度
@@ -33,12 +42,35 @@ void Buffer::EnsureWriteable(size_t len) {
 
 // 移动写下标，在Append中使用
 void Buffer::HasWritten(size_t len) {
+    if(IsChained()) {
+        blocks_.back().writePos += len;
+        chainBytes_ += len;
+        return;
+    }
     writePos_ += len;
 }
 
-// 读取len长度，移动读下标
+// 读取len长度，移动读下标；链式模式下读空的块直接释放
 void Buffer::Retrieve(size_t len) {
-    readPos_ += len;
+    assert(len <= ReadableBytes());
+    if(!IsChained()) {
+        readPos_ += len;
+        return;
+    }
+    chainBytes_ -= len;
+    while(len > 0) {
+        Block& front = blocks_.front();
+        size_t n = std::min(len, front.writePos - front.readPos);
+        front.readPos += n;
+        len -= n;
+        if(front.readPos == front.writePos) {
+            if(blocks_.size() == 1) {
+                front.readPos = front.writePos = 0;     // 最后一块留着复用
+            } else {
+                blocks_.pop_front();
+            }
+        }
+    }
 }
 
 // 读取到end位置
@@ -47,31 +79,61 @@ void Buffer::RetrieveUntil(const char* end) {
     Retrieve(end - Peek()); // end指针 - 读指针 长度
 }
 
-// 取出所有数据，buffer归零，读写下标归零,在别的函数中会用到
+// 取出所有数据，读写下标归零；旧数据不用清零，后面的写入会覆盖
 void Buffer::RetrieveAll() {
-    bzero(&buffer_[0], buffer_.size()); // 覆盖原本数据
     readPos_ = writePos_ = 0;
+    if(IsChained() && !blocks_.empty()) {
+        blocks_.erase(blocks_.begin() + 1, blocks_.end());
+        blocks_.front().readPos = blocks_.front().writePos = 0;
+        chainBytes_ = 0;
+    }
+}
+
+void Buffer::ReleaseIdle() {
+    if(ReadableBytes() > 0) { return; }
+    readPos_ = writePos_ = 0;
+    if(IsChained()) {
+        blocks_.clear();
+        chainBytes_ = 0;
+    } else if(buffer_.capacity() > initSize_) {
+        std::vector<char>(initSize_).swap(buffer_);
+    }
 }
 
 // 取出剩余可读的str
 std::string Buffer::RetrieveAllToStr() {
-    std::string str(Peek(), ReadableBytes());
+    std::string str;
+    if(IsChained()) {
+        str.reserve(chainBytes_);
+        for(const Block& b : blocks_) {
+            str.append(b.data.get() + b.readPos, b.writePos - b.readPos);
+        }
+    } else {
+        str.assign(Peek(), ReadableBytes());
+    }
     RetrieveAll();
     return str;
 }
 
 // 写指针的位置
 const char* Buffer::BeginWriteConst() const {
-    return &buffer_[writePos_];
+    if(IsChained()) {
+        return blocks_.empty() ? nullptr : blocks_.back().data.get() + blocks_.back().writePos;
+    }
+    return BeginPtr_() + writePos_;
 }
 
 char* Buffer::BeginWrite() {
-    return &buffer_[writePos_];
+    return const_cast<char*>(static_cast<const Buffer*>(this)->BeginWriteConst());
 }
 
 // 添加str到缓冲区
 void Buffer::Append(const char* str, size_t len) {
     assert(str);
+    if(IsChained()) {
+        AppendChain_(str, len);
+        return;
+    }
     EnsureWriteable(len);   // 确保可写的长度
     std::copy(str, str + len, BeginWrite());    // 将str放到写下标开始的地方
     HasWritten(len);    // 移动写下标
@@ -81,19 +143,33 @@ void Buffer::Append(const std::string& str) {
     Append(str.c_str(), str.size());
 }
 
-void Append(const void* data, size_t len) {
+void Buffer::Append(const char* str) {
+    Append(str, strlen(str));
+}
+
+void Buffer::Append(const void* data, size_t len) {
     Append(static_cast<const char*>(data), len);
 }
 
 // 将buffer中的读下标的地方放到该buffer中的写下标位置
-void Append(const Buffer& buff) {
-    Append(buff.Peek(), buff.ReadableBytes());
+void Buffer::Append(const Buffer& buff) {
+    if(!buff.IsChained()) {
+        Append(buff.Peek(), buff.ReadableBytes());
+        return;
+    }
+    for(const Block& b : buff.blocks_) {
+        Append(b.data.get() + b.readPos, b.writePos - b.readPos);
+    }
 }
 
 // 将fd的内容读到缓冲区，即writable的位置
 ssize_t Buffer::ReadFd(int fd, int* Errno) {
     char buff[65535];   // 栈区
     struct iovec iov[2];
+    // 链式模式：尾块快满时先挂一个新块，让 readv 直接读进链里
+    if(IsChained() && WritableBytes() < blockSize_ / 4) {
+        PushBlock_(blockSize_);
+    }
     size_t writeable = WritableBytes(); // 先记录能写多少
     // 分散读， 保证数据全部读完
     iov[0].iov_base = BeginWrite();
@@ -105,48 +181,69 @@ ssize_t Buffer::ReadFd(int fd, int* Errno) {
     if(len < 0) {
         *Errno = errno;
     } else if(static_cast<size_t>(len) <= writeable) {   // 若len小于writable，说明写区可以容纳len
-        writePos_ += len;   // 直接移动写下标
-    } else {    
-        writePos_ = buffer_.size(); // 写区写满了,下标移到最后
+        HasWritten(len);   // 直接移动写下标
+    } else {
+        HasWritten(writeable); // 写区写满了,下标移到最后
         Append(buff, static_cast<size_t>(len - writeable)); // 剩余的长度
     }
     return len;
 }
+
+// 与 ReadFd 相同的栈上溢出区，写区满时也不会因为读 0 字节被误判为对端关闭
 ssize_t Buffer::ReadFd_my(int fd, int* Errno) {
-    ssize_t len = recv(fd, BeginWrite(), WritableBytes(),0);
-    // std::cout<<"recv len="<<len<<std::endl;
-    all_sent+=len;
-    // std::cout<<"all_sent="<<all_sent<<std::endl;
-     if(len < 0) {
-        *Errno = errno;
-     }else{
-        writePos_ += len; 
-     }
+    ssize_t len = ReadFd(fd, Errno);
+    if(len > 0) {
+        all_sent += len;
+    }
     // LOG_BASE(0, HexDump(Peek(), 1024).c_str());
     return len;
 }
 
 // 将buffer中可读的区域写入fd中
 ssize_t Buffer::WriteFd(int fd, int* Errno) {
-    ssize_t len = write(fd, Peek(), ReadableBytes());
+    struct iovec iov[16];
+    int n = PeekIov(iov, 16);
+    ssize_t len = n == 1 ? write(fd, iov[0].iov_base, iov[0].iov_len) : writev(fd, iov, n);
     if(len < 0) {
         *Errno = errno;
         return len;
-    } 
+    }
     Retrieve(len);
     return len;
 }
 
+int Buffer::PeekIov(struct iovec* iov, int maxIov) const {
+    if(maxIov <= 0 || ReadableBytes() == 0) { return 0; }
+    if(!IsChained()) {
+        iov[0].iov_base = const_cast<char*>(Peek());
+        iov[0].iov_len = ReadableBytes();
+        return 1;
+    }
+    int n = 0;
+    for(const Block& b : blocks_) {
+        if(n == maxIov) { break; }
+        if(b.writePos == b.readPos) { continue; }
+        iov[n].iov_base = b.data.get() + b.readPos;
+        iov[n].iov_len = b.writePos - b.readPos;
+        n++;
+    }
+    return n;
+}
+
 char* Buffer::BeginPtr_() {
-    return &buffer_[0];
+    return buffer_.data();
 }
 
 const char* Buffer::BeginPtr_() const{
-    return &buffer_[0];
+    return buffer_.data();
 }
 
 // 扩展空间
 void Buffer::MakeSpace_(size_t len) {
+    if(IsChained()) {
+        PushBlock_(len);
+        return;
+    }
     if(WritableBytes() + PrependableBytes() < len) {
         buffer_.resize(writePos_ + len + 1);
     } else {
@@ -158,3 +255,37 @@ void Buffer::MakeSpace_(size_t len) {
     }
 }
 
+// 块大小固定为 blockSize_，单次要求更大时按需申请一个大块
+Buffer::Block Buffer::NewBlock_(size_t minSize) {
+    size_t cap = 0;
+    char* data = BlockPool::Instance()->Allocate(std::max(blockSize_, minSize), &cap);
+    return Block{std::unique_ptr<char[], BlockDeleter>(data, BlockDeleter{cap}), cap, 0, 0};
+}
+
+// 尾块没有数据时直接换掉，保证首块总是有数据（Peek 指向真正的第一个字节）
+void Buffer::PushBlock_(size_t minSize) {
+    if(!blocks_.empty() && blocks_.back().readPos == blocks_.back().writePos) {
+        Block& back = blocks_.back();
+        if(back.cap >= minSize) {
+            back.readPos = back.writePos = 0;
+        } else {
+            back = NewBlock_(minSize);
+        }
+        return;
+    }
+    blocks_.push_back(NewBlock_(minSize));
+}
+
+// 先填满尾块，剩下的放进新块，已有数据从不搬动
+void Buffer::AppendChain_(const char* str, size_t len) {
+    while(len > 0) {
+        if(WritableBytes() == 0) {
+            PushBlock_(blockSize_);
+        }
+        size_t n = std::min(len, WritableBytes());
+        std::copy(str, str + n, BeginWrite());
+        HasWritten(n);
+        str += n;
+        len -= n;
+    }
+}
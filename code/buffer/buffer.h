@@ -6,16 +6,27 @@
 #include <sys/uio.h> //readv
 #include <sys/socket.h> //recv
 #include <vector> //readv
-#include <atomic>
+#include <deque>
+#include <memory>
 #include <assert.h>
 // #include "../log/log.h"
 #include "../tool/Hex.h"
+#include "blockpool.h"
+
+/*
+两种存储方式：
+连续模式(blockSize == 0)：一段 vector，Peek() 起的可读数据总是连续的，供解析器 std::search 使用
+链式模式(blockSize > 0)：固定大小的块组成的链，大块 Append 只追加新块、不会 realloc 拷贝，
+  适合只需要发出去的写缓冲；Peek() 只保证首块内连续，发送时用 PeekIov 取出整条链交给 writev
+  块从 BlockPool 分配，读空或 ReleaseIdle() 时归还
+缓冲区只属于一个连接/一个线程，读写下标不需要原子操作
+*/
 class Buffer {
 public:
-    Buffer(int initBuffSize = 1024);
+    Buffer(int initBuffSize = 1024, size_t blockSize = 0);
     ~Buffer() = default;
 
-    size_t WritableBytes() const;       
+    size_t WritableBytes() const;
     size_t ReadableBytes() const ;
     size_t PrependableBytes() const;
 
@@ -33,6 +44,7 @@ public:
     char* BeginWrite();
 
     void Append(const std::string& str);
+    void Append(const char* str);       // 字面量直接追加，不构造临时 std::string
     void Append(const char* str, size_t len);
     void Append(const void* data, size_t len);
     void Append(const Buffer& buff);
@@ -42,14 +54,41 @@ public:
     ssize_t WriteFd(int fd, int* Errno);
     ssize_t all_sent=0;
 
+    // 连接空闲（没有待处理数据）时调用：块链全部还给内存池，连续存储缩回初始大小
+    void ReleaseIdle();
+
+    bool IsChained() const { return blockSize_ > 0; }
+    // 把可读数据按块填入 iov，返回用掉的 iov 个数（连续模式最多 1 个）
+    int PeekIov(struct iovec* iov, int maxIov) const;
+
 private:
     char* BeginPtr_();  // buffer开头
     const char* BeginPtr_() const;
     void MakeSpace_(size_t len);
 
-    std::vector<char> buffer_;  
-    std::atomic<std::size_t> readPos_;  // 读的下标
-    std::atomic<std::size_t> writePos_; // 写的下标
+    // 链式模式
+    struct BlockDeleter {
+        size_t cap;
+        void operator()(char* p) const { BlockPool::Instance()->Release(p, cap); }
+    };
+    struct Block {
+        std::unique_ptr<char[], BlockDeleter> data;
+        size_t cap;
+        size_t readPos;
+        size_t writePos;
+    };
+    Block NewBlock_(size_t minSize);
+    void PushBlock_(size_t minSize);
+    void AppendChain_(const char* str, size_t len);
+
+    std::vector<char> buffer_;
+    size_t initSize_;
+    size_t readPos_;  // 读的下标
+    size_t writePos_; // 写的下标
+
+    size_t blockSize_;
+    size_t chainBytes_ = 0;     // 链上可读的总字节数
+    std::deque<Block> blocks_;
 };
 
-#endif //BUFFER_H
\ No newline at end of file
+#endif //BUFFER_H
@@ -0,0 +1,140 @@
+#include "ringbuffer.h"
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <assert.h>
+#include <algorithm>
+#include <new>
+
+static size_t PageAlign(size_t len) {
+    static const size_t page = sysconf(_SC_PAGESIZE);
+    return std::max(page, (len + page - 1) / page * page);
+}
+
+RingBuffer::RingBuffer(size_t initBuffSize) {
+    cap_ = initCap_ = PageAlign(initBuffSize);
+    base_ = Map_(cap_);
+}
+
+RingBuffer::~RingBuffer() {
+    if(base_) { munmap(base_, cap_ * 2); }
+}
+
+// 先占一段 2*cap 的地址，再把 memfd 用 MAP_FIXED 映射到前后两半；映射建立后 fd 即可关闭
+char* RingBuffer::Map_(size_t cap) {
+    int fd = syscall(SYS_memfd_create, "ringbuffer", 0);
+    if(fd < 0) { throw std::bad_alloc(); }
+    if(ftruncate(fd, cap) != 0) {
+        close(fd);
+        throw std::bad_alloc();
+    }
+    void* addr = mmap(nullptr, cap * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(addr == MAP_FAILED) {
+        close(fd);
+        throw std::bad_alloc();
+    }
+    char* base = static_cast<char*>(addr);
+    if(mmap(base, cap, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+       mmap(base + cap, cap, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, cap * 2);
+        close(fd);
+        throw std::bad_alloc();
+    }
+    close(fd);
+    return base;
+}
+
+void RingBuffer::Remap_(size_t cap) {
+    size_t readable = ReadableBytes();
+    assert(cap >= readable);
+    char* base = Map_(cap);
+    std::copy(Peek(), Peek() + readable, base);
+    munmap(base_, cap_ * 2);
+    base_ = base;
+    cap_ = cap;
+    readPos_ = 0;
+    writePos_ = readable;
+}
+
+void RingBuffer::EnsureWriteable(size_t len) {
+    if(len > WritableBytes()) {
+        Remap_(PageAlign(std::max(cap_ * 2, ReadableBytes() + len)));
+    }
+}
+
+// 读位置越过第一份映射时整体减去 cap，数据本身不动
+void RingBuffer::Retrieve(size_t len) {
+    assert(len <= ReadableBytes());
+    readPos_ += len;
+    if(readPos_ >= cap_) {
+        readPos_ -= cap_;
+        writePos_ -= cap_;
+    }
+}
+
+void RingBuffer::RetrieveUntil(const char* end) {
+    assert(Peek() <= end);
+    Retrieve(end - Peek());
+}
+
+std::string RingBuffer::RetrieveAllToStr() {
+    std::string str(Peek(), ReadableBytes());
+    RetrieveAll();
+    return str;
+}
+
+void RingBuffer::Append(const char* str, size_t len) {
+    assert(str || len == 0);
+    EnsureWriteable(len);
+    std::copy(str, str + len, BeginWrite());
+    HasWritten(len);
+}
+
+ssize_t RingBuffer::ReadFd(int fd, int* Errno) {
+    char buff[65535];   // 栈区，容量不够时的溢出区
+    struct iovec iov[2];
+    size_t writeable = WritableBytes();
+    iov[0].iov_base = BeginWrite();
+    iov[0].iov_len = writeable;
+    iov[1].iov_base = buff;
+    iov[1].iov_len = sizeof(buff);
+
+    ssize_t len = readv(fd, iov, 2);
+    if(len < 0) {
+        *Errno = errno;
+    } else if(static_cast<size_t>(len) <= writeable) {
+        HasWritten(len);
+    } else {
+        HasWritten(writeable);
+        Append(buff, static_cast<size_t>(len) - writeable);
+    }
+    return len;
+}
+
+ssize_t RingBuffer::ReadFd_my(int fd, int* Errno) {
+    ssize_t len = ReadFd(fd, Errno);
+    if(len > 0) {
+        all_sent += len;
+    }
+    return len;
+}
+
+ssize_t RingBuffer::WriteFd(int fd, int* Errno) {
+    ssize_t len = write(fd, Peek(), ReadableBytes());
+    if(len < 0) {
+        *Errno = errno;
+        return len;
+    }
+    Retrieve(len);
+    return len;
+}
+
+void RingBuffer::ReleaseIdle() {
+    if(ReadableBytes() == 0 && cap_ > initCap_) {
+        Remap_(initCap_);
+    }
+    if(ReadableBytes() == 0) { RetrieveAll(); }
+}
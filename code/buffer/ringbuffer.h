@@ -0,0 +1,70 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <sys/types.h>
+#include "buffer.h"
+
+/*
+虚拟内存镜像环形缓冲区：同一个 memfd 在地址空间里连续映射两次，
+[base, base+cap) 与 [base+cap, base+2cap) 是同一块物理内存，
+所以从读位置开始的可读数据、从写位置开始的可写空间永远是连续的，不需要像 Buffer 那样搬数据压缩
+接口与 Buffer 的连续模式一致，可以直接给解析器 std::search
+*/
+class RingBuffer {
+public:
+    explicit RingBuffer(size_t initBuffSize = 4096);
+    ~RingBuffer();
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    size_t WritableBytes() const { return cap_ - (writePos_ - readPos_); }
+    size_t ReadableBytes() const { return writePos_ - readPos_; }
+    size_t PrependableBytes() const { return 0; }
+
+    const char* Peek() const { return base_ + readPos_; }
+    void EnsureWriteable(size_t len);
+    void HasWritten(size_t len) { writePos_ += len; }
+
+    void Retrieve(size_t len);
+    void RetrieveUntil(const char* end);
+    void RetrieveAll() { readPos_ = writePos_ = 0; }
+    std::string RetrieveAllToStr();
+
+    const char* BeginWriteConst() const { return base_ + writePos_; }
+    char* BeginWrite() { return base_ + writePos_; }
+
+    void Append(const std::string& str) { Append(str.data(), str.size()); }
+    void Append(const char* str) { Append(str, strlen(str)); }
+    void Append(const char* str, size_t len);
+    void Append(const void* data, size_t len) { Append(static_cast<const char*>(data), len); }
+
+    ssize_t ReadFd(int fd, int* Errno);
+    ssize_t ReadFd_my(int fd, int* Errno);
+    ssize_t WriteFd(int fd, int* Errno);
+    ssize_t all_sent = 0;
+
+    void ReleaseIdle();     // 空闲时缩回初始容量
+    size_t Capacity() const { return cap_; }
+
+private:
+    static char* Map_(size_t cap);
+    void Remap_(size_t cap);    // 换成容量为 cap 的新映射，保留可读数据
+
+    char* base_ = nullptr;
+    size_t cap_ = 0;
+    size_t initCap_ = 0;
+    size_t readPos_ = 0;    // 始终 < cap_
+    size_t writePos_ = 0;   // 始终 < readPos_ + cap_ <= 2 * cap_
+};
+
+// 连接读缓冲区使用的类型：编译时加 -DUSE_RING_BUFFER 切换为镜像环形缓冲区
+#ifdef USE_RING_BUFFER
+typedef RingBuffer StreamBuffer;
+#else
+typedef Buffer StreamBuffer;
+#endif
+
+#endif //RING_BUFFER_H
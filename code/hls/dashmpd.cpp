@@ -0,0 +1,132 @@
+#include "dashmpd.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <fstream>
+#include "../log/log.h"
+
+namespace {
+
+struct HlsMedia {
+    std::string init;                   // EXT-X-MAP 的 URI
+    std::string initRange;              // 单文件存储时 init 的字节区间 "a-b"，否则为空
+    std::vector<double> durations;
+    std::vector<std::string> segments;
+    std::vector<std::string> ranges;    // 各分片的字节区间，同上
+    double total = 0;
+};
+
+// HLS 的 "len@off" 转成 DASH 的 "first-last"
+std::string ToDashRange(unsigned long long len, unsigned long long off) {
+    return std::to_string(off) + "-" + std::to_string(off + len - 1);
+}
+
+bool ReadHlsMedia(const std::string& playlist, HlsMedia* media) {
+    std::ifstream in(playlist);
+    if(!in.is_open()) return false;
+    std::string line, range;
+    double dur = -1;
+    unsigned long long len = 0, off = 0, next = 0;
+    while(std::getline(in, line)) {
+        if(!line.empty() && line.back() == '\r') line.pop_back();
+        if(line.empty()) continue;
+        if(line.compare(0, 8, "#EXTINF:") == 0) {
+            dur = atof(line.c_str() + 8);
+        } else if(line.compare(0, 11, "#EXT-X-MAP:") == 0) {
+            size_t b = line.find("URI=\"");
+            size_t e = b == std::string::npos ? b : line.find('"', b + 5);
+            if(e != std::string::npos) media->init = line.substr(b + 5, e - b - 5);
+            b = line.find("BYTERANGE=\"");
+            if(b != std::string::npos && sscanf(line.c_str() + b + 11, "%llu@%llu", &len, &off) == 2) {
+                media->initRange = ToDashRange(len, off);
+            }
+        } else if(line.compare(0, 17, "#EXT-X-BYTERANGE:") == 0) {
+            off = next;
+            if(sscanf(line.c_str() + 17, "%llu@%llu", &len, &off) >= 1 && len > 0) {
+                range = ToDashRange(len, off);
+                next = off + len;
+            }
+        } else if(line[0] != '#' && dur >= 0) {
+            media->durations.push_back(dur);
+            media->segments.push_back(line);
+            media->ranges.push_back(range);
+            media->total += dur;
+            dur = -1;
+            range.clear();
+        }
+    }
+    return !media->init.empty() && !media->segments.empty();
+}
+
+// ISO 8601 时长，如 PT1M3.200S
+std::string IsoDuration(double sec) {
+    char buf[64];
+    int min = (int)(sec / 60);
+    snprintf(buf, sizeof(buf), "PT%dM%.3fS", min, sec - min * 60);
+    return buf;
+}
+
+} // namespace
+
+bool DashMpd::Write(const std::string& outputDir, const std::vector<DashRendition>& renditions) {
+    const int timescale = 1000;
+    std::string video, audio;
+    double total = 0, maxDur = 0;
+    for(const auto& r : renditions) {
+        HlsMedia media;
+        if(!ReadHlsMedia(outputDir + "/" + r.dir + "/index.m3u8", &media)) {
+            LOG_WARN("[DASH] %s/%s has no fMP4 playlist", outputDir.c_str(), r.dir.c_str());
+            return false;
+        }
+        total = std::max(total, media.total);
+
+        std::string rep = "      <Representation id=\"" + r.dir + "\" bandwidth=\"" + std::to_string(r.bandwidth)
+                        + "\" codecs=\"" + r.codecs + "\"";
+        if(!r.audio) {
+            rep += " width=\"" + std::to_string(r.width) + "\" height=\"" + std::to_string(r.height) + "\"";
+        }
+        rep += ">\n";
+        // 分片时长不完全相同，duration 只作参考，逐段用 SegmentTimeline 给出准确值
+        rep += "        <SegmentList timescale=\"" + std::to_string(timescale) + "\">\n";
+        rep += "          <Initialization sourceURL=\"" + r.dir + "/" + media.init + "\""
+             + (media.initRange.empty() ? "" : " range=\"" + media.initRange + "\"") + "/>\n";
+        rep += "          <SegmentTimeline>\n";
+        for(double d : media.durations) {
+            maxDur = std::max(maxDur, d);
+            rep += "            <S d=\"" + std::to_string((long long)(d * timescale + 0.5)) + "\"/>\n";
+        }
+        rep += "          </SegmentTimeline>\n";
+        for(size_t i = 0; i < media.segments.size(); i++) {
+            rep += "          <SegmentURL media=\"" + r.dir + "/" + media.segments[i] + "\""
+                 + (media.ranges[i].empty() ? "" : " mediaRange=\"" + media.ranges[i] + "\"") + "/>\n";
+        }
+        rep += "        </SegmentList>\n      </Representation>\n";
+        (r.audio ? audio : video) += rep;
+    }
+
+    std::string mpd = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<MPD xmlns=\"urn:mpeg:dash:schema:mpd:2011\" type=\"static\" "
+        "profiles=\"urn:mpeg:dash:profile:isoff-main:2011,urn:mpeg:dash:profile:cmaf:2019\" "
+        "mediaPresentationDuration=\"" + IsoDuration(total) + "\" "
+        "maxSegmentDuration=\"" + IsoDuration(maxDur) + "\" minBufferTime=\"PT4S\">\n"
+        "  <Period id=\"0\" start=\"PT0S\">\n";
+    if(!video.empty()) {
+        mpd += "    <AdaptationSet id=\"0\" contentType=\"video\" mimeType=\"video/mp4\" "
+               "segmentAlignment=\"true\" startWithSAP=\"1\">\n" + video + "    </AdaptationSet>\n";
+    }
+    if(!audio.empty()) {
+        mpd += "    <AdaptationSet id=\"1\" contentType=\"audio\" mimeType=\"audio/mp4\" "
+               "segmentAlignment=\"true\" startWithSAP=\"1\">\n" + audio + "    </AdaptationSet>\n";
+    }
+    mpd += "  </Period>\n</MPD>\n";
+
+    std::string path = outputDir + "/manifest.mpd";
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if(!out.is_open()) return false;
+        out << mpd;
+    }
+    return rename(tmp.c_str(), path.c_str()) == 0;
+}
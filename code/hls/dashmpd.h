@@ -0,0 +1,26 @@
+#ifndef DASH_MPD_H
+#define DASH_MPD_H
+
+#include <string>
+#include <vector>
+
+/*
+CMAF 模式下 HLS 与 DASH 共用同一份 fMP4 分片：
+由各路 HLS 子列表（EXTINF + EXT-X-MAP）生成静态 DASH MPD，SegmentList 直接引用同一批 .m4s
+*/
+struct DashRendition {
+    std::string dir;        // 相对输出目录的子目录，如 "720p"、"audio"
+    bool audio = false;
+    int bandwidth = 0;      // bps
+    int width = 0;
+    int height = 0;
+    std::string codecs;     // RFC 6381，如 "avc1.42E01F"、"mp4a.40.2"
+};
+
+class DashMpd {
+public:
+    // 读取 outputDir/<dir>/index.m3u8，写出 outputDir/manifest.mpd
+    static bool Write(const std::string& outputDir, const std::vector<DashRendition>& renditions);
+};
+
+#endif //DASH_MPD_H
@@ -0,0 +1,58 @@
+#include "fdcache.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+CachedFile::~CachedFile() {
+    close(fd);
+}
+
+FdCache* FdCache::Instance() {
+    static FdCache cache;
+    return &cache;
+}
+
+void FdCache::Init(size_t maxFiles) {
+    std::lock_guard<std::mutex> locker(mtx_);
+    maxFiles_ = maxFiles;
+}
+
+std::shared_ptr<CachedFile> FdCache::Open(const std::string& path, off_t* size, time_t* mtime) {
+    struct stat st;
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        auto it = files_.find(path);
+        if(it != files_.end()) {
+            std::shared_ptr<CachedFile> file = it->second->second;
+            // 只对已打开的 fd 做 fstat，不走路径查找
+            if(fstat(file->fd, &st) == 0 && st.st_nlink > 0) {
+                lru_.splice(lru_.begin(), lru_, it->second);
+                *size = st.st_size;
+                if(mtime) *mtime = st.st_mtime;
+                return file;
+            }
+            lru_.erase(it->second);
+            files_.erase(it);
+        }
+    }
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return nullptr;
+    std::shared_ptr<CachedFile> file = std::make_shared<CachedFile>(fd);
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) return nullptr;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);    // 整个码率一个文件，顺序预读收益最大
+    *size = st.st_size;
+    if(mtime) *mtime = st.st_mtime;
+
+    std::lock_guard<std::mutex> locker(mtx_);
+    if(maxFiles_ == 0) return file;
+    if(files_.count(path)) return file;     // 并发打开，保留已缓存的那个
+    lru_.emplace_front(path, file);
+    files_[path] = lru_.begin();
+    while(lru_.size() > maxFiles_) {
+        files_.erase(lru_.back().first);
+        lru_.pop_back();    // 仍在发送中的连接持有 shared_ptr，发完才真正 close
+    }
+    return file;
+}
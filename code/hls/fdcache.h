@@ -0,0 +1,43 @@
+#ifndef FD_CACHE_H
+#define FD_CACHE_H
+
+#include <string>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <sys/types.h>
+
+/*
+媒体文件的长期 fd 缓存：同一个分片/单文件码率被反复请求时不再重复 path 解析 + open
+文件被替换或删除后（fstat 得到 nlink==0）自动重新打开；按 LRU 限制打开的文件数
+*/
+struct CachedFile {
+    explicit CachedFile(int fd) : fd(fd) {}
+    ~CachedFile();
+    CachedFile(const CachedFile&) = delete;
+    CachedFile& operator=(const CachedFile&) = delete;
+    const int fd;
+};
+
+class FdCache {
+public:
+    static FdCache* Instance();
+
+    void Init(size_t maxFiles);
+
+    // 返回可用的只读 fd 及当前文件大小（可选修改时间），失败返回 nullptr
+    std::shared_ptr<CachedFile> Open(const std::string& path, off_t* size, time_t* mtime = nullptr);
+
+private:
+    FdCache() = default;
+
+    typedef std::list<std::pair<std::string, std::shared_ptr<CachedFile>>> LruList;
+
+    size_t maxFiles_ = 1024;
+    std::mutex mtx_;
+    LruList lru_;       // 最近使用的在前
+    std::unordered_map<std::string, LruList::iterator> files_;
+};
+
+#endif //FD_CACHE_H
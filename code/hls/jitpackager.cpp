@@ -0,0 +1,198 @@
+#include "jitpackager.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <fstream>
+#include "tsmuxer.h"
+#include "../log/log.h"
+
+JitPackager* JitPackager::Instance() {
+    static JitPackager packager;
+    return &packager;
+}
+
+void JitPackager::Init(bool enable, size_t cacheBytes) {
+    std::lock_guard<std::mutex> locker(mtx_);
+    enable_ = enable;
+    cacheCapacity_ = cacheBytes;
+}
+
+bool JitPackager::Publish(const std::string& source, const std::string& outputDir) {
+    if(!enable_) return false;
+    std::shared_ptr<Mp4Index> index = Mp4Index::Build(source);
+    if(!index || !index->Deliverable()) {
+        LOG_INFO("[JIT] %s needs transcoding", source.c_str());
+        return false;
+    }
+
+    std::system(("mkdir -p \"" + outputDir + "\"").c_str());
+    char* abs = realpath(source.c_str(), nullptr);
+    if(!abs) return false;
+    std::string link = outputDir + "/source.mp4";
+    unlink(link.c_str());
+    int ret = symlink(abs, link.c_str());
+    free(abs);
+    if(ret != 0) return false;
+
+    const Mp4Track* v = index->Video();
+    std::ofstream master(outputDir + "/master.m3u8");
+    if(!master.is_open()) return false;
+    master << "#EXTM3U\n#EXT-X-VERSION:3\n\n";
+    master << "#EXT-X-STREAM-INF:BANDWIDTH=" << index->PeakBitrate()
+           << ",RESOLUTION=" << v->width << "x" << v->height << "\n";
+    master << "src/index.m3u8\n";
+    master.close();
+
+    struct stat st;
+    if(stat(link.c_str(), &st) == 0) {
+        {
+            std::lock_guard<std::mutex> locker(mtx_);
+            DropCached_(link);      // 重新发布到同一目录时旧列表、分片作废
+        }
+        PutIndex_(link, index, st.st_mtime, st.st_size);
+    }
+    LOG_INFO("[JIT] %s published, %d segments, %.1fs", outputDir.c_str(),
+             (int)index->Segments().size(), index->Duration());
+    return true;
+}
+
+bool JitPackager::Serve(const std::string& dataPath, std::shared_ptr<const std::string>* body) {
+    size_t pos = dataPath.rfind("/src/");
+    if(pos == std::string::npos) return false;
+    std::string source = dataPath.substr(0, pos) + "/source.mp4";
+    std::string name = dataPath.substr(pos + 5);
+    struct stat st;
+    if(stat(source.c_str(), &st) != 0 || access(source.c_str(), R_OK) != 0) return false;
+    CheckSource_(source, st.st_mtime, st.st_size);
+
+    *body = GetCached_(dataPath);
+    if(*body) return true;
+
+    std::shared_ptr<const Mp4Index> index = GetIndex_(source, st.st_mtime, st.st_size);
+    if(!index) return false;
+
+    std::shared_ptr<std::string> out = std::make_shared<std::string>();
+    unsigned segNo = 0;
+    char tail = 0;
+    if(name == "index.m3u8") {
+        *out = MakePlaylist_(*index);
+    } else if(sscanf(name.c_str(), "seg%u.ts%c", &segNo, &tail) == 1) {
+        int fd = open(source.c_str(), O_RDONLY);
+        if(fd < 0) return false;
+        bool ok = TsMuxer::MuxSegment(*index, segNo, fd, out.get());
+        close(fd);
+        if(!ok) {
+            LOG_WARN("[JIT] mux %s failed", dataPath.c_str());
+            return false;
+        }
+    } else {
+        return false;
+    }
+    PutCached_(dataPath, out);
+    *body = out;
+    return true;
+}
+
+// 关键帧索引只建一次，之后所有分片请求共享
+std::shared_ptr<const Mp4Index> JitPackager::GetIndex_(const std::string& source, time_t mtime, off_t size) {
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        auto it = indexes_.find(source);
+        if(it != indexes_.end() && it->second->second.mtime == mtime && it->second->second.size == size) {
+            indexLru_.splice(indexLru_.begin(), indexLru_, it->second);
+            return it->second->second.index;
+        }
+    }
+    std::shared_ptr<const Mp4Index> index = Mp4Index::Build(source);
+    if(!index || !index->Deliverable()) return nullptr;
+    PutIndex_(source, index, mtime, size);
+    return index;
+}
+
+void JitPackager::PutIndex_(const std::string& source, const std::shared_ptr<const Mp4Index>& index,
+                            time_t mtime, off_t size) {
+    std::lock_guard<std::mutex> locker(mtx_);
+    auto it = indexes_.find(source);
+    if(it != indexes_.end()) {
+        indexLru_.erase(it->second);
+        indexes_.erase(it);
+    }
+    indexLru_.emplace_front(source, IndexEntry{index, mtime, size});
+    indexes_[source] = indexLru_.begin();
+    while(indexLru_.size() > MAX_INDEXES) {
+        DropCached_(indexLru_.back().first);
+        indexes_.erase(indexLru_.back().first);
+        indexLru_.pop_back();
+    }
+}
+
+// 每次请求都校验源文件：没变则把索引移到 LRU 头部（只命中分片缓存的热门视频也不会被淘汰），
+// 变了（mtime 或大小不同）则丢掉旧索引和该目录下已缓存的列表、分片
+void JitPackager::CheckSource_(const std::string& source, time_t mtime, off_t size) {
+    std::lock_guard<std::mutex> locker(mtx_);
+    auto it = indexes_.find(source);
+    if(it == indexes_.end()) return;
+    if(it->second->second.mtime == mtime && it->second->second.size == size) {
+        indexLru_.splice(indexLru_.begin(), indexLru_, it->second);
+        return;
+    }
+    indexLru_.erase(it->second);
+    indexes_.erase(it);
+    DropCached_(source);
+}
+
+// 丢掉 source 对应目录下缓存的列表、分片，调用时已持有 mtx_
+// 索引被淘汰时也一起丢，这样缓存里的内容总能由常驻索引的 mtime 校验
+void JitPackager::DropCached_(const std::string& source) {
+    // source 为 <dir>/source.mp4，虚拟文件的键为 <dir>/src/...
+    std::string prefix = source.substr(0, source.rfind('/')) + "/src/";
+    for(auto lit = lru_.begin(); lit != lru_.end();) {
+        if(lit->first.compare(0, prefix.size(), prefix) == 0) {
+            cacheBytes_ -= lit->second->size();
+            cache_.erase(lit->first);
+            lit = lru_.erase(lit);
+        } else {
+            ++lit;
+        }
+    }
+}
+
+std::string JitPackager::MakePlaylist_(const Mp4Index& index) {
+    double maxDur = 0;
+    for(const auto& seg : index.Segments()) { maxDur = std::max(maxDur, seg.duration); }
+    std::string m3u8 = "#EXTM3U\n#EXT-X-VERSION:3\n";
+    m3u8 += "#EXT-X-TARGETDURATION:" + std::to_string((int)ceil(maxDur)) + "\n";
+    m3u8 += "#EXT-X-MEDIA-SEQUENCE:0\n#EXT-X-PLAYLIST-TYPE:VOD\n";
+    char line[64];
+    for(size_t i = 0; i < index.Segments().size(); i++) {
+        snprintf(line, sizeof(line), "#EXTINF:%.6f,\nseg%zu.ts\n", index.Segments()[i].duration, i);
+        m3u8 += line;
+    }
+    m3u8 += "#EXT-X-ENDLIST\n";
+    return m3u8;
+}
+
+std::shared_ptr<const std::string> JitPackager::GetCached_(const std::string& key) {
+    std::lock_guard<std::mutex> locker(mtx_);
+    auto it = cache_.find(key);
+    if(it == cache_.end()) return nullptr;
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->second;
+}
+
+void JitPackager::PutCached_(const std::string& key, const std::shared_ptr<const std::string>& body) {
+    std::lock_guard<std::mutex> locker(mtx_);
+    if(body->size() > cacheCapacity_ || cache_.count(key)) return;
+    lru_.emplace_front(key, body);
+    cache_[key] = lru_.begin();
+    cacheBytes_ += body->size();
+    while(cacheBytes_ > cacheCapacity_ && !lru_.empty()) {
+        cacheBytes_ -= lru_.back().second->size();
+        cache_.erase(lru_.back().first);
+        lru_.pop_back();
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef JIT_PACKAGER_H
+#define JIT_PACKAGER_H
+
+#include <string>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <sys/types.h>
+#include "mp4index.h"
+
+/*
+即时打包：不预先生成 .ts，请求到来时从源 MP4 按关键帧索引重新封装分片
+目录约定：<outputDir>/source.mp4 指向源文件，<outputDir>/src/index.m3u8、
+<outputDir>/src/segN.ts 是虚拟路径，由本类生成并放入内存 LRU 缓存
+*/
+class JitPackager {
+public:
+    static JitPackager* Instance();
+
+    void Init(bool enable, size_t cacheBytes);
+    bool IsEnabled() const { return enable_; }
+
+    // 上传完成后调用：源可直接封装时写 master.m3u8 并返回 true，否则需要走转码
+    bool Publish(const std::string& source, const std::string& outputDir);
+
+    // data_path 落在 JIT 虚拟目录下时生成内容，返回 false 表示按普通文件处理
+    bool Serve(const std::string& dataPath, std::shared_ptr<const std::string>* body);
+
+private:
+    JitPackager() = default;
+
+    std::shared_ptr<const Mp4Index> GetIndex_(const std::string& source, time_t mtime, off_t size);
+    void PutIndex_(const std::string& source, const std::shared_ptr<const Mp4Index>& index, time_t mtime, off_t size);
+    void CheckSource_(const std::string& source, time_t mtime, off_t size);
+    void DropCached_(const std::string& source);
+    std::shared_ptr<const std::string> GetCached_(const std::string& key);
+    void PutCached_(const std::string& key, const std::shared_ptr<const std::string>& body);
+    static std::string MakePlaylist_(const Mp4Index& index);
+
+    typedef std::list<std::pair<std::string, std::shared_ptr<const std::string>>> LruList;
+
+    // 索引按源文件的 mtime/大小校验，源被替换后丢弃；最多常驻 MAX_INDEXES 个，按 LRU 淘汰
+    struct IndexEntry {
+        std::shared_ptr<const Mp4Index> index;
+        time_t mtime;
+        off_t size;
+    };
+    typedef std::list<std::pair<std::string, IndexEntry>> IndexList;
+    static const size_t MAX_INDEXES = 64;
+
+    bool enable_ = false;
+    size_t cacheCapacity_ = 0;
+    size_t cacheBytes_ = 0;
+
+    std::mutex mtx_;
+    IndexList indexLru_;                                                        // 源路径 -> 关键帧索引，最近使用的在前
+    std::unordered_map<std::string, IndexList::iterator> indexes_;
+    LruList lru_;                                                               // 最近使用的在前
+    std::unordered_map<std::string, LruList::iterator> cache_;
+};
+
+#endif //JIT_PACKAGER_H
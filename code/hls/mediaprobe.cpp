@@ -0,0 +1,51 @@
+#include "mediaprobe.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include "../log/log.h"
+
+// 执行 ffprobe，输出为 key=value 行；同名键只保留第一个
+static std::map<std::string, std::string> RunProbe(const std::string& args, const std::string& path) {
+    std::map<std::string, std::string> kv;
+    std::string cmd = "ffprobe -v error " + args + " -of default=nw=1 \"" + path + "\" 2>/dev/null";
+    FILE* fp = popen(cmd.c_str(), "r");
+    if(!fp) return kv;
+    char line[256];
+    while(fgets(line, sizeof(line), fp)) {
+        char* eq = strchr(line, '=');
+        if(!eq) continue;
+        std::string value(eq + 1);
+        while(!value.empty() && (value.back() == '\n' || value.back() == '\r')) value.pop_back();
+        kv.emplace(std::string(line, eq), value);
+    }
+    pclose(fp);
+    return kv;
+}
+
+bool MediaProbe::Probe(const std::string& path, MediaInfo* info) {
+    auto video = RunProbe("-select_streams v:0 -show_entries stream=width,height,r_frame_rate,bit_rate", path);
+    info->width = atoi(video["width"].c_str());
+    info->height = atoi(video["height"].c_str());
+    if(info->width <= 0 || info->height <= 0) {
+        LOG_WARN("[Probe] %s: no video stream", path.c_str());
+        return false;
+    }
+    int num = 0, den = 0;
+    if(sscanf(video["r_frame_rate"].c_str(), "%d/%d", &num, &den) == 2 && den > 0) {
+        info->fps = (double)num / den;
+    }
+    info->videoKbps = atoi(video["bit_rate"].c_str()) / 1000;   // N/A -> 0
+
+    // 同一次调用：音轨是否存在 + 容器总码率
+    auto other = RunProbe("-select_streams a:0 -show_entries stream=codec_type:format=bit_rate", path);
+    info->hasAudio = other["codec_type"] == "audio";
+    if(info->videoKbps <= 0) {
+        int total = atoi(other["bit_rate"].c_str()) / 1000;
+        info->videoKbps = info->hasAudio && total > 128 ? total - 128 : total;
+    }
+    LOG_INFO("[Probe] %s: %dx%d %.2ffps %dkbps audio:%d", path.c_str(), info->width, info->height,
+             info->fps, info->videoKbps, info->hasAudio);
+    return true;
+}
@@ -0,0 +1,24 @@
+#ifndef MEDIA_PROBE_H
+#define MEDIA_PROBE_H
+
+#include <string>
+
+/*
+转码前用 ffprobe 探测源文件：分辨率、帧率、码率、是否有音轨
+码率阶梯据此裁剪，避免把低清上传放大成 1080p
+*/
+struct MediaInfo {
+    int width = 0;
+    int height = 0;
+    double fps = 0;
+    int videoKbps = 0;      // 视频流码率，流上没有时用容器总码率估算，未知为 0
+    bool hasAudio = false;
+};
+
+class MediaProbe {
+public:
+    // 探测失败（无 ffprobe、无视频流）返回 false
+    static bool Probe(const std::string& path, MediaInfo* info);
+};
+
+#endif //MEDIA_PROBE_H
@@ -0,0 +1,584 @@
+#include "mp4index.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+#define FOURCC(a, b, c, d) ((uint32_t)(a) << 24 | (uint32_t)(b) << 16 | (uint32_t)(c) << 8 | (uint32_t)(d))
+
+namespace {
+
+// 大端字节流读取，越界后 ok 置为 false，后续读取都返回 0
+struct BoxReader {
+    const uint8_t* p;
+    const uint8_t* end;
+    bool ok = true;
+
+    BoxReader(const uint8_t* b, const uint8_t* e) : p(b), end(e) {}
+    size_t Left() const { return ok ? end - p : 0; }
+    bool Need(size_t n) {
+        if(!ok || (size_t)(end - p) < n) { ok = false; }
+        return ok;
+    }
+    uint8_t U8() { return Need(1) ? *p++ : 0; }
+    uint16_t U16() {
+        if(!Need(2)) return 0;
+        uint16_t v = (uint16_t)(p[0] << 8 | p[1]);
+        p += 2;
+        return v;
+    }
+    uint32_t U24() {
+        if(!Need(3)) return 0;
+        uint32_t v = (uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | p[2];
+        p += 3;
+        return v;
+    }
+    uint32_t U32() {
+        if(!Need(4)) return 0;
+        uint32_t v = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+        p += 4;
+        return v;
+    }
+    uint64_t U64() {
+        uint64_t hi = U32();
+        return hi << 32 | U32();
+    }
+    void Skip(size_t n) { if(Need(n)) p += n; }
+};
+
+// 解析样本表时的临时数据，最后展开成 Mp4Sample
+struct TrakTables {
+    std::vector<std::pair<uint32_t, uint32_t>> stts;    // count, delta
+    std::vector<std::pair<uint32_t, int32_t>> ctts;     // count, offset
+    std::vector<uint32_t> stss;                         // 1 起始的关键帧序号
+    bool hasStss = false;
+    uint32_t sampleSize = 0;                            // stsz 固定大小
+    std::vector<uint32_t> sizes;
+    std::vector<uint32_t> stscFirst, stscCount;         // stsc: first_chunk, samples_per_chunk
+    std::vector<uint64_t> chunkOffsets;
+};
+
+// esds 中描述符的可变长度字段
+uint32_t DescLen(BoxReader& r) {
+    uint32_t len = 0;
+    for(int i = 0; i < 4; i++) {
+        uint8_t b = r.U8();
+        len = len << 7 | (b & 0x7f);
+        if(!(b & 0x80)) break;
+    }
+    return len;
+}
+
+void ParseAvcC(BoxReader r, Mp4Track* t) {
+    r.Skip(4);  // version, profile, compat, level
+    t->nalLengthSize = (r.U8() & 0x03) + 1;
+    int numSps = r.U8() & 0x1f;
+    for(int i = 0; i < numSps && r.ok; i++) {
+        uint16_t len = r.U16();
+        if(!r.Need(len)) break;
+        t->sps.emplace_back((const char*)r.p, len);
+        r.Skip(len);
+    }
+    int numPps = r.U8();
+    for(int i = 0; i < numPps && r.ok; i++) {
+        uint16_t len = r.U16();
+        if(!r.Need(len)) break;
+        t->pps.emplace_back((const char*)r.p, len);
+        r.Skip(len);
+    }
+}
+
+void ParseEsds(BoxReader r, Mp4Track* t) {
+    r.Skip(4);  // version + flags
+    if(r.U8() != 0x03) return;
+    DescLen(r);
+    r.Skip(2);  // ES_ID
+    uint8_t flags = r.U8();
+    if(flags & 0x80) r.Skip(2);
+    if(flags & 0x40) r.Skip(r.U8());
+    if(flags & 0x20) r.Skip(2);
+    if(r.U8() != 0x04) return;
+    DescLen(r);
+    uint8_t objectType = r.U8();
+    if(objectType != 0x40 && objectType != 0x67) return;    // MPEG-4 / MPEG-2 LC AAC
+    r.Skip(12);
+    if(r.U8() != 0x05) return;
+    uint32_t len = DescLen(r);
+    if(len < 2 || !r.Need(len)) return;
+    // AudioSpecificConfig: 5bit objectType, 4bit freqIndex, 4bit channel
+    uint8_t b0 = r.p[0], b1 = r.p[1];
+    t->aacObjectType = b0 >> 3;
+    t->sampleRateIndex = ((b0 & 0x07) << 1) | (b1 >> 7);
+    t->channelConfig = (b1 >> 3) & 0x0f;
+}
+
+void ParseStsd(BoxReader r, Mp4Track* t) {
+    r.Skip(4);  // version + flags
+    if(r.U32() == 0) return;
+    const uint8_t* entryBegin = r.p;
+    uint32_t size = r.U32();
+    uint32_t type = r.U32();
+    if(!r.ok || size < 8 || (size_t)(r.end - entryBegin) < size) return;
+    const uint8_t* entryEnd = entryBegin + size;
+    t->codec = type;
+
+    size_t skip = 0;
+    if(type == FOURCC('a', 'v', 'c', '1') || type == FOURCC('a', 'v', 'c', '3')) {
+        r.Skip(24);
+        t->width = r.U16();
+        t->height = r.U16();
+        skip = 50;
+    } else if(type == FOURCC('m', 'p', '4', 'a')) {
+        r.Skip(8);
+        uint16_t version = r.U16();
+        r.Skip(18);
+        skip = version == 1 ? 16 : (version == 2 ? 36 : 0);
+    } else {
+        return;
+    }
+    r.Skip(skip);
+    // 子 box: avcC / esds
+    while(r.ok && r.Left() >= 8 && r.p < entryEnd) {
+        const uint8_t* b = r.p;
+        uint32_t bsize = r.U32();
+        uint32_t btype = r.U32();
+        if(bsize < 8 || b + bsize > entryEnd) break;
+        BoxReader body(r.p, b + bsize);
+        if(btype == FOURCC('a', 'v', 'c', 'C')) { ParseAvcC(body, t); }
+        else if(btype == FOURCC('e', 's', 'd', 's')) { ParseEsds(body, t); }
+        r.p = b + bsize;
+    }
+}
+
+void ParseStbl(uint32_t type, BoxReader r, Mp4Track* t, TrakTables* tb) {
+    switch(type) {
+    case FOURCC('s', 't', 's', 'd'):
+        ParseStsd(r, t);
+        break;
+    case FOURCC('s', 't', 't', 's'): {
+        r.Skip(4);
+        uint32_t n = r.U32();
+        for(uint32_t i = 0; i < n && r.ok; i++) {
+            uint32_t count = r.U32();
+            uint32_t delta = r.U32();
+            if(r.ok) tb->stts.emplace_back(count, delta);
+        }
+        break;
+    }
+    case FOURCC('c', 't', 't', 's'): {
+        r.Skip(4);
+        uint32_t n = r.U32();
+        for(uint32_t i = 0; i < n && r.ok; i++) {
+            uint32_t count = r.U32();
+            int32_t offset = (int32_t)r.U32();
+            if(r.ok) tb->ctts.emplace_back(count, offset);
+        }
+        break;
+    }
+    case FOURCC('s', 't', 's', 's'): {
+        r.Skip(4);
+        uint32_t n = r.U32();
+        tb->hasStss = true;
+        for(uint32_t i = 0; i < n && r.ok; i++) {
+            uint32_t v = r.U32();
+            if(r.ok) tb->stss.push_back(v);
+        }
+        break;
+    }
+    case FOURCC('s', 't', 's', 'z'): {
+        r.Skip(4);
+        tb->sampleSize = r.U32();
+        uint32_t n = r.U32();
+        if(tb->sampleSize == 0) {
+            if(!r.Need((size_t)n * 4)) break;
+            tb->sizes.reserve(n);
+            for(uint32_t i = 0; i < n; i++) tb->sizes.push_back(r.U32());
+        } else {
+            tb->sizes.assign(n, tb->sampleSize);
+        }
+        break;
+    }
+    case FOURCC('s', 't', 's', 'c'): {
+        r.Skip(4);
+        uint32_t n = r.U32();
+        for(uint32_t i = 0; i < n && r.ok; i++) {
+            uint32_t first = r.U32();
+            uint32_t count = r.U32();
+            r.Skip(4);  // sample_description_index
+            if(r.ok) {
+                tb->stscFirst.push_back(first);
+                tb->stscCount.push_back(count);
+            }
+        }
+        break;
+    }
+    case FOURCC('s', 't', 'c', 'o'):
+    case FOURCC('c', 'o', '6', '4'): {
+        r.Skip(4);
+        uint32_t n = r.U32();
+        bool wide = type == FOURCC('c', 'o', '6', '4');
+        if(!r.Need((size_t)n * (wide ? 8 : 4))) break;
+        tb->chunkOffsets.reserve(n);
+        for(uint32_t i = 0; i < n; i++) {
+            tb->chunkOffsets.push_back(wide ? r.U64() : r.U32());
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// 把 stts/ctts/stss/stsz/stsc/stco 展开成逐样本的表
+bool BuildSamples(const TrakTables& tb, Mp4Track* t) {
+    size_t n = tb.sizes.size();
+    if(n == 0) return true;     // 分片 MP4 的样本在 moof 中
+    if(tb.chunkOffsets.empty() || tb.stscFirst.empty()) return false;
+    t->samples.resize(n);
+
+    // 偏移：按 chunk 连续排列
+    size_t s = 0;
+    size_t entry = 0;
+    for(size_t c = 0; c < tb.chunkOffsets.size() && s < n; c++) {
+        while(entry + 1 < tb.stscFirst.size() && tb.stscFirst[entry + 1] <= c + 1) { entry++; }
+        uint64_t off = tb.chunkOffsets[c];
+        for(uint32_t k = 0; k < tb.stscCount[entry] && s < n; k++, s++) {
+            t->samples[s].offset = off;
+            t->samples[s].size = tb.sizes[s];
+            off += tb.sizes[s];
+        }
+    }
+    if(s != n) return false;
+
+    // 解码时间
+    uint64_t dts = 0;
+    s = 0;
+    for(const auto& e : tb.stts) {
+        for(uint32_t k = 0; k < e.first && s < n; k++, s++) {
+            t->samples[s].dts = dts;
+            dts += e.second;
+        }
+    }
+    uint32_t lastDelta = tb.stts.empty() ? 0 : tb.stts.back().second;
+    for(; s < n; s++) {
+        t->samples[s].dts = dts;
+        dts += lastDelta;
+    }
+    t->endDts = dts;
+
+    // 显示时间偏移
+    s = 0;
+    for(const auto& e : tb.ctts) {
+        for(uint32_t k = 0; k < e.first && s < n; k++, s++) {
+            t->samples[s].cts = e.second;
+        }
+    }
+    for(; s < n; s++) { t->samples[s].cts = 0; }
+
+    // 关键帧，没有 stss 则全部是关键帧
+    for(size_t i = 0; i < n; i++) { t->samples[i].key = !tb.hasStss; }
+    for(uint32_t k : tb.stss) {
+        if(k >= 1 && k <= n) t->samples[k - 1].key = true;
+    }
+    return true;
+}
+
+bool ParseTrak(const uint8_t* p, const uint8_t* end, Mp4Track* t, TrakTables* tb) {
+    BoxReader r(p, end);
+    while(r.ok && r.Left() >= 8) {
+        const uint8_t* b = r.p;
+        uint64_t size = r.U32();
+        uint32_t type = r.U32();
+        if(size == 1) { size = r.U64(); }
+        else if(size == 0) { size = end - b; }
+        if(size < 8 || size > (uint64_t)(end - b)) return false;
+        const uint8_t* bodyEnd = b + size;
+        BoxReader body(r.p, bodyEnd);
+
+        switch(type) {
+        case FOURCC('m', 'd', 'i', 'a'):
+        case FOURCC('m', 'i', 'n', 'f'):
+        case FOURCC('s', 't', 'b', 'l'):
+            if(!ParseTrak(r.p, bodyEnd, t, tb)) return false;
+            break;
+        case FOURCC('t', 'k', 'h', 'd'): {
+            uint8_t version = body.U8();
+            body.Skip(3 + (version == 1 ? 16 : 8));
+            t->id = body.U32();
+            break;
+        }
+        case FOURCC('m', 'd', 'h', 'd'): {
+            uint8_t version = body.U8();
+            body.Skip(3 + (version == 1 ? 16 : 8));
+            t->timescale = body.U32();
+            break;
+        }
+        case FOURCC('h', 'd', 'l', 'r'):
+            body.Skip(8);
+            t->handler = body.U32();
+            break;
+        default:
+            ParseStbl(type, body, t, tb);
+            break;
+        }
+        r.p = bodyEnd;
+    }
+    return r.ok;
+}
+
+bool ReadAll(int fd, uint64_t off, size_t len, std::string* out) {
+    out->resize(len);
+    size_t done = 0;
+    while(done < len) {
+        ssize_t n = pread(fd, &(*out)[done], len - done, off + done);
+        if(n <= 0) return false;
+        done += n;
+    }
+    return true;
+}
+
+} // namespace
+
+bool Mp4Index::ParseMoov_(const uint8_t* p, const uint8_t* end) {
+    BoxReader r(p, end);
+    std::vector<std::pair<uint32_t, BoxReader>> trex;
+    while(r.ok && r.Left() >= 8) {
+        const uint8_t* b = r.p;
+        uint64_t size = r.U32();
+        uint32_t type = r.U32();
+        if(size == 1) { size = r.U64(); }
+        if(size < 8 || size > (uint64_t)(end - b)) return false;
+        if(type == FOURCC('t', 'r', 'a', 'k')) {
+            Mp4Track t;
+            TrakTables tb;
+            if(ParseTrak(r.p, b + size, &t, &tb) && t.timescale && BuildSamples(tb, &t)) {
+                tracks_.push_back(std::move(t));
+            }
+        } else if(type == FOURCC('m', 'v', 'e', 'x')) {
+            // trex: 分片中缺省的时长/大小/标志
+            BoxReader m(r.p, b + size);
+            while(m.ok && m.Left() >= 8) {
+                const uint8_t* mb = m.p;
+                uint32_t msize = m.U32();
+                uint32_t mtype = m.U32();
+                if(msize < 8 || msize > (size_t)(m.end - mb)) break;
+                if(mtype == FOURCC('t', 'r', 'e', 'x')) {
+                    BoxReader body(m.p, mb + msize);
+                    body.Skip(4);
+                    trex.emplace_back(body.U32(), body);
+                }
+                m.p = mb + msize;
+            }
+        }
+        r.p = b + size;
+    }
+    for(auto& e : trex) {
+        Mp4Track* t = TrackById_(e.first);
+        if(!t) continue;
+        e.second.Skip(4);   // default_sample_description_index
+        t->defaultDuration = e.second.U32();
+        t->defaultSize = e.second.U32();
+        t->defaultFlags = e.second.U32();
+    }
+    for(size_t i = 0; i < tracks_.size(); i++) {
+        if(tracks_[i].handler == FOURCC('v', 'i', 'd', 'e') && video_ < 0) { video_ = i; }
+        if(tracks_[i].handler == FOURCC('s', 'o', 'u', 'n') && audio_ < 0) { audio_ = i; }
+    }
+    return video_ >= 0;
+}
+
+Mp4Track* Mp4Index::TrackById_(uint32_t id) {
+    for(auto& t : tracks_) {
+        if(t.id == id) return &t;
+    }
+    return nullptr;
+}
+
+// moof/traf/{tfhd,tfdt,trun}：把分片中的样本追加到对应轨道
+bool Mp4Index::ParseMoof_(const uint8_t* p, const uint8_t* end, uint64_t moofOffset) {
+    BoxReader r(p, end);
+    while(r.ok && r.Left() >= 8) {
+        const uint8_t* b = r.p;
+        uint32_t size = r.U32();
+        uint32_t type = r.U32();
+        if(size < 8 || size > (size_t)(end - b)) return false;
+        if(type != FOURCC('t', 'r', 'a', 'f')) {
+            r.p = b + size;
+            continue;
+        }
+
+        Mp4Track* t = nullptr;
+        uint64_t base = moofOffset;
+        uint32_t defDuration = 0, defSize = 0, defFlags = 0;
+        bool hasTfdt = false;
+        uint64_t tfdt = 0;
+        BoxReader traf(r.p, b + size);
+        while(traf.ok && traf.Left() >= 8) {
+            const uint8_t* tb = traf.p;
+            uint32_t tsize = traf.U32();
+            uint32_t ttype = traf.U32();
+            if(tsize < 8 || tsize > (size_t)(traf.end - tb)) return false;
+            BoxReader body(traf.p, tb + tsize);
+            if(ttype == FOURCC('t', 'f', 'h', 'd')) {
+                uint32_t flags = body.U32() & 0xffffff;
+                t = TrackById_(body.U32());
+                if(!t) return false;
+                defDuration = t->defaultDuration;
+                defSize = t->defaultSize;
+                defFlags = t->defaultFlags;
+                if(flags & 0x01) base = body.U64();
+                if(flags & 0x02) body.Skip(4);
+                if(flags & 0x08) defDuration = body.U32();
+                if(flags & 0x10) defSize = body.U32();
+                if(flags & 0x20) defFlags = body.U32();
+            } else if(ttype == FOURCC('t', 'f', 'd', 't')) {
+                uint8_t version = body.U8();
+                body.Skip(3);
+                tfdt = version == 1 ? body.U64() : body.U32();
+                hasTfdt = true;
+            } else if(ttype == FOURCC('t', 'r', 'u', 'n') && t) {
+                uint32_t flags = body.U32() & 0xffffff;
+                uint32_t count = body.U32();
+                uint64_t off = base;
+                if(flags & 0x001) off = base + (int32_t)body.U32();
+                uint32_t firstFlags = (flags & 0x004) ? body.U32() : defFlags;
+                uint64_t dts = hasTfdt ? tfdt : t->endDts;
+                for(uint32_t i = 0; i < count && body.ok; i++) {
+                    Mp4Sample s;
+                    uint32_t duration = (flags & 0x100) ? body.U32() : defDuration;
+                    s.size = (flags & 0x200) ? body.U32() : defSize;
+                    uint32_t sflags = (flags & 0x400) ? body.U32() : (i == 0 ? firstFlags : defFlags);
+                    s.cts = (flags & 0x800) ? (int32_t)body.U32() : 0;
+                    s.offset = off;
+                    s.dts = dts;
+                    s.key = !(sflags & 0x10000);    // sample_is_non_sync_sample
+                    if(body.ok) t->samples.push_back(s);
+                    off += s.size;
+                    dts += duration;
+                }
+                t->endDts = dts;
+                tfdt = dts;
+                hasTfdt = true;
+            }
+            traf.p = tb + tsize;
+        }
+        r.p = b + size;
+    }
+    return r.ok;
+}
+
+std::shared_ptr<Mp4Index> Mp4Index::Build(const std::string& path, double targetDuration) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) return nullptr;
+    struct stat st;
+    if(fstat(fd, &st) < 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    // 顶层 box 扫描：moov 可能在 mdat 之后，分片 MP4 还有若干 moof
+    uint64_t off = 0, fileSize = st.st_size;
+    std::string moov, hdr;
+    std::vector<std::pair<uint64_t, uint64_t>> moofs;
+    while(off + 8 <= fileSize) {
+        if(!ReadAll(fd, off, 16 <= fileSize - off ? 16 : 8, &hdr)) break;
+        BoxReader r((const uint8_t*)hdr.data(), (const uint8_t*)hdr.data() + hdr.size());
+        uint64_t size = r.U32();
+        uint32_t type = r.U32();
+        if(size == 1) { size = r.U64(); }
+        else if(size == 0) { size = fileSize - off; }
+        if(size < 8 || off + size > fileSize) break;
+        if(type == FOURCC('m', 'o', 'o', 'v')) {
+            if(size > (64u << 20) || !ReadAll(fd, off, size, &moov)) {
+                moov.clear();
+                break;
+            }
+        } else if(type == FOURCC('m', 'o', 'o', 'f')) {
+            moofs.emplace_back(off, size);
+        }
+        off += size;
+    }
+
+    std::shared_ptr<Mp4Index> index(new Mp4Index());
+    index->path_ = path;
+    const uint8_t* p = (const uint8_t*)moov.data();
+    bool ok = !moov.empty() && index->ParseMoov_(p + 8, p + moov.size());
+    std::string moof;
+    for(size_t i = 0; ok && i < moofs.size(); i++) {
+        ok = moofs[i].second <= (16u << 20) && ReadAll(fd, moofs[i].first, moofs[i].second, &moof) &&
+             index->ParseMoof_((const uint8_t*)moof.data() + 8,
+                               (const uint8_t*)moof.data() + moof.size(), moofs[i].first);
+    }
+    close(fd);
+    if(!ok || index->Video()->samples.empty()) return nullptr;
+    index->Segment_(targetDuration);
+    if(index->segments_.empty()) return nullptr;
+    return index;
+}
+
+bool Mp4Index::Deliverable() const {
+    const Mp4Track* v = Video();
+    if(!v || (v->codec != FOURCC('a', 'v', 'c', '1') && v->codec != FOURCC('a', 'v', 'c', '3'))) return false;
+    if(v->sps.empty() || v->pps.empty() || v->nalLengthSize < 1 || v->nalLengthSize > 4) return false;
+    const Mp4Track* a = Audio();
+    if(a) {
+        if(a->codec != FOURCC('m', 'p', '4', 'a')) return false;
+        // ADTS 只能描述 Main/LC/SSR/LTP，SBR/PS 的源需要转码
+        if(a->aacObjectType < 1 || a->aacObjectType > 4) return false;
+        if(a->sampleRateIndex > 12 || a->channelConfig < 1 || a->channelConfig > 7) return false;
+    }
+    return true;
+}
+
+void Mp4Index::Segment_(double targetDuration) {
+    const Mp4Track* v = Video();
+    const Mp4Track* a = Audio();
+    const auto& vs = v->samples;
+    double vts = v->timescale;
+
+    // 在到达目标时长后的第一个关键帧处切分
+    std::vector<size_t> cuts{0};
+    for(size_t i = 1; i < vs.size(); i++) {
+        if(vs[i].key && (vs[i].dts - vs[cuts.back()].dts) / vts >= targetDuration) {
+            cuts.push_back(i);
+        }
+    }
+
+    size_t ai = 0;
+    for(size_t k = 0; k < cuts.size(); k++) {
+        Mp4Segment seg;
+        seg.videoBegin = cuts[k];
+        seg.videoEnd = k + 1 < cuts.size() ? cuts[k + 1] : vs.size();
+        seg.start = vs[seg.videoBegin].dts / vts;
+        uint64_t endDts = seg.videoEnd < vs.size() ? vs[seg.videoEnd].dts : v->endDts;
+        seg.duration = (endDts - vs[seg.videoBegin].dts) / vts;
+        seg.bytes = 0;
+        for(size_t i = seg.videoBegin; i < seg.videoEnd; i++) { seg.bytes += vs[i].size; }
+
+        // 音频按时间归入视频分片
+        seg.audioBegin = ai;
+        if(a) {
+            double endSec = seg.videoEnd < vs.size() ? endDts / vts : 1e300;
+            while(ai < a->samples.size() && a->samples[ai].dts / (double)a->timescale < endSec) {
+                seg.bytes += a->samples[ai].size;
+                ai++;
+            }
+        }
+        seg.audioEnd = ai;
+        segments_.push_back(seg);
+    }
+}
+
+double Mp4Index::Duration() const {
+    const Mp4Track* v = Video();
+    return v ? v->endDts / (double)v->timescale : 0;
+}
+
+int Mp4Index::PeakBitrate() const {
+    double peak = 0;
+    for(const auto& seg : segments_) {
+        if(seg.duration > 0) { peak = std::max(peak, seg.bytes * 8 / seg.duration); }
+    }
+    return (int)(peak * 1.1);   // TS 封装开销
+}
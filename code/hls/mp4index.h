@@ -0,0 +1,86 @@
+#ifndef MP4_INDEX_H
+#define MP4_INDEX_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+
+/*
+解析源 MP4 的 moov 样本表，建立按关键帧对齐的分片索引，供即时打包(JIT)使用
+支持普通 MP4（moov 在前或在后均可）和浏览器录制常见的分片 MP4 (moof/trun)
+*/
+struct Mp4Sample {
+    uint64_t offset;    // 文件内偏移
+    uint32_t size;
+    uint64_t dts;       // 轨道 timescale 下的解码时间
+    int32_t  cts;       // 显示时间偏移 (pts = dts + cts)
+    bool     key;
+};
+
+struct Mp4Track {
+    uint32_t id = 0;
+    uint32_t handler = 0;           // 'vide' / 'soun'
+    uint32_t codec = 0;             // 'avc1' / 'mp4a'
+    uint32_t timescale = 0;
+    uint64_t endDts = 0;            // 最后一个样本结束时间
+    uint16_t width = 0;
+    uint16_t height = 0;
+
+    // H.264 (avcC)
+    int nalLengthSize = 4;
+    std::vector<std::string> sps;
+    std::vector<std::string> pps;
+
+    // AAC (esds AudioSpecificConfig)
+    int aacObjectType = 0;
+    int sampleRateIndex = 0;
+    int channelConfig = 0;
+
+    // 分片 MP4 (mvex/trex) 的默认值
+    uint32_t defaultDuration = 0;
+    uint32_t defaultSize = 0;
+    uint32_t defaultFlags = 0;
+
+    std::vector<Mp4Sample> samples;
+};
+
+// 一个 HLS 分片对应的样本区间 [begin, end)
+struct Mp4Segment {
+    size_t videoBegin, videoEnd;
+    size_t audioBegin, audioEnd;
+    double start;       // 秒
+    double duration;    // 秒
+    uint64_t bytes;     // 样本负载字节数
+};
+
+class Mp4Index {
+public:
+    // 读取 moov 并切分；文件不可用或格式不支持时返回 nullptr
+    static std::shared_ptr<Mp4Index> Build(const std::string& path, double targetDuration = 4.0);
+
+    // 是否可以不转码直接封装为 MPEG-TS（H.264 + 可选 AAC-LC）
+    bool Deliverable() const;
+
+    const Mp4Track* Video() const { return video_ < 0 ? nullptr : &tracks_[video_]; }
+    const Mp4Track* Audio() const { return audio_ < 0 ? nullptr : &tracks_[audio_]; }
+    const std::vector<Mp4Segment>& Segments() const { return segments_; }
+    const std::string& Path() const { return path_; }
+    double Duration() const;
+    int PeakBitrate() const;    // 分片峰值码率(bps)，用于 master 的 BANDWIDTH
+
+private:
+    Mp4Index() = default;
+    bool ParseMoov_(const uint8_t* p, const uint8_t* end);
+    bool ParseMoof_(const uint8_t* p, const uint8_t* end, uint64_t moofOffset);
+    Mp4Track* TrackById_(uint32_t id);
+    void Segment_(double targetDuration);
+
+    std::string path_;
+    std::vector<Mp4Track> tracks_;
+    int video_ = -1;
+    int audio_ = -1;
+    std::vector<Mp4Segment> segments_;
+};
+
+#endif //MP4_INDEX_H
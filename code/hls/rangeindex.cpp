@@ -0,0 +1,86 @@
+#include "rangeindex.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <sys/stat.h>
+
+RangeIndex* RangeIndex::Instance() {
+    static RangeIndex index;
+    return &index;
+}
+
+bool RangeIndex::Load(const std::string& playlist, std::vector<ByteRangeSegment>* segs, bool* complete) {
+    std::ifstream in(playlist);
+    if(!in.is_open()) return false;
+    segs->clear();
+    *complete = false;
+    std::string line;
+    long long len = -1;
+    unsigned long long off = 0, next = 0;
+    while(std::getline(in, line)) {
+        if(!line.empty() && line.back() == '\r') line.pop_back();
+        if(line.compare(0, 17, "#EXT-X-BYTERANGE:") == 0) {
+            off = next;     // 省略 @off 时紧接上一个区间
+            if(sscanf(line.c_str() + 17, "%lld@%llu", &len, &off) < 1) len = -1;
+        } else if(line == "#EXT-X-ENDLIST") {
+            *complete = true;
+        } else if(!line.empty() && line[0] != '#') {
+            if(len < 0) return false;   // 不是单文件列表
+            segs->push_back({line, off, (uint64_t)len});
+            next = off + len;
+            len = -1;
+        }
+    }
+    return !segs->empty();
+}
+
+bool RangeIndex::Resolve(const std::string& dataPath, std::string* file, uint64_t* offset, uint64_t* length) {
+    size_t slash = dataPath.rfind('/');
+    if(slash == std::string::npos) return false;
+    std::string dir = dataPath.substr(0, slash);
+    unsigned segNo = 0;
+    char ext[8] = {0}, tail = 0;
+    if(sscanf(dataPath.c_str() + slash + 1, "index%u.%7[a-z0-9]%c", &segNo, ext, &tail) != 2) return false;
+    if(strcmp(ext, "ts") != 0 && strcmp(ext, "m4s") != 0) return false;
+
+    std::string playlist = dir + "/index.m3u8";
+    struct stat st;
+    if(stat(playlist.c_str(), &st) != 0) return false;
+
+    std::shared_ptr<const std::vector<ByteRangeSegment>> segs;
+    bool hit = false;
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        auto it = renditions_.find(dir);
+        if(it != renditions_.end() && it->second->second.mtime == st.st_mtime && it->second->second.size == st.st_size) {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            segs = it->second->second.segs;
+            hit = true;
+        }
+    }
+    if(!hit) {
+        auto loaded = std::make_shared<std::vector<ByteRangeSegment>>();
+        bool complete = false;
+        if(Load(playlist, loaded.get(), &complete)) { segs = loaded; }
+        std::lock_guard<std::mutex> locker(mtx_);
+        auto it = renditions_.find(dir);
+        if(it != renditions_.end()) {
+            lru_.erase(it->second);
+            renditions_.erase(it);
+        }
+        lru_.emplace_front(dir, Rendition{segs, st.st_mtime, st.st_size});
+        renditions_[dir] = lru_.begin();
+        while(lru_.size() > MAX_RENDITIONS) {
+            renditions_.erase(lru_.back().first);
+            lru_.pop_back();
+        }
+    }
+    if(!segs) return false;
+    if(segNo >= segs->size()) return false;
+    const ByteRangeSegment& seg = (*segs)[segNo];
+    *file = dir + "/" + seg.file;
+    *offset = seg.offset;
+    *length = seg.length;
+    return true;
+}
@@ -0,0 +1,53 @@
+#ifndef RANGE_INDEX_H
+#define RANGE_INDEX_H
+
+#include <stdint.h>
+#include <string>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+#include <sys/types.h>
+
+/*
+单文件存储：每路码率只有一个 index.ts / index.m4s，子列表用 EXT-X-BYTERANGE 描述各分片
+本类为每路码率加载一次偏移表，把旧式的 <dir>/indexNNN.ts 请求映射为单文件内的区间，
+不支持字节区间的客户端仍可按分片名访问
+*/
+struct ByteRangeSegment {
+    std::string file;   // 单文件名（相对码率目录）
+    uint64_t offset;
+    uint64_t length;
+};
+
+class RangeIndex {
+public:
+    static RangeIndex* Instance();
+
+    // dataPath 形如 <dir>/indexNNN.ts 且该码率为单文件存储时返回 true，
+    // file 为单文件完整路径，[offset, offset+length) 为分片区间
+    bool Resolve(const std::string& dataPath, std::string* file, uint64_t* offset, uint64_t* length);
+
+    // 解析 playlist 中的 EXT-X-BYTERANGE 分片；列表没有结束(ENDLIST)时 complete 为 false
+    static bool Load(const std::string& playlist, std::vector<ByteRangeSegment>* segs, bool* complete);
+
+private:
+    RangeIndex() = default;
+
+    // 按子列表的 mtime/大小缓存解析结果：segs 为空表示不是单文件列表（或解析失败），同样缓存，
+    // 转码中的 EVENT 列表每追加一段 mtime/大小都会变，下次请求重新加载
+    struct Rendition {
+        std::shared_ptr<const std::vector<ByteRangeSegment>> segs;
+        time_t mtime;
+        off_t size;
+    };
+    typedef std::list<std::pair<std::string, Rendition>> RenditionList;
+    static const size_t MAX_RENDITIONS = 256;
+
+    std::mutex mtx_;
+    RenditionList lru_;                                                     // 码率目录 -> 偏移表，最近使用的在前
+    std::unordered_map<std::string, RenditionList::iterator> renditions_;
+};
+
+#endif //RANGE_INDEX_H
@@ -0,0 +1,312 @@
+#include "tsindexer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const uint32_t INDEX_MAGIC = 0x58495354;   // "TSIX"
+const uint32_t INDEX_VERSION = 2;     // v2: 增加分片基址
+
+inline bool Aligned(const uint8_t* data, size_t len, size_t pos) {
+    const size_t P = TsIndexer::PACKET_SIZE;
+    return data[pos] == 0x47 &&
+           (pos + P >= len || data[pos + P] == 0x47) &&
+           (pos + 2 * P >= len || data[pos + 2 * P] == 0x47);
+}
+
+uint64_t ParseTimestamp(const uint8_t* p) {
+    return (uint64_t)((p[0] >> 1) & 0x07) << 30 | (uint64_t)p[1] << 22 |
+           (uint64_t)(p[2] >> 1) << 15 | (uint64_t)p[3] << 7 | (uint64_t)(p[4] >> 1);
+}
+
+// 在 PES 负载里找 H.264 NAL：IDR/SPS 视为关键帧，遇到普通 slice 就停止
+bool ScanIdr(const uint8_t* p, const uint8_t* end) {
+    for(; p + 3 < end; p++) {
+        if(p[0] == 0 && p[1] == 0 && p[2] == 1) {
+            uint8_t type = p[3] & 0x1f;
+            if(type == 5 || type == 7) return true;
+            if(type == 1) return false;
+            p += 2;
+        }
+    }
+    return false;
+}
+
+template<typename T>
+void Put(std::string* s, T v) { s->append((const char*)&v, sizeof(v)); }
+
+template<typename T>
+bool Get(const std::string& s, size_t* pos, T* v) {
+    if(*pos + sizeof(T) > s.size()) return false;
+    memcpy(v, s.data() + *pos, sizeof(T));
+    *pos += sizeof(T);
+    return true;
+}
+
+bool WriteFileAtomic(const std::string& path, const std::string& content) {
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if(!out.is_open()) return false;
+        out << content;
+    }
+    return rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+} // namespace
+
+// SSE2 一次比较 16 字节找 0x47，再用包间距 188 验证，避免负载中偶然出现的 0x47
+size_t TsIndexer::FindSync(const uint8_t* data, size_t len) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i sync = _mm_set1_epi8(0x47);
+    for(; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, sync));
+        while(mask) {
+            size_t pos = i + __builtin_ctz(mask);
+            if(Aligned(data, len, pos)) return pos;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for(; i < len; i++) {
+        if(Aligned(data, len, i)) return i;
+    }
+    return len;
+}
+
+bool TsIndexer::Index(const uint8_t* data, size_t len, TsSegmentIndex* out) {
+    int pmtPid = -1, videoPid = -1;
+    long curKey = -1;   // 正在累计大小的关键帧
+    bool havePts = false, havePcr = false;
+    out->fileSize = len;
+    out->psiSize = 0;
+    out->keyframes.clear();
+
+    size_t pos = FindSync(data, len);
+    while(pos + PACKET_SIZE <= len) {
+        const uint8_t* p = data + pos;
+        if(p[0] != 0x47) {  // 失步，重新同步
+            pos += FindSync(p, len - pos);
+            continue;
+        }
+        int pid = (p[1] & 0x1f) << 8 | p[2];
+        bool pusi = p[1] & 0x40;
+        uint8_t afc = (p[3] >> 4) & 0x03;
+        const uint8_t* payload = p + 4;
+        const uint8_t* end = p + PACKET_SIZE;
+        bool rai = false;
+
+        if(afc & 0x02) {
+            uint8_t afLen = p[4];
+            if(afLen > 0 && afLen <= 183) {
+                uint8_t flags = p[5];
+                rai = flags & 0x40;
+                if((flags & 0x10) && afLen >= 7 && !havePcr) {
+                    out->firstPcr = (uint64_t)p[6] << 25 | (uint64_t)p[7] << 17 |
+                                    (uint64_t)p[8] << 9 | (uint64_t)p[9] << 1 | (p[10] >> 7);
+                    havePcr = true;
+                }
+            }
+            payload += 1 + afLen;
+        }
+        if(!(afc & 0x01) || payload >= end) {
+            pos += PACKET_SIZE;
+            continue;
+        }
+
+        if(pusi && (pid == 0 || pid == pmtPid)) {
+            const uint8_t* sec = payload + 1 + payload[0];
+            size_t secLen = sec + 3 <= end ? ((sec[1] & 0x0f) << 8 | sec[2]) : 0;
+            if(sec + 12 <= end && secLen >= 9) {
+                const uint8_t* secEnd = std::min(end, sec + 3 + secLen - 4);
+                if(pid == 0 && sec[0] == 0x00) {
+                    for(const uint8_t* e = sec + 8; e + 4 <= secEnd; e += 4) {
+                        if((e[0] << 8 | e[1]) != 0) {
+                            pmtPid = (e[2] & 0x1f) << 8 | e[3];
+                            break;
+                        }
+                    }
+                } else if(sec[0] == 0x02) {
+                    size_t infoLen = (sec[10] & 0x0f) << 8 | sec[11];
+                    for(const uint8_t* e = sec + 12 + infoLen; e + 5 <= secEnd;
+                        e += 5 + ((e[3] & 0x0f) << 8 | e[4])) {
+                        if(videoPid < 0 && (e[0] == 0x1b || e[0] == 0x24 || e[0] == 0x02)) {
+                            videoPid = (e[1] & 0x1f) << 8 | e[2];
+                        }
+                    }
+                    if(out->psiSize == 0) { out->psiSize = pos + PACKET_SIZE; }
+                }
+            }
+        } else if(pusi && pid == videoPid) {
+            if(curKey >= 0) {
+                out->keyframes[curKey].size = pos - out->keyframes[curKey].offset;
+                curKey = -1;
+            }
+            if(payload + 14 <= end && payload[0] == 0 && payload[1] == 0 && payload[2] == 1) {
+                uint64_t pts = 0;
+                if(payload[7] & 0x80) { pts = ParseTimestamp(payload + 9); }
+                if(!havePts) {
+                    out->firstPts = pts;
+                    havePts = true;
+                }
+                const uint8_t* es = payload + 9 + payload[8];
+                if(rai || (es < end && ScanIdr(es, end))) {
+                    out->keyframes.push_back({(uint32_t)pos, 0, pts});
+                    curKey = out->keyframes.size() - 1;
+                }
+            }
+        }
+        pos += PACKET_SIZE;
+    }
+    if(curKey >= 0) {
+        out->keyframes[curKey].size = std::min(pos, len) - out->keyframes[curKey].offset;
+    }
+    return videoPid >= 0;
+}
+
+bool TsIndexer::IndexFile(const std::string& path, TsSegmentIndex* out) {
+    std::ifstream in(path, std::ios::binary);
+    if(!in.is_open()) return false;
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    return Index((const uint8_t*)data.data(), data.size(), out);
+}
+
+bool TsIndexer::IndexRange(const std::string& path, uint64_t offset, uint64_t length, TsSegmentIndex* out) {
+    std::ifstream in(path, std::ios::binary);
+    if(!in.is_open()) return false;
+    in.seekg(offset);
+    std::string data(length, '\0');
+    in.read(&data[0], length);
+    data.resize(in.gcount());
+    if(!Index((const uint8_t*)data.data(), data.size(), out)) return false;
+    out->base = offset;
+    return true;
+}
+
+int TsIndexer::IndexRendition(const std::string& dir, const std::string& playlist) {
+    std::ifstream in(dir + "/" + playlist);
+    if(!in.is_open()) return 0;
+    std::vector<TsSegmentIndex> segs;
+    std::string line;
+    double extinf = 0;
+    long long rangeLen = -1;
+    unsigned long long rangeOff = 0, nextOff = 0;
+    while(std::getline(in, line)) {
+        if(!line.empty() && line.back() == '\r') line.pop_back();
+        if(line.compare(0, 8, "#EXTINF:") == 0) {
+            extinf = atof(line.c_str() + 8);
+        } else if(line.compare(0, 17, "#EXT-X-BYTERANGE:") == 0) {
+            // len[@off]，省略 off 时紧接上一个区间
+            rangeOff = nextOff;
+            if(sscanf(line.c_str() + 17, "%lld@%llu", &rangeLen, &rangeOff) < 1) rangeLen = -1;
+        } else if(!line.empty() && line[0] != '#') {
+            TsSegmentIndex seg;
+            bool ok = rangeLen >= 0 ? IndexRange(dir + "/" + line, rangeOff, rangeLen, &seg)
+                                    : IndexFile(dir + "/" + line, &seg);
+            if(rangeLen >= 0) nextOff = rangeOff + rangeLen;
+            rangeLen = -1;
+            if(!ok) continue;
+            seg.name = line;
+            seg.duration = extinf;
+            segs.push_back(std::move(seg));
+        }
+    }
+    if(segs.empty() || !Save(dir + "/index.idx", segs)) return 0;
+
+    int peak = 0;
+    if(!WriteFileAtomic(dir + "/iframe.m3u8", IFramePlaylist(segs, &peak))) return 0;
+    return peak;
+}
+
+bool TsIndexer::Save(const std::string& path, const std::vector<TsSegmentIndex>& segs) {
+    std::string buf;
+    Put(&buf, INDEX_MAGIC);
+    Put(&buf, INDEX_VERSION);
+    Put(&buf, (uint32_t)segs.size());
+    for(const auto& s : segs) {
+        Put(&buf, (uint16_t)s.name.size());
+        buf += s.name;
+        Put(&buf, s.base);
+        Put(&buf, s.fileSize);
+        Put(&buf, s.psiSize);
+        Put(&buf, s.firstPts);
+        Put(&buf, s.duration);
+        Put(&buf, (uint32_t)s.keyframes.size());
+        for(const auto& k : s.keyframes) {
+            Put(&buf, k.offset);
+            Put(&buf, k.size);
+            Put(&buf, k.pts);
+        }
+    }
+    return WriteFileAtomic(path, buf);
+}
+
+bool TsIndexer::Load(const std::string& path, std::vector<TsSegmentIndex>* segs) {
+    std::ifstream in(path, std::ios::binary);
+    if(!in.is_open()) return false;
+    std::string buf((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    size_t pos = 0;
+    uint32_t magic = 0, version = 0, count = 0;
+    if(!Get(buf, &pos, &magic) || !Get(buf, &pos, &version) || !Get(buf, &pos, &count)) return false;
+    if(magic != INDEX_MAGIC || version != INDEX_VERSION) return false;
+    segs->clear();
+    for(uint32_t i = 0; i < count; i++) {
+        TsSegmentIndex s;
+        uint16_t nameLen = 0;
+        uint32_t kfCount = 0;
+        if(!Get(buf, &pos, &nameLen) || pos + nameLen > buf.size()) return false;
+        s.name.assign(buf, pos, nameLen);
+        pos += nameLen;
+        if(!Get(buf, &pos, &s.base) || !Get(buf, &pos, &s.fileSize) || !Get(buf, &pos, &s.psiSize) || !Get(buf, &pos, &s.firstPts) ||
+           !Get(buf, &pos, &s.duration) || !Get(buf, &pos, &kfCount)) return false;
+        s.keyframes.resize(kfCount);
+        for(auto& k : s.keyframes) {
+            if(!Get(buf, &pos, &k.offset) || !Get(buf, &pos, &k.size) || !Get(buf, &pos, &k.pts)) return false;
+        }
+        segs->push_back(std::move(s));
+    }
+    return true;
+}
+
+std::string TsIndexer::IFramePlaylist(const std::vector<TsSegmentIndex>& segs, int* peakBps) {
+    std::ostringstream body;
+    double maxDur = 0, peak = 0;
+    body.setf(std::ios::fixed);
+    body.precision(6);
+    for(const auto& s : segs) {
+        if(s.psiSize > 0) {
+            body << "#EXT-X-MAP:URI=\"" << s.name << "\",BYTERANGE=\"" << s.psiSize << "@" << s.base << "\"\n";
+        }
+        double segEnd = s.firstPts / 90000.0 + s.duration;
+        for(size_t i = 0; i < s.keyframes.size(); i++) {
+            const TsKeyFrame& k = s.keyframes[i];
+            // I 帧的时长 = 到下一个 I 帧(或分片结尾)为止
+            double end = i + 1 < s.keyframes.size() ? s.keyframes[i + 1].pts / 90000.0 : segEnd;
+            double dur = end - k.pts / 90000.0;
+            if(dur <= 0) dur = 0.001;
+            maxDur = std::max(maxDur, dur);
+            peak = std::max(peak, k.size * 8 / dur);
+            body << "#EXTINF:" << dur << ",\n";
+            body << "#EXT-X-BYTERANGE:" << k.size << "@" << s.base + k.offset << "\n";
+            body << s.name << "\n";
+        }
+    }
+    std::ostringstream m3u8;
+    m3u8 << "#EXTM3U\n#EXT-X-VERSION:5\n";
+    m3u8 << "#EXT-X-TARGETDURATION:" << (int)ceil(maxDur) << "\n";
+    m3u8 << "#EXT-X-MEDIA-SEQUENCE:0\n#EXT-X-PLAYLIST-TYPE:VOD\n#EXT-X-I-FRAMES-ONLY\n";
+    m3u8 << body.str() << "#EXT-X-ENDLIST\n";
+    if(peakBps) *peakBps = (int)peak;
+    return m3u8.str();
+}
@@ -0,0 +1,49 @@
+#ifndef TS_INDEXER_H
+#define TS_INDEXER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/*
+MPEG-TS 分片索引：扫描 188 字节包，解析 PAT/PMT/PES，记录 PTS/PCR 与关键帧偏移
+转码完成后为每路码率生成一次紧凑的二进制索引，并由它输出 I 帧播放列表（拖动/快进用）
+*/
+struct TsKeyFrame {
+    uint32_t offset;    // 关键帧所在 PES 首包在分片内的偏移
+    uint32_t size;      // 到下一个视频 PES 之前的字节数
+    uint64_t pts;       // 90kHz
+};
+
+struct TsSegmentIndex {
+    std::string name;       // 分片文件名(相对子列表)
+    uint64_t base = 0;      // 单文件存储时分片在文件内的起始偏移，下面的偏移都相对于它
+    uint32_t fileSize = 0;
+    uint32_t psiSize = 0;   // 开头 PAT/PMT 的字节数，作为 EXT-X-MAP
+    uint64_t firstPts = 0;
+    uint64_t firstPcr = 0;
+    double duration = 0;    // 秒，优先取播放列表中的 EXTINF
+    std::vector<TsKeyFrame> keyframes;
+};
+
+class TsIndexer {
+public:
+    static const size_t PACKET_SIZE = 188;
+
+    // 找到第一个连续 3 个包都对齐的同步字节位置，找不到返回 len
+    static size_t FindSync(const uint8_t* data, size_t len);
+
+    static bool Index(const uint8_t* data, size_t len, TsSegmentIndex* out);
+    static bool IndexFile(const std::string& path, TsSegmentIndex* out);
+    static bool IndexRange(const std::string& path, uint64_t offset, uint64_t length, TsSegmentIndex* out);
+
+    // 为一路码率建立索引：读取 dir/playlist 中的分片（支持 EXT-X-BYTERANGE），写出 dir/index.idx 与 dir/iframe.m3u8
+    // 返回 I 帧列表的峰值码率(bps)，失败返回 0
+    static int IndexRendition(const std::string& dir, const std::string& playlist);
+
+    static bool Save(const std::string& path, const std::vector<TsSegmentIndex>& segs);
+    static bool Load(const std::string& path, std::vector<TsSegmentIndex>* segs);
+    static std::string IFramePlaylist(const std::vector<TsSegmentIndex>& segs, int* peakBps);
+};
+
+#endif //TS_INDEXER_H
@@ -0,0 +1,242 @@
+#include "tsmuxer.h"
+
+#include <unistd.h>
+#include <string.h>
+
+namespace {
+
+const size_t TS_PACKET_SIZE = 188;
+const uint64_t TS_CLOCK = 90000;
+// 与 ffmpeg 一致，整体后移 1.4s，保证 pts 减去 B 帧偏移后仍为正
+const uint64_t TS_TIME_OFFSET = 126000;
+
+void PutTimestamp(std::string* s, uint8_t marker, uint64_t ts) {
+    s->push_back((char)((marker << 4) | (((ts >> 30) & 0x07) << 1) | 1));
+    s->push_back((char)((ts >> 22) & 0xff));
+    s->push_back((char)((((ts >> 15) & 0x7f) << 1) | 1));
+    s->push_back((char)((ts >> 7) & 0xff));
+    s->push_back((char)(((ts & 0x7f) << 1) | 1));
+}
+
+uint64_t To90k(uint64_t t, uint32_t timescale) {
+    return t * TS_CLOCK / timescale;
+}
+
+bool ReadSample(int fd, const Mp4Sample& s, std::string* buf) {
+    buf->resize(s.size);
+    size_t done = 0;
+    while(done < s.size) {
+        ssize_t n = pread(fd, &(*buf)[done], s.size - done, s.offset + done);
+        if(n <= 0) return false;
+        done += n;
+    }
+    return true;
+}
+
+} // namespace
+
+uint32_t TsMuxer::Crc32(const uint8_t* data, size_t len) {
+    static uint32_t table[256];
+    static bool init = [] {
+        for(uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i << 24;
+            for(int k = 0; k < 8; k++) { c = (c & 0x80000000) ? (c << 1) ^ 0x04C11DB7 : c << 1; }
+            table[i] = c;
+        }
+        return true;
+    }();
+    (void)init;
+    uint32_t crc = 0xFFFFFFFF;
+    for(size_t i = 0; i < len; i++) { crc = (crc << 8) ^ table[((crc >> 24) ^ data[i]) & 0xff]; }
+    return crc;
+}
+
+uint8_t TsMuxer::NextCc_(uint16_t pid) {
+    uint8_t* cc = pid == VIDEO_PID ? &ccVideo_ : &ccAudio_;
+    uint8_t v = *cc;
+    *cc = (*cc + 1) & 0x0f;
+    return v;
+}
+
+// 每个分片开头写一次 PAT/PMT，保证分片可以独立解码
+void TsMuxer::WritePsi_(bool hasAudio) {
+    auto writeSection = [this](uint16_t pid, uint8_t* cc, std::string section) {
+        // section_length 从该字段之后算起，包含 CRC
+        size_t len = section.size() - 3 + 4;
+        section[1] = (char)(0xb0 | (len >> 8));
+        section[2] = (char)(len & 0xff);
+        std::string pkt;
+        pkt.push_back(0x47);
+        pkt.push_back((char)(0x40 | (pid >> 8)));
+        pkt.push_back((char)(pid & 0xff));
+        pkt.push_back((char)(0x10 | *cc));
+        *cc = (*cc + 1) & 0x0f;
+        pkt.push_back(0);   // pointer_field
+        pkt += section;
+        uint32_t crc = Crc32((const uint8_t*)section.data(), section.size());
+        for(int i = 3; i >= 0; i--) { pkt.push_back((char)(crc >> (i * 8))); }
+        pkt.resize(TS_PACKET_SIZE, (char)0xff);
+        out_->append(pkt);
+    };
+
+    // PAT: program 1 -> PMT_PID
+    std::string pat = {0x00, 0, 0, 0x00, 0x01, (char)0xc1, 0x00, 0x00,
+                       0x00, 0x01, (char)(0xe0 | (PMT_PID >> 8)), (char)(PMT_PID & 0xff)};
+    writeSection(0, &ccPat_, pat);
+
+    // PMT: H.264 (+ AAC ADTS)，PCR 随视频
+    std::string pmt = {0x02, 0, 0, 0x00, 0x01, (char)0xc1, 0x00, 0x00,
+                       (char)(0xe0 | (VIDEO_PID >> 8)), (char)(VIDEO_PID & 0xff), (char)0xf0, 0x00,
+                       0x1b, (char)(0xe0 | (VIDEO_PID >> 8)), (char)(VIDEO_PID & 0xff), (char)0xf0, 0x00};
+    if(hasAudio) {
+        pmt += {0x0f, (char)(0xe0 | (AUDIO_PID >> 8)), (char)(AUDIO_PID & 0xff), (char)0xf0, 0x00};
+    }
+    writeSection(PMT_PID, &ccPmt_, pmt);
+}
+
+void TsMuxer::WritePes_(uint16_t pid, uint8_t streamId, const std::string& payload,
+                        uint64_t pts, uint64_t dts, bool withDts, bool key) {
+    std::string pes;
+    pes.reserve(payload.size() + 19);
+    pes.append("\x00\x00\x01", 3);
+    pes.push_back((char)streamId);
+    size_t pesLen = payload.size() + 3 + (withDts ? 10 : 5);
+    if(pesLen > 0xffff || streamId == 0xe0) { pesLen = 0; } // 视频允许不定长
+    pes.push_back((char)(pesLen >> 8));
+    pes.push_back((char)(pesLen & 0xff));
+    pes.push_back((char)0x80);
+    pes.push_back((char)(withDts ? 0xc0 : 0x80));
+    pes.push_back((char)(withDts ? 10 : 5));
+    PutTimestamp(&pes, withDts ? 0x3 : 0x2, pts);
+    if(withDts) { PutTimestamp(&pes, 0x1, dts); }
+    pes += payload;
+    WritePackets_(pid, pes, key, pid == VIDEO_PID, dts);
+}
+
+void TsMuxer::WritePackets_(uint16_t pid, const std::string& pes, bool key, bool withPcr, uint64_t pcr) {
+    size_t pos = 0;
+    bool first = true;
+    while(pos < pes.size()) {
+        uint8_t pkt[TS_PACKET_SIZE];
+        pkt[0] = 0x47;
+        pkt[1] = (uint8_t)((first ? 0x40 : 0x00) | (pid >> 8));
+        pkt[2] = (uint8_t)(pid & 0xff);
+
+        // 自适应字段：首包携带 PCR/随机访问标志，末包用 0xff 填充
+        uint8_t af[TS_PACKET_SIZE];
+        size_t afLen = 0;
+        if(first && (withPcr || key)) {
+            af[1] = (uint8_t)((key ? 0x40 : 0) | (withPcr ? 0x10 : 0));
+            afLen = 2;
+            if(withPcr) {
+                uint64_t base = pcr;
+                af[2] = (uint8_t)(base >> 25);
+                af[3] = (uint8_t)(base >> 17);
+                af[4] = (uint8_t)(base >> 9);
+                af[5] = (uint8_t)(base >> 1);
+                af[6] = (uint8_t)(((base & 1) << 7) | 0x7e);
+                af[7] = 0;
+                afLen = 8;
+            }
+        }
+        size_t left = pes.size() - pos;
+        size_t room = TS_PACKET_SIZE - 4 - afLen;
+        if(left < room) {
+            size_t stuff = room - left;
+            if(afLen == 0) {
+                if(stuff == 1) {
+                    afLen = 1;
+                } else {
+                    af[1] = 0;
+                    memset(af + 2, 0xff, stuff - 2);
+                    afLen = stuff;
+                }
+            } else {
+                memset(af + afLen, 0xff, stuff);
+                afLen += stuff;
+            }
+        }
+        size_t n = TS_PACKET_SIZE - 4 - afLen;
+        pkt[3] = (uint8_t)((afLen ? 0x30 : 0x10) | NextCc_(pid));
+        if(afLen) {
+            af[0] = (uint8_t)(afLen - 1);
+            memcpy(pkt + 4, af, afLen);
+        }
+        memcpy(pkt + 4 + afLen, pes.data() + pos, n);
+        out_->append((const char*)pkt, TS_PACKET_SIZE);
+        pos += n;
+        first = false;
+    }
+}
+
+bool TsMuxer::MuxSegment(const Mp4Index& index, size_t segNo, int fd, std::string* out) {
+    if(segNo >= index.Segments().size()) return false;
+    const Mp4Segment& seg = index.Segments()[segNo];
+    const Mp4Track* v = index.Video();
+    const Mp4Track* a = index.Audio();
+
+    out->clear();
+    out->reserve(seg.bytes + seg.bytes / 10 + 1024);
+    TsMuxer mux(out);
+    mux.WritePsi_(a != nullptr && seg.audioEnd > seg.audioBegin);
+
+    static const char START_CODE[] = {0, 0, 0, 1};
+    static const char AUD[] = {0, 0, 0, 1, 0x09, (char)0xf0};
+    std::string sample, payload;
+
+    size_t vi = seg.videoBegin, ai = seg.audioBegin;
+    while(vi < seg.videoEnd || ai < seg.audioEnd) {
+        // 按解码时间交织音视频
+        bool takeVideo = ai >= seg.audioEnd ||
+            (vi < seg.videoEnd && v->samples[vi].dts * (uint64_t)a->timescale <= a->samples[ai].dts * (uint64_t)v->timescale);
+
+        if(takeVideo) {
+            const Mp4Sample& s = v->samples[vi++];
+            if(!ReadSample(fd, s, &sample)) return false;
+            payload.assign(AUD, sizeof(AUD));
+            if(s.key) {
+                for(const auto& sps : v->sps) { payload.append(START_CODE, 4).append(sps); }
+                for(const auto& pps : v->pps) { payload.append(START_CODE, 4).append(pps); }
+            }
+            size_t p = 0, nls = v->nalLengthSize;
+            while(p + nls <= sample.size()) {
+                size_t len = 0;
+                for(size_t k = 0; k < nls; k++) { len = len << 8 | (uint8_t)sample[p + k]; }
+                p += nls;
+                if(len > sample.size() - p) return false;
+                uint8_t nalType = sample[p] & 0x1f;
+                if(len && nalType != 9) {   // 源中的 AUD 丢弃，前面已统一写入
+                    payload.append(START_CODE, 4).append(sample, p, len);
+                }
+                p += len;
+            }
+            uint64_t dts = To90k(s.dts, v->timescale) + TS_TIME_OFFSET;
+            int64_t pts = (int64_t)dts + (int64_t)s.cts * (int64_t)TS_CLOCK / v->timescale;
+            mux.WritePes_(VIDEO_PID, 0xe0, payload, pts < 0 ? 0 : pts, dts, true, s.key);
+        } else {
+            // 连续的几帧 AAC 合并为一个 PES，减少头部开销
+            uint64_t pts = To90k(a->samples[ai].dts, a->timescale) + TS_TIME_OFFSET;
+            payload.clear();
+            for(int frames = 0; frames < 5 && ai < seg.audioEnd; frames++) {
+                if(vi < seg.videoEnd && frames > 0 &&
+                   a->samples[ai].dts * (uint64_t)v->timescale > v->samples[vi].dts * (uint64_t)a->timescale) {
+                    break;
+                }
+                const Mp4Sample& s = a->samples[ai++];
+                if(!ReadSample(fd, s, &sample)) return false;
+                size_t frameLen = sample.size() + 7;
+                char adts[7];
+                adts[0] = (char)0xff;
+                adts[1] = (char)0xf1;
+                adts[2] = (char)(((a->aacObjectType - 1) << 6) | (a->sampleRateIndex << 2) | (a->channelConfig >> 2));
+                adts[3] = (char)(((a->channelConfig & 3) << 6) | (frameLen >> 11));
+                adts[4] = (char)((frameLen >> 3) & 0xff);
+                adts[5] = (char)(((frameLen & 7) << 5) | 0x1f);
+                adts[6] = (char)0xfc;
+                payload.append(adts, 7).append(sample);
+            }
+            mux.WritePes_(AUDIO_PID, 0xc0, payload, pts, pts, false, false);
+        }
+    }
+    return true;
+}
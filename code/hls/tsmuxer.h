@@ -0,0 +1,36 @@
+#ifndef TS_MUXER_H
+#define TS_MUXER_H
+
+#include <stdint.h>
+#include <string>
+#include "mp4index.h"
+
+/*
+把 Mp4Index 中一个分片的样本重新封装成 MPEG-TS：
+H.264 由 AVCC 长度前缀转为 Annex B（关键帧前补 SPS/PPS），AAC 补 ADTS 头
+*/
+class TsMuxer {
+public:
+    static const uint16_t PMT_PID = 0x1000;
+    static const uint16_t VIDEO_PID = 0x100;
+    static const uint16_t AUDIO_PID = 0x101;
+
+    // fd 为源文件；成功时 out 为完整的 .ts 内容
+    static bool MuxSegment(const Mp4Index& index, size_t segNo, int fd, std::string* out);
+
+    static uint32_t Crc32(const uint8_t* data, size_t len);  // MPEG-2 CRC
+
+private:
+    explicit TsMuxer(std::string* out) : out_(out) {}
+
+    void WritePsi_(bool hasAudio);
+    void WritePes_(uint16_t pid, uint8_t streamId, const std::string& payload,
+                   uint64_t pts, uint64_t dts, bool withDts, bool key);
+    void WritePackets_(uint16_t pid, const std::string& pes, bool key, bool withPcr, uint64_t pcr);
+    uint8_t NextCc_(uint16_t pid);
+
+    std::string* out_;
+    uint8_t ccPat_ = 0, ccPmt_ = 0, ccVideo_ = 0, ccAudio_ = 0;
+};
+
+#endif //TS_MUXER_H
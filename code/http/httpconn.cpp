@@ -5,9 +5,11 @@ const char* HttpConn::srcDir;
 std::atomic<int> HttpConn::userCount;
 bool HttpConn::isET;
 
-HttpConn::HttpConn() { 
+HttpConn::HttpConn() : writeBuff_(0, BlockPool::Instance()->BlockSize()) { 
     fd_ = -1;
+    fileIov_ = { nullptr, 0 };
     addr_ = { 0 };
+    ip_[0] = '\0';
     isClose_ = true;
 };
 
@@ -19,24 +21,49 @@ void HttpConn::init(int fd, const sockaddr_in& addr) {
     assert(fd > 0);
     userCount++;
     addr_ = addr;
+    ip_[0] = '\0';
     fd_ = fd;
+    generation_.fetch_add(1, std::memory_order_release);
     writeBuff_.RetrieveAll();
     readBuff_.RetrieveAll();
     isClose_ = false;
+    busy_ = false;
+    closePending_ = false;
+    co_ = nullptr;
+    timeout_ = TimeoutState();
+    bytesSent_ = 0;
+    served_ = false;
+    traced_ = false;
     request_.Init();
-    LOG_INFO("Client[%d](%s:%d) in, userCount:%d", fd_, GetIP(), GetPort(), (int)userCount);
+    LOG_INFO_LIMIT(CHURN_LOG_PER_SEC, "Client[%d](%s:%d) in, userCount:%d", fd_, GetIP(), GetPort(), (int)userCount);
 }
 
 void HttpConn::Close() {
+    if(traced_) { TraceEnd_(true); }
     response_.UnmapFile();
+    // 连接对象会被同一个 fd 复用，关闭时把缓冲区内存还回去
+    readBuff_.RetrieveAll();
+    writeBuff_.RetrieveAll();
+    ReleaseIdle();
     if(isClose_ == false){
         isClose_ = true; 
+        co_ = nullptr;
+        generation_.fetch_add(1, std::memory_order_release);  // 还在路上的查库结果作废
         userCount--;
         close(fd_);
-        LOG_INFO("Client[%d](%s:%d) quit, UserCount:%d", fd_, GetIP(), GetPort(), (int)userCount);
+        LOG_INFO_LIMIT(CHURN_LOG_PER_SEC, "Client[%d](%s:%d) quit, UserCount:%d, buffer live:%zuKB pooled:%zuKB",
+                       fd_, GetIP(), GetPort(), (int)userCount,
+                       BlockPool::Instance()->GetStats().liveBytes >> 10, BlockPool::Instance()->GetStats().pooledBytes >> 10);
     }
 }
 
+void HttpConn::ReleaseIdle() {
+    served_ = true;
+    request_.Init();    // 响应已发完，请求 arena 一次性归还
+    readBuff_.ReleaseIdle();
+    writeBuff_.ReleaseIdle();
+}
+
 int HttpConn::GetFd() const {
     return fd_;
 };
@@ -46,7 +73,9 @@ struct sockaddr_in HttpConn::GetAddr() const {
 }
 
 const char* HttpConn::GetIP() const {
-    return inet_ntoa(addr_.sin_addr);
+    // inet_ntoa 每次都格式化到线程局部的缓冲区，这里每个连接只转换一次
+    if(ip_[0] == '\0') { inet_ntop(AF_INET, &addr_.sin_addr, ip_, sizeof(ip_)); }
+    return ip_;
 }
 
 int HttpConn::GetPort() const {
@@ -65,30 +94,37 @@ ssize_t HttpConn::read(int* saveErrno) {
     return len;
 }
 
-// 主要采用writev连续写函数
+// 主要采用writev连续写函数：写缓冲区的块链 + mmap 的文件一次发出，分片文件最后用 sendfile
 ssize_t HttpConn::write(int* saveErrno) {
     ssize_t len = -1;
     do {
-        len = writev(fd_, iov_, iovCnt_);   // 将iov的内容写到fd中
+        if(writeBuff_.ReadableBytes() == 0 && fileIov_.iov_len == 0) {
+            if(response_.BodyRemain() == 0) { break; } /* 传输结束 */
+            len = response_.SendBody(fd_);  // 响应头已发完，零拷贝发送分片
+        } else {
+            struct iovec iov[MAX_IOV];
+            int cnt = writeBuff_.PeekIov(iov, MAX_IOV - 1);
+            size_t head = 0;
+            for(int i = 0; i < cnt; i++) { head += iov[i].iov_len; }
+            if(head == writeBuff_.ReadableBytes() && fileIov_.iov_len) {
+                iov[cnt++] = fileIov_;      // 响应头全部在 iov 中时才能接上文件
+            }
+            len = writev(fd_, iov, cnt);   // 将iov的内容写到fd中
+            if(len > 0) {
+                size_t fromBuff = std::min(static_cast<size_t>(len), head);
+                writeBuff_.Retrieve(fromBuff);
+                fileIov_.iov_base = (uint8_t*)fileIov_.iov_base + (len - fromBuff);
+                fileIov_.iov_len -= (len - fromBuff);
+            }
+        }
         if(len <= 0) {
             *saveErrno = errno;
             break;
         }
-        if(iov_[0].iov_len + iov_[1].iov_len  == 0) { break; } /* 传输结束 */
-        else if(static_cast<size_t>(len) > iov_[0].iov_len) {
-            iov_[1].iov_base = (uint8_t*) iov_[1].iov_base + (len - iov_[0].iov_len);
-            iov_[1].iov_len -= (len - iov_[0].iov_len);
-            if(iov_[0].iov_len) {
-                writeBuff_.RetrieveAll();
-                iov_[0].iov_len = 0;
-            }
-        }
-        else {
-            iov_[0].iov_base = (uint8_t*)iov_[0].iov_base + len; 
-            iov_[0].iov_len -= len; 
-            writeBuff_.Retrieve(len);
-        }
+        if(traced_ && !trace_.stage[AccessLog::STAGE_FIRST_BYTE]) { TraceStage_(AccessLog::STAGE_FIRST_BYTE); }
+        bytesSent_ += len;
     } while(isET || ToWriteBytes() > 10240);
+    if(traced_ && ToWriteBytes() == 0) { TraceEnd_(false); }
     return len;
 }
 
@@ -105,36 +141,88 @@ bool HttpConn::process() {
     }
 
     response_.MakeResponse(writeBuff_); // 生成响应报文放入writeBuff_中
-    // 响应头
-    iov_[0].iov_base = const_cast<char*>(writeBuff_.Peek());
-    iov_[0].iov_len = writeBuff_.ReadableBytes();
-    iovCnt_ = 1;
-
     // 文件
+    fileIov_ = { nullptr, 0 };
     if(response_.FileLen() > 0  && response_.File()) {
-        iov_[1].iov_base = response_.File();
-        iov_[1].iov_len = response_.FileLen();
-        iovCnt_ = 2;
+        fileIov_.iov_base = response_.File();
+        fileIov_.iov_len = response_.FileLen();
     }
-    LOG_DEBUG("filesize:%d, %d  to %d", response_.FileLen() , iovCnt_, ToWriteBytes());
+    LOG_DEBUG("filesize:%d to %d", response_.FileLen(), ToWriteBytes());
     return true;
 }
 
 bool HttpConn::my_process(int len) {
+    if(!traced_ && request_.IsIdle() && readBuff_.ReadableBytes() > 0 && AccessLog::Instance()->Sample()) {
+        TraceBegin_();
+    }
     if(request_.my_parse(readBuff_)) 
     {
-        readBuff_.RetrieveAll();
+        // 请求头还没收全时保留残行，下次读到后接着解析
+        if(!request_.IsParsingHeader() || readBuff_.ReadableBytes() > MAX_HEADER_BYTES) {
+            readBuff_.RetrieveAll();
+        }
         return true;
     }else{
-        string str=request_.re_path();
-        response_.Init(srcDir, str, request_.IsKeepAlive(), 200);
-        string data_path=request_.getHlsPathById(str);
-        response_.MakeResponse_my(writeBuff_, data_path);
-        iov_[0].iov_base = const_cast<char*>(writeBuff_.Peek());
-        iov_[0].iov_len = writeBuff_.ReadableBytes();
-        iovCnt_ = 1;
+        const HttpRequest::String& id = request_.re_path();
+        response_.Init(srcDir, id, request_.IsKeepAlive(), 200);
         readBuff_.RetrieveAll();
+        if(traced_) {
+            AccessLog::Copy(trace_.video, sizeof(trace_.video), id);
+            AccessLog::Copy(trace_.path, sizeof(trace_.path), request_.os_path());
+            TraceStage_(AccessLog::STAGE_PARSED);
+        }
         return false;
     }
     return true;
 }
+
+// 新连接的第一个请求也按请求头超时算：连上后迟迟不发请求和发得很慢是同一种占坑
+HttpConn::TimeoutClass HttpConn::CurrentTimeoutClass() {
+    if(ToWriteBytes() > 0) { return TIMEOUT_WRITE; }
+    if(!request_.IsParsingHeader()) { return TIMEOUT_UPLOAD; }
+    if(served_ && request_.IsIdle() && readBuff_.ReadableBytes() == 0) { return TIMEOUT_IDLE; }
+    return TIMEOUT_HEADER;
+}
+
+HttpConn::MediaRequest HttpConn::GetMediaRequest() const {
+    std::string_view range = request_.GetHeader("range");
+    return MediaRequest{ std::string(request_.path()), std::string(request_.os_path()),
+                         std::string(range.data(), range.size()) };
+}
+
+void HttpConn::BuildResponse(const MediaRequest& req, const std::string& dataPath) {
+    response_.MakeResponse_my(writeBuff_, dataPath, req.range);
+    fileIov_ = { nullptr, 0 };
+    if(traced_) { TraceStage_(AccessLog::STAGE_BUILT); }
+}
+
+void HttpConn::BuildBusyResponse() {
+    response_.MakeBusy(writeBuff_);
+    fileIov_ = { nullptr, 0 };
+    if(traced_) { TraceStage_(AccessLog::STAGE_BUILT); }
+}
+
+void HttpConn::TraceBegin_() {
+    traced_ = true;
+    traceMark_ = bytesSent_;
+    trace_ = AccessLog::Record();
+    trace_.wallNs = AccessLog::WallNs();
+    trace_.stage[AccessLog::STAGE_START] = AccessLog::NowNs();
+    trace_.ip = addr_.sin_addr.s_addr;
+    trace_.port = ntohs(addr_.sin_port);
+}
+
+void HttpConn::TraceStage_(AccessLog::Stage stage) {
+    trace_.stage[stage] = AccessLog::NowNs();
+}
+
+// 请求头都没收全就断开的不算一个请求，不记录
+void HttpConn::TraceEnd_(bool aborted) {
+    traced_ = false;
+    if(!trace_.stage[AccessLog::STAGE_PARSED]) { return; }
+    if(!aborted) { TraceStage_(AccessLog::STAGE_DONE); }
+    trace_.aborted = aborted;
+    trace_.status = trace_.stage[AccessLog::STAGE_BUILT] ? response_.Code() : 0;     // 0：响应还没生成
+    trace_.bytes = bytesSent_ - traceMark_;
+    AccessLog::Instance()->Submit(trace_);
+}
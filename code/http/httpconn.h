@@ -6,10 +6,14 @@
 #include <arpa/inet.h>   // sockaddr_in
 #include <stdlib.h>      // atoi()
 #include <errno.h>      
+#include <atomic>
+#include <coroutine>
 
 #include "../log/log.h"
+#include "../log/accesslog.h"
 #include "../tool/Hex.h"
 #include "../buffer/buffer.h"
+#include "../timer/timingwheel.h"
 #include "httprequest.h"
 #include "httpresponse.h"
 /*
@@ -29,11 +33,59 @@ public:
     const char* GetIP() const;
     sockaddr_in GetAddr() const;
     bool process();
-    bool my_process(int len);
+    bool my_process(int len);   // 返回 false 表示分片请求已收全，等待查库
+    void ReleaseIdle();     // 没有待处理数据时归还缓冲区内存
+
+    // 查库需要的字段，拷贝出来交给 DB 执行器；查库期间连接可能被关闭、fd 被复用
+    struct MediaRequest {
+        std::string id, subPath, range;
+    };
+    MediaRequest GetMediaRequest() const;
+    void BuildResponse(const MediaRequest& req, const std::string& dataPath);
+    void BuildBusyResponse();
+    // 每次 init 加一，异步续体据此判断连接是否还是发起请求时的那一个
+    uint32_t Generation() const { return generation_.load(std::memory_order_acquire); }
+
+    // 连接是否交给了工作线程（含查库、组包）还没投递完成事件；只在 reactor 线程读写
+    bool IsBusy() const { return busy_; }
+    void SetBusy(bool busy) { busy_ = busy; }
+    // 忙时到期的连接先记下，等它的完成事件回到 reactor 再关闭
+    bool IsClosePending() const { return closePending_; }
+    void SetClosePending(bool pending) { closePending_ = pending; }
+
+    // 处理该连接的工作线程下标（按收包 CPU 选出），-1 表示不指定
+    void SetWorker(int worker) { worker_ = worker; }
+    int Worker() const { return worker_; }
+
+    // 协程模式下该连接挂起的协程，只在 reactor 线程上设置和恢复；关闭时清空
+    void SetCoroutine(std::coroutine_handle<> h) { co_ = h; }
+    std::coroutine_handle<> Coroutine() const { return co_; }
+
+    // 嵌在连接里的超时定时器结点，由 reactor 的时间轮管理
+    WheelNode* Timer() { return &timer_; }
+
+    // 超时分类：按连接把控制权交回客户端时在等什么来选
+    enum TimeoutClass {
+        TIMEOUT_HEADER,     // 新连接或已收到部分请求头：等请求头收全
+        TIMEOUT_IDLE,       // 保活连接发完响应：等下一个请求
+        TIMEOUT_UPLOAD,     // 请求体（上传）还没收全：等更多数据
+        TIMEOUT_WRITE,      // 响应没写完：等客户端读走
+        TIMEOUT_CLASSES,
+    };
+    TimeoutClass CurrentTimeoutClass();
+    // 当前定时器属于哪一类、绝对截止时间、写窗口开始时的已发送字节数；只在 reactor 线程读写
+    struct TimeoutState {
+        int cls = -1;       // -1 表示还没设置过
+        uint64_t deadline = 0;
+        size_t sentMark = 0;
+    };
+    TimeoutState& Timeout() { return timeout_; }
+    // 连接建立以来写出的字节数，写超时据此判断客户端读得够不够快
+    size_t BytesSent() const { return bytesSent_; }
 
     // 写的总长度
     int ToWriteBytes() { 
-        return iov_[0].iov_len + iov_[1].iov_len; 
+        return writeBuff_.ReadableBytes() + fileIov_.iov_len + response_.BodyRemain(); 
     }
 
     bool IsKeepAlive() const {
@@ -43,23 +95,43 @@ public:
     static bool isET;
     static const char* srcDir;
     static std::atomic<int> userCount;  // 原子，支持锁
+    static const int CHURN_LOG_PER_SEC = 10;    // 每个连接、每个请求都打的日志，每个调用点每秒最多条数
     
 private:
+    static const size_t MAX_HEADER_BYTES = 8192;   // 未完成的请求头最多缓存的字节数
    
     int fd_;
     struct  sockaddr_in addr_;
+    mutable char ip_[INET_ADDRSTRLEN];  // 第一次 GetIP 时生成，日志被限流时不转换
 
     bool isClose_;
+    std::atomic<uint32_t> generation_{0};
+    int worker_ = -1;
+    bool busy_ = false;
+    bool closePending_ = false;
+    std::coroutine_handle<> co_;
+    WheelNode timer_;
+    TimeoutState timeout_;
+    size_t bytesSent_ = 0;
+    bool served_ = false;   // 已经发完过一个响应
+
+    // 被采样的请求在各阶段打时间点，写完或连接关闭时交给访问日志；只在持有连接的线程上读写
+    void TraceBegin_();
+    void TraceStage_(AccessLog::Stage stage);
+    void TraceEnd_(bool aborted);
+    bool traced_ = false;
+    size_t traceMark_ = 0;  // 请求开始时的 bytesSent_
+    AccessLog::Record trace_;
     
-    int iovCnt_;
-    struct iovec iov_[2];
+    static const int MAX_IOV = 16;
+
+    struct iovec fileIov_;  // mmap 文件中还没发出的部分
     
-    Buffer readBuff_; // 读缓冲区
-    Buffer writeBuff_; // 写缓冲区
+    StreamBuffer readBuff_; // 读缓冲区，连续存储供解析（可切换为镜像环形缓冲区）
+    Buffer writeBuff_; // 写缓冲区，块链存储（块来自 BlockPool），大响应体不 realloc
 
     HttpRequest request_;
     HttpResponse response_;
-    std::string os_path_="";
 };
 
 
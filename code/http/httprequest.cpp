@@ -18,126 +18,374 @@ struct Variant {
     std::string name;
     int width;
     int height;
-    std::string bitrate;
-    std::string audio_bitrate;
+    int videoKbps;
+    int audioKbps;
+    double fps = 0;     // 0 表示保持源帧率
 };
 
+// 码率阶梯上限，实际输出由 SelectLadder 按源文件裁剪
 static const std::vector<Variant> kVariants = {
-    {"360p", 640, 360, "800k", "96k"},
-    {"720p", 1280, 720, "2000k", "128k"},
-    {"1080p", 1920, 1080, "5000k", "192k"}
+    {"360p", 640, 360, 800, 96},
+    {"720p", 1280, 720, 2000, 128},
+    {"1080p", 1920, 1080, 5000, 192}
 };
 
-void HttpRequest::convertToHLSAsync(std::string input, std::string outputDir) {
-    std::thread([this, input = std::move(input), outputDir = std::move(outputDir)]() {
+static const char* kHlsTargetDuration = "4";
+static const char* kVideoCodecs = "avc1.42E01F";    // H.264 baseline 3.1
+static const char* kAudioCodecs = "mp4a.40.2";      // AAC-LC
+static const int kCmafAudioKbps = 128;
+
+bool HttpRequest::useCmaf = false;
+bool HttpRequest::singleFile = false;
+
+// 原子替换文件内容：先写 .tmp 再 rename，播放器不会读到写了一半的 m3u8
+static bool WriteFileAtomic(const std::string& path, const std::string& content) {
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return false;
+        out << content;
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+// 转码结束后把 EVENT 列表定稿为 VOD，并保证带 ENDLIST
+static void FinalizeVariantPlaylist(const std::string& playlist) {
+    std::ifstream in(playlist, std::ios::binary);
+    if (!in.is_open()) return;
+    std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+
+    const std::string eventTag = "#EXT-X-PLAYLIST-TYPE:EVENT";
+    size_t pos = content.find(eventTag);
+    if (pos != std::string::npos) {
+        content.replace(pos, eventTag.size(), "#EXT-X-PLAYLIST-TYPE:VOD");
+    }
+    if (content.find("#EXT-X-ENDLIST") == std::string::npos) {
+        if (!content.empty() && content.back() != '\n') content += "\n";
+        content += "#EXT-X-ENDLIST\n";
+    }
+    WriteFileAtomic(playlist, content);
+}
+
+static int Even(double v) { return std::max(2, (int)(v / 2 + 0.5) * 2); }
+
+// 按源文件裁剪码率阶梯：不放大分辨率，各档码率不超过源码率，低档在高帧率源上减半帧率
+// 以短边作为档位高度，竖屏视频同样适用
+static std::vector<Variant> SelectLadder(const MediaInfo& src) {
+    int srcShort = std::min(src.width, src.height);
+    int srcLong = std::max(src.width, src.height);
+    double aspect = (double)srcLong / srcShort;
+    auto fit = [&](Variant var, int shortSide, int kbps) {
+        var.height = Even(shortSide);
+        var.width = Even(shortSide * aspect);
+        if (src.width < src.height) std::swap(var.width, var.height);
+        var.videoKbps = src.videoKbps > 0 ? std::min(kbps, src.videoKbps) : kbps;
+        if (src.fps > 30 && shortSide < 720) var.fps = src.fps / 2;
+        return var;
+    };
+
+    std::vector<Variant> ladder;
+    for (const auto& var : kVariants) {
+        if (var.height <= srcShort) ladder.push_back(fit(var, var.height, var.videoKbps));
+    }
+    // 源分辨率介于两档之间（或低于最低档）：补一档源分辨率，码率按像素比例由上一档折算
+    if (srcShort < kVariants.back().height && (ladder.empty() || ladder.back().height * 10 < srcShort * 9)) {
+        const Variant& upper = kVariants[ladder.size()];
+        double ratio = (double)srcShort * srcShort / ((double)upper.height * upper.height);
+        Variant native = upper;
+        native.name = std::to_string(Even(srcShort)) + "p";
+        ladder.push_back(fit(native, srcShort, std::max(200, (int)(upper.videoKbps * ratio))));
+    }
+    return ladder;
+}
+
+// master 列表；iframeBps 非空时追加各码率的 I 帧列表（拖动/快进用），与 ladder 一一对应
+// cmaf 模式：视频各路只含视频轨，音频作为 EXT-X-MEDIA 分组引用
+static std::string BuildMasterPlaylist(const std::vector<Variant>& ladder, const std::vector<int>& iframeBps,
+                                       bool cmaf = false, bool audio = true) {
+    std::string master = cmaf ? "#EXTM3U\n#EXT-X-VERSION:7\n#EXT-X-INDEPENDENT-SEGMENTS\n\n"
+                       : iframeBps.empty() ? "#EXTM3U\n#EXT-X-VERSION:3\n\n" : "#EXTM3U\n#EXT-X-VERSION:4\n\n";
+    if (cmaf && audio) {
+        master += "#EXT-X-MEDIA:TYPE=AUDIO,GROUP-ID=\"aud\",NAME=\"default\",DEFAULT=YES,AUTOSELECT=YES,URI=\"audio/index.m3u8\"\n\n";
+    }
+    for (const auto& var : ladder) {
+        int totalBps = (var.videoKbps + (!audio ? 0 : cmaf ? kCmafAudioKbps : var.audioKbps)) * 1000;
+        master += "#EXT-X-STREAM-INF:BANDWIDTH=" + std::to_string(totalBps)
+                + ",RESOLUTION=" + std::to_string(var.width) + "x" + std::to_string(var.height);
+        if (cmaf) {
+            master += std::string(",CODECS=\"") + kVideoCodecs + (audio ? std::string(",") + kAudioCodecs : "") + "\"";
+            if (audio) master += ",AUDIO=\"aud\"";
+        }
+        master += "\n" + var.name + "/index.m3u8\n\n";
+    }
+    for (size_t i = 0; i < iframeBps.size() && i < ladder.size(); ++i) {
+        if (iframeBps[i] <= 0) continue;
+        const auto& var = ladder[i];
+        master += "#EXT-X-I-FRAME-STREAM-INF:BANDWIDTH=" + std::to_string(iframeBps[i])
+                + ",RESOLUTION=" + std::to_string(var.width) + "x" + std::to_string(var.height)
+                + ",URI=\"" + var.name + "/iframe.m3u8\"\n";
+    }
+    return master;
+}
+
+// 单路输出的 HLS 参数；cmaf 模式输出 init.mp4 + .m4s；single 模式整路写成一个文件，列表用 EXT-X-BYTERANGE
+static std::string HlsOutputArgs(const std::string& varDir, bool cmaf, bool single) {
+    std::string args = std::string("-hls_time ") + kHlsTargetDuration + " -hls_list_size 0 "
+                       "-hls_playlist_type event -hls_flags temp_file+independent_segments"
+                       + (single ? "+single_file " : " ");
+    std::string segName = single ? "index" : "index%03d";
+    if (cmaf) {
+        args += "-hls_segment_type fmp4 -hls_fmp4_init_filename init.mp4 "
+                "-hls_segment_filename \"" + varDir + "/" + segName + ".m4s\" ";
+    } else {
+        args += "-hls_segment_filename \"" + varDir + "/" + segName + ".ts\" ";
+    }
+    return args + "-f hls \"" + varDir + "/index.m3u8\" ";
+}
+
+void updateVideoStatus(const std::string& video_id, bool success, const std::string& hls_url);
+
+void HttpRequest::convertToHLSAsync(std::string input, std::string outputDir, std::string videoId) {
+    bool cmaf = useCmaf, single = singleFile;
+    // 在流水线执行器上转码，不再每个视频 detach 一个线程；排满时直接标记失败
+    bool queued = Executors::Instance()->Pipeline([cmaf, single, input, outputDir, videoId]() {
+        std::string masterPath = outputDir + "/master.m3u8";
         try {
             std::string safeIn = SafePath(input);
             std::string safeOut = SafePath(outputDir);
 
             if (access(safeIn.c_str(), F_OK) != 0) {
                 std::cerr << "[HLS] File not found: " << safeIn << "\n";
+                updateVideoStatus(videoId, false, masterPath);
                 return;
             }
 
             // 创建输出目录
             std::system(("mkdir -p " + safeOut).c_str());
 
-            std::vector<std::string> variantPaths;
-
-            // 1. 为每个码率生成 HLS 子流
-            for (const auto& var : kVariants) {
-                std::string varDir = safeOut + "/" + var.name;
+            // 探测源文件，只输出有意义的档位；探测失败时退回完整阶梯
+            MediaInfo src;
+            bool probed = MediaProbe::Probe(safeIn, &src);
+            std::vector<Variant> ladder = probed ? SelectLadder(src) : kVariants;
+            // 探测失败时不知道有没有音轨：TS 按可选映射带上（没有音轨也不报错），CMAF 不单独出音频一路
+            bool audio = probed ? src.hasAudio : !cmaf;
+
+            // CMAF 要求每个分片只含一条轨道：视频各路去掉音频，音频单独一路
+            std::vector<std::string> renditions;
+            for (const auto& var : ladder) { renditions.push_back(var.name); }
+            if (cmaf && audio) { renditions.push_back("audio"); }
+
+            // 1. 先发布 master 和空的 EVENT 子列表，播放器可以立即开始轮询
+            std::string emptyEvent = std::string("#EXTM3U\n#EXT-X-VERSION:") + (cmaf ? "7" : "3") + "\n"
+                                   + "#EXT-X-TARGETDURATION:" + kHlsTargetDuration + "\n"
+                                   + "#EXT-X-MEDIA-SEQUENCE:0\n"
+                                   + "#EXT-X-PLAYLIST-TYPE:EVENT\n"
+                                   + (cmaf ? "#EXT-X-MAP:URI=\"init.mp4\"\n" : "");
+            for (const auto& name : renditions) {
+                std::string varDir = safeOut + "/" + name;
                 std::system(("mkdir -p \"" + varDir + "\"").c_str()); // 加引号防路径含空格
+                WriteFileAtomic(varDir + "/index.m3u8", emptyEvent);
+            }
+            WriteFileAtomic(masterPath, BuildMasterPlaylist(ladder, {}, cmaf, audio));
 
-                std::string segPattern = varDir + "/index%03d.ts";
-                std::string playlist = varDir + "/index.m3u8";
-
-                std::string vf = "scale=" + std::to_string(var.width) + ":" + std::to_string(var.height)
-                               + ":force_original_aspect_ratio=decrease,"
-                               + "pad=" + std::to_string(var.width) + ":" + std::to_string(var.height)
-                               + ":(ow-iw)/2:(oh-ih)/2";
-
-                std::string cmd =
-                    "ffmpeg -y -i \"" + safeIn + "\" "
-                    "-vf \"" + vf + "\" "
-                    "-c:v libx264 -profile:v baseline -level 3.1 "
-                    "-b:v " + var.bitrate + " -maxrate " + var.bitrate + " -bufsize " + var.bitrate + " "
-                    "-c:a aac -b:a " + var.audio_bitrate + " -ar 44100 "
-                    "-hls_time 4 -hls_list_size 0 "
-                    "-hls_segment_filename \"" + segPattern + "\" "
-                    "-f hls \"" + playlist + "\" "
-                    "2>/dev/null";
-
-                LOG_INFO("[HLS] Encoding %s", var.name.c_str());
-
-                int ret = std::system(cmd.c_str());
-                if (ret != 0) {
-                    std::cerr << "[HLS] Failed to encode " << var.name << ", see " << varDir << "/ffmpeg.log\n";
-                    continue;
+            // 2. 一次解码、同时输出所有码率，各子列表同步增长；
+            //    event 类型下 ffmpeg 每完成一个分片就以 tmp+rename 方式追加到列表
+            std::string cmd = "ffmpeg -y -i \"" + safeIn + "\" ";
+            for (const auto& var : ladder) {
+                std::string varDir = safeOut + "/" + var.name;
+                std::string kbps = std::to_string(var.videoKbps) + "k";
+
+                // 探测成功时宽高已按源比例算好，直接缩放，不再加黑边
+                std::string size = std::to_string(var.width) + ":" + std::to_string(var.height);
+                std::string vf = probed ? "scale=" + size
+                               : "scale=" + size + ":force_original_aspect_ratio=decrease,pad=" + size + ":(ow-iw)/2:(oh-ih)/2";
+                if (var.fps > 0) vf += ",fps=" + std::to_string(var.fps);
+
+                cmd += "-map 0:v:0 -vf \"" + vf + "\" "
+                       "-c:v libx264 -profile:v baseline -level 3.1 "
+                       "-b:v " + kbps + " -maxrate " + kbps + " -bufsize " + kbps + " "
+                       "-force_key_frames \"expr:gte(t,n_forced*" + kHlsTargetDuration + ")\" ";  // 固定间隔关键帧，分片时长均匀
+                if (cmaf || !audio) {
+                    cmd += "-an ";
+                } else {
+                    cmd += "-map 0:a:0? -c:a aac -b:a " + std::to_string(var.audioKbps) + "k -ar 44100 ";
                 }
-                variantPaths.push_back(var.name + "/index.m3u8");
+                cmd += HlsOutputArgs(varDir, cmaf, single);
             }
+            if (cmaf && audio) {
+                cmd += "-map 0:a:0 -vn -c:a aac -b:a " + std::to_string(kCmafAudioKbps) + "k -ar 44100 "
+                     + HlsOutputArgs(safeOut + "/audio", true, single);
+            }
+            cmd += "2>/dev/null";
 
-            if (!variantPaths.empty()) {
-                std::string masterPath = safeOut + "/master.m3u8";
-                std::ofstream master(masterPath);
-                if (master.is_open()) {
-                    master << "#EXTM3U\n";
-                    master << "#EXT-X-VERSION:3\n\n";
-
-                    for (size_t i = 0; i < variantPaths.size(); ++i) {
-                        const auto& var = kVariants[i];
-                        // 计算总码率 (bps)
-                        auto parseBitrate = [](const std::string& br) -> int {
-                            std::string s = br;
-                            if (s.back() == 'k' || s.back() == 'K') {
-                                return std::stoi(s.substr(0, s.size()-1)) * 1000;
-                            }
-                            return std::stoi(s);
-                        };
-                        int totalBps = parseBitrate(var.bitrate) + parseBitrate(var.audio_bitrate);
-
-                        std::string resolution = std::to_string(var.width) + "x" + std::to_string(var.height);
-
-                        master << "#EXT-X-STREAM-INF:BANDWIDTH=" << totalBps
-                               << ",RESOLUTION=" << resolution << "\n";
-                        master << variantPaths[i] << "\n\n";
-                    }
-                    master.close();
-                    
+            LOG_INFO("[HLS] Encoding %s (%d renditions, %s%s, progressive)", videoId.c_str(),
+                     (int)renditions.size(), cmaf ? "CMAF" : "TS", single ? " single-file" : "");
+
+            int ret = std::system(cmd.c_str());
+            if (ret != 0) {
+                std::cerr << "[HLS] Failed to encode " << videoId << "\n";
+                updateVideoStatus(videoId, false, masterPath);
+                return;
+            }
+
+            // 3. 全部完成：EVENT -> VOD + ENDLIST，状态 processing -> ready
+            //    TS：建立分片索引并生成 I 帧列表；CMAF：生成引用同一批分片的 DASH MPD
+            std::vector<int> iframeBps;
+            for (const auto& name : renditions) {
+                std::string varDir = safeOut + "/" + name;
+                FinalizeVariantPlaylist(varDir + "/index.m3u8");
+                if (!cmaf) iframeBps.push_back(TsIndexer::IndexRendition(varDir, "index.m3u8"));
+            }
+            if (cmaf) {
+                std::vector<DashRendition> reps;
+                for (const auto& var : ladder) {
+                    DashRendition r;
+                    r.dir = var.name;
+                    r.bandwidth = var.videoKbps * 1000;
+                    r.width = var.width;
+                    r.height = var.height;
+                    r.codecs = kVideoCodecs;
+                    reps.push_back(r);
+                }
+                if (audio) {
+                    DashRendition r;
+                    r.dir = "audio";
+                    r.audio = true;
+                    r.bandwidth = kCmafAudioKbps * 1000;
+                    r.codecs = kAudioCodecs;
+                    reps.push_back(r);
                 }
+                DashMpd::Write(safeOut, reps);
             }
+            WriteFileAtomic(masterPath, BuildMasterPlaylist(ladder, iframeBps, cmaf, audio));
+            updateVideoStatus(videoId, true, masterPath);
 
             LOG_INFO("[HLS] Conversion completed.");
         } catch (const std::exception& e) {
             std::cerr << "[HLS] Exception: " << e.what() << "\n";
+            updateVideoStatus(videoId, false, masterPath);
+        }
+    });
+    if (!queued) {
+        LOG_ERROR("[HLS] Pipeline executor full, %s not encoded", videoId.c_str());
+        updateVideoStatus(videoId, false, outputDir + "/master.m3u8");
+    }
+}
+
+// 分片合并（磁盘）-> 写库（数据库）-> 转码（流水线），全程不占网络线程；
+// 只捕获值，连接在此期间关闭或被复用都不影响
+void HttpRequest::CompleteUpload(std::string upload_id, std::string filename, int total_chunks, std::string display_name) {
+    struct Merged {
+        std::string output_path, output_dir, video_id;
+        bool jit;
+    };
+    bool queued = Executors::Instance()->Disk([upload_id, filename, total_chunks]() {
+        std::string chunk_dir = "./sever_videodata/" + upload_id;
+        std::string output_path = "./sever_videodata/" + filename;
+        LOG_INFO("Combining chunks for upload_id: %s, filename: %s, total_chunks: %d", 
+                 upload_id.c_str(), filename.c_str(), total_chunks);
+        std::ofstream out_file(output_path, std::ios::binary);
+        for (int i = 0; i < total_chunks; ++i) {
+            std::string chunk_path = chunk_dir + "/chunk_" + std::to_string(i);
+            std::ifstream chunk_file(chunk_path, std::ios::binary);
+            out_file << chunk_file.rdbuf();
+            std::remove(chunk_path.c_str());
+            chunk_file.close();
+        }
+        out_file.close();
+
+        std::string video_id = "vid_" + std::to_string(time(nullptr)) + "_" + std::to_string(rand() % 10000);
+        std::string output_dir = "./muts_ts/" + video_id + "_out"; 
+        // 可直接封装的源(H.264/AAC)走即时打包，不生成 .ts，直接 ready
+        bool jit = JitPackager::Instance()->Publish(output_path, output_dir);
+        return Merged{ output_path, output_dir, video_id, jit };
+    }, [display_name](Merged m) {
+        MYSQL* sql = nullptr;
+        {
+            SqlConnRAII raii(&sql, SqlConnPool::Instance()); // 自动获取+归还连接
+            if (sql) {
+                // 安全转义字符串（防 SQL 注入）
+                auto escape = [sql](const std::string& s) -> std::string {
+                    if (s.empty()) return "";
+                    std::string res;
+                    res.resize(s.size() * 2 + 1); // 转义后最长为 2n+1
+                    unsigned long len = mysql_real_escape_string(sql, &res[0], s.c_str(), s.size());
+                    res.resize(len);
+                    return res;
+                };
+
+                std::string escaped_id = escape(m.video_id);
+                std::string escaped_name = escape(display_name);
+                std::string hls_path = m.output_dir + "/master.m3u8";
+                std::string insert_sql =
+                        "INSERT INTO videos (id, original_name, hls_path, status, created_at) VALUES ('"
+                        + escaped_id + "', '"
+                        + escaped_name + "', '"
+                        + escape(hls_path) + "', '"
+                        + (m.jit ? "ready" : "processing") + "', "
+                        + "NOW()" + ")";   
+                if (mysql_query(sql, insert_sql.c_str())) {
+                    std::cerr << "[DB ERROR] Insert failed: " << mysql_error(sql) << std::endl;
+                } else {
+                    std::cout << "[INFO] Video record inserted: " << m.video_id << std::endl;
+                }
+            }
+        }
+        // 先落库为 processing 再开始转码，转码完成后由流水线线程更新为 ready
+        if (!m.jit) {
+            convertToHLSAsync(m.output_path, m.output_dir, m.video_id);
         }
-    }).detach();
+    }, Executors::DB);
+    if (!queued) {
+        LOG_ERROR("Disk executor full, upload %s not combined", upload_id.c_str());
+    }
 }
 
 
 // 网页名称，和一般的前端跳转不同，这里需要将请求信息放到后端来验证一遍再上传（和小组成员还起过争执）
-const unordered_set<string> HttpRequest::DEFAULT_HTML {
+const unordered_set<string_view> HttpRequest::DEFAULT_HTML {
     "/index", "/register", "/login", "/welcome", "/video", "/picture",
 };
 
 // 登录/注册
-const unordered_map<string, int> HttpRequest::DEFAULT_HTML_TAG {
+const unordered_map<string_view, int> HttpRequest::DEFAULT_HTML_TAG {
     {"/login.html", 1}, {"/register.html", 0}
 };
 
-// 初始化操作，一些清零操作
+// arena 的第一块取半个 BlockPool 块，加上 arena 自己的记账仍落在一个标准块内
+HttpRequest::HttpRequest()
+    : arena_(BlockPool::Instance()->BlockSize() / 2, &blockResource_),
+      method_(&arena_), path_(&arena_), version_(&arena_), body_(&arena_),
+      header_(&arena_), post_(&arena_), os_path_(&arena_) {
+    Init();
+}
+
+// 与空容器交换：旧内容在 arena 释放前析构，不会留下指向已释放内存的容器
+template<typename T>
+static void ResetTo(T& v, std::pmr::memory_resource* arena) {
+    T(arena).swap(v);
+}
+
+// 初始化操作，一些清零操作；请求期间的分配随 arena 一次性归还
 void HttpRequest::Init() {
     state_ = REQUEST_LINE;  // 初始状态
-    method_ = path_ = version_= body_ = "";
-    header_.clear();
-    post_.clear();
+    ResetTo(method_, &arena_);
+    ResetTo(path_, &arena_);
+    ResetTo(version_, &arena_);
+    ResetTo(body_, &arena_);
+    ResetTo(os_path_, &arena_);
+    ResetTo(header_, &arena_);
+    ResetTo(post_, &arena_);
     content_length_ = 0;
-    body_.clear();
+    upload_.reset();
+    download_in_progress_ = false;
+    comlete_singal = false;
+    arena_.release();
 }
 
 // 解析处理
-bool HttpRequest::parse(Buffer& buff) {
+bool HttpRequest::parse(StreamBuffer& buff) {
     const char END[] = "\r\n";
     if(buff.ReadableBytes() == 0)   // 没有可读的字节
         return false;
@@ -145,7 +393,7 @@ bool HttpRequest::parse(Buffer& buff) {
     while(buff.ReadableBytes() && state_ != FINISH) {
         // 从buff中的读指针开始到读指针结束，这块区域是未读取得数据并去处"\r\n"，返回有效数据得行末指针
         const char* lineend = search(buff.Peek(), buff.BeginWriteConst(), END, END+2);
-        string line(buff.Peek(), lineend);
+        string_view line(buff.Peek(), lineend - buff.Peek());
         switch (state_)
         {
         case REQUEST_LINE:
@@ -178,7 +426,7 @@ bool HttpRequest::parse(Buffer& buff) {
 }
 
 
-bool HttpRequest::my_parse(Buffer& buff) {
+bool HttpRequest::my_parse(StreamBuffer& buff) {
         const char CRLF[] = "\r\n";
         
         while (buff.ReadableBytes() > 0 && state_ != FINISH) {
@@ -193,7 +441,8 @@ bool HttpRequest::my_parse(Buffer& buff) {
                     break; 
                 }
                 
-                std::string line(buff.Peek(), line_end);
+                // 行直接指向缓冲区，Retrieve 只移动下标，本轮内数据仍有效
+                std::string_view line(buff.Peek(), line_end - buff.Peek());
                 buff.RetrieveUntil(line_end + 2);
                 
                 if (state_ == REQUEST_LINE) {
@@ -204,17 +453,18 @@ bool HttpRequest::my_parse(Buffer& buff) {
                         state_= FINISH;
                         break;
                     }
-                    if (method_ == "GET") {
-                    state_ = FINISH;
-                    return false;
-                }
                 } else if (state_ == HEADERS) {
                     if (line.empty()) { // Headers结束
+                        if (method_ == "GET") { // GET 没有请求体，读完头部(Range 等)即可响应
+                            state_ = FINISH;
+                            return false;
+                        }
                         if (!header_.count("content-length")) {
                             state_ = FINISH;
                             return true;
                         }
-                        content_length_ = std::stoul(header_["content-length"]);
+                        content_length_ = strtoul(header_.find("content-length")->second.c_str(), nullptr, 10);
+                        upload_.reset(new UploadState());   // 带请求体的 POST 才分配上传状态
                         
                         // 解析boundary
                         if (parseMultipartBoundary()) {
@@ -238,7 +488,7 @@ bool HttpRequest::my_parse(Buffer& buff) {
                 std::string line(buff.Peek(), line_end);
                 buff.RetrieveUntil(line_end + 2);
                 
-                if (line == boundary_marker_) {
+                if (line == upload_->boundary_marker) {
                     state_ = BODY_DATA;
                 } else {
                     return true; // 格式错误
@@ -251,7 +501,7 @@ bool HttpRequest::my_parse(Buffer& buff) {
                     CRLF, CRLF + 2
                 );
                 
-                if (!in_file_part_) {
+                if (!upload_->in_file_part) {
                     // 解析Content-Disposition和Content-Type
                     if (line_end == buff.BeginWriteConst()) break;
                     
@@ -259,13 +509,13 @@ bool HttpRequest::my_parse(Buffer& buff) {
                     buff.RetrieveUntil(line_end + 2);
                     
                     if (line.find("Content-Disposition") == 0) {
-                        is_file_part_ = extractFilenameFromDisposition(line); // 记录是否是文件
+                        upload_->is_file_part = extractFilenameFromDisposition(line); // 记录是否是文件
                     }
                     // 继续读 headers，直到空行
                     if (line.empty()) {
                         // Headers 结束
-                        if (is_file_part_) {
-                            in_file_part_ = true;
+                        if (upload_->is_file_part) {
+                            upload_->in_file_part = true;
                             openVideoFile();
                         }
                     }
@@ -277,7 +527,7 @@ bool HttpRequest::my_parse(Buffer& buff) {
 
                 // 先尝试找 closing boundary（带 --）
                 const char* closing_pos = std::search(data, end, 
-                    boundary_end_.c_str(), boundary_end_.c_str() + boundary_end_.size());
+                    upload_->boundary_end.c_str(), upload_->boundary_end.c_str() + upload_->boundary_end.size());
 
                 if (closing_pos != end) {
                     // 检查前面是否有 \r\n
@@ -286,22 +536,22 @@ bool HttpRequest::my_parse(Buffer& buff) {
                         // 文件数据截止于 \r\n 之前
                         size_t file_data_len = (closing_pos - 2) - data;
                         if (file_data_len > 0) {
-                            video_file_.write(data, file_data_len);
-                            body_received_ += file_data_len;
+                            upload_->video_file.write(data, file_data_len);
+                            upload_->body_received += file_data_len;
                         }
                         // 消费到 closing boundary 结束
-                        buff.RetrieveUntil(closing_pos + boundary_end_.size());
+                        buff.RetrieveUntil(closing_pos + upload_->boundary_end.size());
                         state_ = FINISH;
-                        in_file_part_ = false;
-                        video_file_.close();
+                        upload_->in_file_part = false;
+                        upload_->video_file.close();
                         continue; // 继续循环，处理剩余数据（如有）
                     }
                 }
 
                 size_t readable = buff.ReadableBytes();
                 if (readable > 0) {
-                    video_file_.write(data, readable);
-                    body_received_ += readable;
+                    upload_->video_file.write(data, readable);
+                    upload_->body_received += readable;
                     buff.Retrieve(readable);
                 }
             }
@@ -317,105 +567,62 @@ bool HttpRequest::my_parse(Buffer& buff) {
                 
                 buff.RetrieveUntil(line_end + 2);
                 state_ = FINISH;
-                video_file_.close(); // 关闭文件
+                upload_->video_file.close(); // 关闭文件
             }
         }
         if(state_ == FINISH&&!download_in_progress_&&comlete_singal) {
-
-                std::string upload_id, filename;
-            int total_chunks = -1;
-
-            auto extractField = [](const std::string& json, const std::string& key) -> std::string {
-                size_t pos = json.find("\"" + key + "\":");
-                if (pos == std::string::npos) return "";
-                pos = json.find('"', pos + key.size() + 3); // 跳过 ":"
-                if (pos == std::string::npos) return "";
-                size_t start = pos + 1;
-                size_t end = json.find('"', start);
-                if (end == std::string::npos) return "";
-                return json.substr(start, end - start);
-            };
-
-            auto extractIntField = [](const std::string& json, const std::string& key) -> int {
-                size_t pos = json.find("\"" + key + "\":");
-                if (pos == std::string::npos) return -1;
-                size_t start = pos + key.size() + 3; // 跳过 ":"
-                while (start < json.size() && isspace(json[start])) start++;
-                size_t end = start;
-                while (end < json.size() && isdigit(json[end])) end++;
-                if (end == start) return -1;
-                return std::stoi(json.substr(start, end - start));
-            };
-
-            upload_id = extractField(buff.Peek(), "upload_id");
-            filename = extractField(buff.Peek(), "filename");
-            total_chunks = extractIntField(buff.Peek(), "total_chunks");
-            std::string chunk_dir = "./sever_videodata/" + upload_id;
-            std::string output_path = "./sever_videodata/" + filename;
-            LOG_INFO("Combining chunks for upload_id: %s, filename: %s, total_chunks: %d", 
-                     upload_id.c_str(), filename.c_str(), total_chunks);
-            std::ofstream out_file(output_path, std::ios::binary);
-            for (int i = 0; i < total_chunks; ++i) {
-                std::string chunk_path = chunk_dir + "/chunk_" + std::to_string(i);
-                std::ifstream chunk_file(chunk_path, std::ios::binary);
-                out_file << chunk_file.rdbuf();
-                std::remove(chunk_path.c_str());
-                chunk_file.close();
-            }
-            out_file.close();
-
-            std::string video_id = "vid_" + std::to_string(time(nullptr)) + "_" + std::to_string(rand() % 10000);
-    
-            std::string output_dir = "./muts_ts/" + video_id + "_out"; 
-
-            convertToHLSAsync(output_path, output_dir);
+            UploadCompletion done;
+            ParseUploadComplete(buff, &done);
             download_in_progress_ = true;
-            MYSQL* sql = nullptr;
-        {
-            SqlConnRAII raii(&sql, SqlConnPool::Instance()); // 自动获取+归还连接
-            if (sql) {
-                // 安全转义字符串（防 SQL 注入）
-                auto escape = [sql](const std::string& s) -> std::string {
-                    if (s.empty()) return "";
-                    std::string res;
-                    res.resize(s.size() * 2 + 1); // 转义后最长为 2n+1
-                    unsigned long len = mysql_real_escape_string(sql, &res[0], s.c_str(), s.size());
-                    res.resize(len);
-                    return res;
-                };
-
-                std::string escaped_id = escape(video_id);
-                std::string escaped_name = escape(filename_);
-                std::string hls_path = output_dir + "/master.m3u8";
-                std::string insert_sql =
-                        "INSERT INTO videos (id, original_name, hls_path, status, created_at) VALUES ('"
-                        + escaped_id + "', '"
-                        + escaped_name + "', '"
-                        + escape(hls_path) + "', '"
-                        + "ready" + "', "
-                        + "NOW()" + ")";   
-                if (mysql_query(sql, insert_sql.c_str())) {
-                    std::cerr << "[DB ERROR] Insert failed: " << mysql_error(sql) << std::endl;
-                } else {
-                    std::cout << "[INFO] Video record inserted: " << video_id << std::endl;
-                }
-            }
-        }
+            // 完成请求是单独的一个请求，分片上传的状态在 Init() 时已经释放，显示名取请求体里的 filename
+            CompleteUpload(done.uploadId, done.filename, done.totalChunks, done.filename);
         }
         
         return true;
     }
-bool HttpRequest::ParseRequestLine_(const string& line) {
-    // cout<<"ParseRequestLine_ called"<<endl;
-    regex patten("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
-    smatch Match;   // 用来匹配patten得到结果
-    // 在匹配规则中，以括号()的方式来划分组别 一共三个括号 [0]表示整体
-    if(regex_match(line, Match, patten)) {  // 匹配指定字符串整体是否符合
-        method_ = Match[1];
-        path_ = Match[2];
-        version_ = Match[3];
+// 完成请求里剩下的可读字节（请求头 + JSON 请求体）一次拷出来再找字段，并且全部消费掉：
+// 缓冲区的内容不以 '\0' 结尾，复用后可读区之外还留着之前请求的字节
+void HttpRequest::ParseUploadComplete(StreamBuffer& buff, UploadCompletion* out) {
+    std::string body(buff.Peek(), buff.ReadableBytes());
+    buff.Retrieve(body.size());
+
+    auto extractField = [&body](const std::string& key) -> std::string {
+        size_t pos = body.find("\"" + key + "\":");
+        if (pos == std::string::npos) return "";
+        pos = body.find('"', pos + key.size() + 3); // 跳过 ":"
+        if (pos == std::string::npos) return "";
+        size_t start = pos + 1;
+        size_t end = body.find('"', start);
+        if (end == std::string::npos) return "";
+        return body.substr(start, end - start);
+    };
+
+    auto extractIntField = [&body](const std::string& key) -> int {
+        size_t pos = body.find("\"" + key + "\":");
+        if (pos == std::string::npos) return -1;
+        size_t start = pos + key.size() + 3; // 跳过 ":"
+        while (start < body.size() && isspace(body[start])) start++;
+        size_t end = start;
+        while (end < body.size() && isdigit(body[end]) && end - start < 9) end++;
+        if (end == start) return -1;
+        return std::stoi(body.substr(start, end - start));
+    };
+
+    out->uploadId = extractField("upload_id");
+    out->filename = extractField("filename");
+    out->totalChunks = extractIntField("total_chunks");
+}
+
+// "METHOD PATH HTTP/VERSION"，规则同正则 ^([^ ]*) ([^ ]*) HTTP/([^ ]*)$，不再每行构造 regex
+bool HttpRequest::ParseRequestLine_(string_view line) {
+    size_t sp1 = line.find(' ');
+    size_t sp2 = sp1 == string_view::npos ? sp1 : line.find(' ', sp1 + 1);
+    if(sp2 != string_view::npos && line.compare(sp2 + 1, 5, "HTTP/") == 0
+       && line.find(' ', sp2 + 1) == string_view::npos) {
+        method_.assign(line.substr(0, sp1));
+        path_.assign(line.substr(sp1 + 1, sp2 - sp1 - 1));
+        version_.assign(line.substr(sp2 + 6));
         state_ = HEADERS;
-        // cout<<method_.c_str()<<endl;
         return true;
     }
     LOG_ERROR("RequestLine Error");
@@ -434,78 +641,81 @@ void HttpRequest::ParsePath_() {
 }
 
 void HttpRequest::openVideoFile() {
-        if (!filename_.empty() && !file_opened_) {
-            size_t pos=filename_.find_last_of("/");
+        if (!upload_) return;
+        if (!upload_->filename.empty() && !upload_->file_opened) {
+            size_t pos=upload_->filename.find_last_of("/");
             string dir;
             if(pos!=string::npos)
             {
-                dir="./sever_videodata/"+filename_.substr(0,pos);
+                dir="./sever_videodata/"+upload_->filename.substr(0,pos);
             }
             mkdir(dir.c_str(), 0755); // 创建目录，忽略错误
-            string all_pa="./sever_videodata/" + filename_;
+            string all_pa="./sever_videodata/" + upload_->filename;
             LOG_INFO("Opening file for writing: %s", all_pa.c_str());
-            video_file_.open(all_pa, std::ios::binary);
-            if (video_file_.is_open()) {
-                file_opened_ = true;
+            upload_->video_file.open(all_pa, std::ios::binary);
+            if (upload_->video_file.is_open()) {
+                upload_->file_opened = true;
                 // std::cout << "Started saving to: " <<all_pa << std::endl;
             } else {
                 std::cerr << "Failed to create file: " << all_pa << std::endl;
             }
         }
     }
-void HttpRequest::ParseHeader_(const std::string& line) {
+void HttpRequest::ParseHeader_(std::string_view line) {
     size_t pos = line.find(':');
-    if (pos != std::string::npos) {
-        std::string key = line.substr(0, pos);
-        std::string value = line.substr(pos + 2);
+    if (pos != std::string_view::npos) {
+        String key(line.substr(0, pos), &arena_);
         std::transform(key.begin(), key.end(), key.begin(), ::tolower);
-        header_[key] = value;
+        std::string_view value = line.substr(pos + 1);
+        while (!value.empty() && value.front() == ' ') value.remove_prefix(1);
+        header_[std::move(key)].assign(value);
     }
 
 }
 
-void HttpRequest::ParseBody_(const std::string& line) {
-    body_ = line;
+void HttpRequest::ParseBody_(std::string_view line) {
+    body_.assign(line);
     ParsePost_();
     state_ = FINISH;    // 状态转换为下一个状态
-    LOG_DEBUG("Body:%s, len:%d", line.c_str(), line.size());
+    LOG_DEBUG("Body:%s, len:%d", body_.c_str(), body_.size());
 }
 
 bool HttpRequest::extractFilenameFromDisposition(const std::string& line) {
     // 示例: Content-Disposition: form-data; name="video"; filename="1.mp4"
     size_t pos = line.find("filename=");
     if (pos == std::string::npos) return false;
+    if (!upload_) upload_.reset(new UploadState());
     
-    filename_ = line.substr(pos + 9); // 9 = len("filename=")
+    upload_->filename = line.substr(pos + 9); // 9 = len("filename=")
     
     // 去除引号
-    if (!filename_.empty() && filename_[0] == '"') {
-        size_t end_quote = filename_.find_last_of('"');
+    if (!upload_->filename.empty() && upload_->filename[0] == '"') {
+        size_t end_quote = upload_->filename.find_last_of('"');
         if (end_quote != std::string::npos) {
-            filename_ = filename_.substr(1, end_quote - 1);
+            upload_->filename = upload_->filename.substr(1, end_quote - 1);
         }
     }
     
     // 安全清理：防止路径穿越攻击
-    return !filename_.empty();
+    return !upload_->filename.empty();
 }
     
 bool HttpRequest::parseMultipartBoundary() {
         auto it = header_.find("content-type");
         if (it == header_.end()) return false;
         
-        const std::string& ct = it->second;
+        std::string_view ct = it->second;
         size_t pos = ct.find("boundary=");
-        if (pos == std::string::npos) return false;
+        if (pos == std::string_view::npos) return false;
         
-        boundary_ = ct.substr(pos + 9);
+        upload_->boundary = std::string(ct.substr(pos + 9));
         // 去除引号（如果有）
-        if (!boundary_.empty() && boundary_[0] == '"') {
-            boundary_ = boundary_.substr(1, boundary_.length() - 2);
+        if (!upload_->boundary.empty() && upload_->boundary[0] == '"') {
+            upload_->boundary = upload_->boundary.substr(1, upload_->boundary.length() - 2);
         }
         
-        boundary_marker_ = "--" + boundary_;
-        boundary_end_ = "--" + boundary_ + "--";
+        upload_->boundary_marker = "--" + upload_->boundary;
+        upload_->boundary_end = "--" + upload_->boundary + "--";
         return true;
     }
 // 16进制转化为10进制
@@ -526,7 +736,7 @@ void HttpRequest::ParsePost_() {
             LOG_DEBUG("Tag:%d", tag);
             if(tag == 0 || tag == 1) {
                 bool isLogin = (tag == 1);  // 为1则是登录
-                if(UserVerify(post_["username"], post_["password"], isLogin)) {
+                if(UserVerify(string(post_["username"]), string(post_["password"]), isLogin)) {
                     path_ = "/welcome.html";
                 } 
                 else {
@@ -541,7 +751,7 @@ void HttpRequest::ParsePost_() {
 void HttpRequest::ParseFromUrlencoded_() {
     if(body_.size() == 0) { return; }
 
-    string key, value;
+    String key(&arena_), value(&arena_);
     int num = 0;
     int n = body_.size();
     int i = 0, j = 0;
@@ -550,7 +760,7 @@ void HttpRequest::ParseFromUrlencoded_() {
         char ch = body_[i];
         switch (ch) {
         case '=':
-            key = body_.substr(j, i - j);
+            key.assign(body_, j, i - j);
             j = i + 1;
             break;
         case '+':
@@ -563,7 +773,7 @@ void HttpRequest::ParseFromUrlencoded_() {
             i += 2;
             break;
         case '&':
-            value = body_.substr(j, i - j);
+            value.assign(body_, j, i - j);
             j = i + 1;
             post_[key] = value;
             LOG_DEBUG("%s = %s", key.c_str(), value.c_str());
@@ -574,29 +784,27 @@ void HttpRequest::ParseFromUrlencoded_() {
     }
     assert(j <= i);
     if(post_.count(key) == 0 && j < i) {
-        value = body_.substr(j, i - j);
+        value.assign(body_, j, i - j);
         post_[key] = value;
     }
 }
 
-std::string HttpRequest::getHlsPathById(std::string& video_id) {
+std::string HttpRequest::getHlsPathById(std::string_view video_id, std::string_view sub_path) {
     std::string hls_path;
 
     MYSQL* sql = nullptr;
     {
         SqlConnRAII raii(&sql, SqlConnPool::Instance());
         if (sql) {
-                            auto escape = [sql](const std::string& s) -> std::string {
-                    if (s.empty()) return "";
-                    std::string res;
-                    res.resize(s.size() * 2 + 1); // 转义后最长为 2n+1
-                    unsigned long len = mysql_real_escape_string(sql, &res[0], s.c_str(), s.size());
-                    res.resize(len);
-                    return res;
-                };
             // 安全转义
-            std::string escaped_id = escape(video_id); // 你需要实现 escapeString
-            std::string query = "SELECT hls_path FROM videos WHERE id = '" + escaped_id + "' AND status = 'ready'";
+            std::string query;
+            query.reserve(video_id.size() * 2 + 96);
+            query.append("SELECT hls_path FROM videos WHERE id = '");
+            size_t idPos = query.size();
+            query.resize(idPos + video_id.size() * 2 + 1);   // 转义后最长为 2n+1
+            unsigned long len = mysql_real_escape_string(sql, &query[idPos], video_id.data(), video_id.size());
+            query.resize(idPos + len);
+            query.append("' AND status IN ('processing', 'ready')");
             
             if (mysql_query(sql, query.c_str()) == 0) {
                 MYSQL_RES* res = mysql_store_result(sql);
@@ -609,8 +817,8 @@ std::string HttpRequest::getHlsPathById(std::string& video_id) {
         }
     }
     size_t last_slash = hls_path.find_last_of('/');
-    std::string dir_path = hls_path.substr(0, last_slash);
-    hls_path=dir_path+os_path_;
+    if (last_slash != std::string::npos) hls_path.erase(last_slash);
+    hls_path.append(sub_path.data(), sub_path.size());
     
     return hls_path; // 若未找到，返回空字符串
 }
@@ -675,57 +883,83 @@ bool HttpRequest::UserVerify(const string &name, const string &pwd, bool isLogin
     return flag;
 }
 
-std::string HttpRequest::path() const{
+const HttpRequest::String& HttpRequest::path() const{
     return path_;
 }
 
-std::string& HttpRequest::path(){
+HttpRequest::String& HttpRequest::path(){
     return path_;
 }
-std::string& HttpRequest::re_path(){
+
+// 原地截取，不产生临时字符串：/vid_xxx/720p/index.m3u8 -> path_ = vid_xxx, os_path_ = /720p/index.m3u8
+HttpRequest::String& HttpRequest::re_path(){
     size_t pos = path_.find("vid_");
-    if(pos == std::string::npos)
+    if(pos == String::npos)
         return path_;
 
-    size_t start = pos;
-    size_t end   = path_.find('/', start);
-    os_path_=path_.substr(end,path_.size()-end);
-    path_ = (end == std::string::npos)
-            ? path_.substr(start)
-            : path_.substr(start, end - start);
-    // cout<<"path"<<path_.c_str()<<endl;
+    size_t end = path_.find('/', pos);
+    if(end != String::npos) {
+        os_path_.assign(path_, end, String::npos);
+        path_.erase(end);
+    }
+    path_.erase(0, pos);
     return path_; 
 }
 
-std::string HttpRequest::method() const {
+const HttpRequest::String& HttpRequest::os_path() const {
+    return os_path_;
+}
+
+const HttpRequest::String& HttpRequest::method() const {
     return method_;
 }
 
-std::string HttpRequest::version() const {
+const HttpRequest::String& HttpRequest::version() const {
     return version_;
 }
 
 std::string HttpRequest::GetPost(const std::string& key) const {
     assert(key != "");
-    if(post_.count(key) == 1) {
-        return post_.find(key)->second;
-    }
-    return "";
+    auto it = post_.find(String(key, post_.get_allocator()));
+    return it == post_.end() ? "" : std::string(it->second);
 }
 
 std::string HttpRequest::GetPost(const char* key) const {
     assert(key != nullptr);
-    if(post_.count(key) == 1) {
-        return post_.find(key)->second;
-    }
-    return "";
+    auto it = post_.find(String(key, post_.get_allocator()));
+    return it == post_.end() ? "" : std::string(it->second);
+}
+
+std::string_view HttpRequest::GetHeader(std::string_view key) const {
+    auto it = header_.find(String(key, header_.get_allocator()));
+    return it == header_.end() ? std::string_view() : std::string_view(it->second);
 }
 
+bool HttpRequest::IsParsingHeader() const {
+    return state_ == REQUEST_LINE || state_ == HEADERS;
+}
+
+bool HttpRequest::IsIdle() const {
+    return state_ == REQUEST_LINE;
+}
+
+// 头名解析时已转成小写，值不区分大小写、可能是逗号分隔的列表；HTTP/1.1 默认保活，1.0 要显式 keep-alive
 bool HttpRequest::IsKeepAlive() const {
-    if(header_.count("Connection") == 1) {
-        return header_.find("Connection")->second == "keep-alive" && version_ == "1.1";
-    }
-    return false;
+    std::string_view conn = GetHeader("connection");
+    auto has = [conn](std::string_view token) {
+        for(size_t pos = 0; pos < conn.size(); ) {
+            size_t end = conn.find(',', pos);
+            if(end == std::string_view::npos) { end = conn.size(); }
+            std::string_view item = conn.substr(pos, end - pos);
+            while(!item.empty() && item.front() == ' ') { item.remove_prefix(1); }
+            while(!item.empty() && item.back() == ' ') { item.remove_suffix(1); }
+            if(item.size() == token.size() && strncasecmp(item.data(), token.data(), token.size()) == 0) { return true; }
+            pos = end + 1;
+        }
+        return false;
+    };
+    if(version_ == "1.1") { return !has("close"); }
+    return has("keep-alive");
 }
 void updateVideoStatus(const std::string& video_id, bool success, const std::string& hls_url) {
     MYSQL* sql = nullptr;
@@ -4,14 +4,24 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <string>
-#include <regex>    // 正则表达式
+#include <string_view>
+#include <memory_resource>
+#include <algorithm>
+#include <memory>
 #include <errno.h>     
+#include <strings.h>   // strncasecmp
 #include <mysql.h>  //mysql
 #include <fstream> 
 #include "../buffer/buffer.h"
+#include "../buffer/ringbuffer.h"
 #include "../log/log.h"
 #include "../log/log.h"
 #include "../pool/sqlconnpool.h"
+#include "../pool/executors.h"
+#include "../hls/jitpackager.h"
+#include "../hls/tsindexer.h"
+#include "../hls/dashmpd.h"
+#include "../hls/mediaprobe.h"
 
 class HttpRequest {
 public:
@@ -25,31 +35,50 @@ public:
         FINISH,        
     };
     
-    HttpRequest() { Init(); }
+    // 请求期间的字符串/容器都从 arena_ 分配，Init() 时一次性释放
+    typedef std::pmr::string String;
+    typedef std::pmr::unordered_map<String, String> StringMap;
+
+    HttpRequest();
     ~HttpRequest() = default;
 
     void Init();
-    bool parse(Buffer& buff);   
-    bool my_parse(Buffer& buff);
+    bool parse(StreamBuffer& buff);   
+    bool my_parse(StreamBuffer& buff);
 
-    std::string path() const;
-    std::string& path();
-    std::string method() const;
-    std::string version() const;
+    const String& path() const;
+    String& path();
+    const String& method() const;
+    const String& version() const;
     std::string GetPost(const std::string& key) const;
     std::string GetPost(const char* key) const;
     bool parseMultipartBoundary();
 
+    std::string_view GetHeader(std::string_view key) const;    // key 为小写
+    bool IsParsingHeader() const;
+    bool IsIdle() const;        // 下一个请求还一个字节都没解析
+
+    static bool useCmaf;    // 转码输出 CMAF(fMP4) 而非 MPEG-TS，同时生成 DASH MPD
+    static bool singleFile; // 每路码率只写一个文件，子列表用 EXT-X-BYTERANGE
+
     bool IsKeepAlive() const;
     bool extractFilenameFromDisposition(const std::string& line);
     void openVideoFile();
-    std::string& re_path();
-    std::string getHlsPathById(std::string& video_id);
+    String& re_path();
+    const String& os_path() const;     // re_path 截下的子路径，如 /720p/index.m3u8
+    // /upload/complete 请求体里的字段；缺少的字段为空 / -1
+    struct UploadCompletion {
+        std::string uploadId, filename;
+        int totalChunks = -1;
+    };
+    static void ParseUploadComplete(StreamBuffer& buff, UploadCompletion* out);
+    // 查库得到视频目录并拼上子路径；会阻塞在 MySQL 上，只在 DB 执行器上调用
+    static std::string getHlsPathById(std::string_view video_id, std::string_view sub_path);
 
 private:
-    bool ParseRequestLine_(const std::string& line);    // 处理请求行
-    void ParseHeader_(const std::string& line);         // 处理请求头
-    void ParseBody_(const std::string& line);           // 处理请求体
+    bool ParseRequestLine_(std::string_view line);      // 处理请求行
+    void ParseHeader_(std::string_view line);           // 处理请求头
+    void ParseBody_(std::string_view line);             // 处理请求体
 
     void ParsePath_();                                  // 处理请求路径
     void ParsePost_();                                  // 处理Post事件
@@ -60,30 +89,39 @@ private:
     static bool UserVerify(const std::string& name, const std::string& pwd, bool isLogin);  // 用户验证
 
     PARSE_STATE state_;
-    std::string method_, path_, version_, body_;
-    std::unordered_map<std::string, std::string> header_;
-    std::unordered_map<std::string, std::string> post_;
+    // 上游是 BlockPool 的块，稳定后整个请求不再 malloc；必须先于下面的成员构造
+    BlockResource blockResource_;
+    std::pmr::monotonic_buffer_resource arena_;
+    String method_, path_, version_, body_;
+    StringMap header_;
+    StringMap post_;
 
-    static const std::unordered_set<std::string> DEFAULT_HTML;
-    static const std::unordered_map<std::string, int> DEFAULT_HTML_TAG;
+    static const std::unordered_set<std::string_view> DEFAULT_HTML;
+    static const std::unordered_map<std::string_view, int> DEFAULT_HTML_TAG;
     static int ConverHex(char ch);  // 16进制转换为10进制
     size_t content_length_ = 0;   // 新增
     // std::string body_="";            // 新增：存储原始 body 字节
-    std::ofstream upload_file_;   //  用于写入上传文件
-    std::string upload_filename_; //  临时文件路径
-    std::string boundary_;        // multipart/form-data 的 boundary
-    std::string boundary_marker_; // 边界标记   
-    std::string boundary_end_;    // 结束边界标记
-    bool in_file_part_ = false;
-    size_t body_received_ = 0;
-    std::ofstream video_file_; 
-    std::string filename_; 
-    bool file_opened_ = false;
-    bool is_file_part_ = false;
-    std::string SafePath(const std::string& s);
-    void convertToHLSAsync(std::string input, std::string outputDir);
+    // 上传（multipart）相关的状态，两个 ofstream 就占 1KB；绝大多数连接只 GET 分片，
+    // 只在带请求体的 POST 开始时分配，Init() 时释放
+    struct UploadState {
+        std::ofstream upload_file;   //  用于写入上传文件
+        std::string upload_filename; //  临时文件路径
+        std::string boundary;        // multipart/form-data 的 boundary
+        std::string boundary_marker; // 边界标记
+        std::string boundary_end;    // 结束边界标记
+        bool in_file_part = false;
+        size_t body_received = 0;
+        std::ofstream video_file;
+        std::string filename;
+        bool file_opened = false;
+        bool is_file_part = false;
+    };
+    std::unique_ptr<UploadState> upload_;
+    static std::string SafePath(const std::string& s);
+    static void convertToHLSAsync(std::string input, std::string outputDir, std::string videoId);
+    static void CompleteUpload(std::string upload_id, std::string filename, int total_chunks, std::string display_name);
     bool download_in_progress_ = false;
-    std::string os_path_="";
+    String os_path_;
     bool comlete_singal=false;
 };
 
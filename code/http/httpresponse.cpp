@@ -2,35 +2,6 @@
 
 using namespace std;
 
-const unordered_map<string, string> HttpResponse::SUFFIX_TYPE = {
-    { ".html",  "text/html" },
-    { ".xml",   "text/xml" },
-    { ".xhtml", "application/xhtml+xml" },
-    { ".txt",   "text/plain" },
-    { ".rtf",   "application/rtf" },
-    { ".pdf",   "application/pdf" },
-    { ".word",  "application/nsword" },
-    { ".png",   "image/png" },
-    { ".gif",   "image/gif" },
-    { ".jpg",   "image/jpeg" },
-    { ".jpeg",  "image/jpeg" },
-    { ".au",    "audio/basic" },
-    { ".mpeg",  "video/mpeg" },
-    { ".mpg",   "video/mpeg" },
-    { ".avi",   "video/x-msvideo" },
-    { ".gz",    "application/x-gzip" },
-    { ".tar",   "application/x-tar" },
-    { ".css",   "text/css "},
-    { ".js",    "text/javascript "},
-};
-
-const unordered_map<int, string> HttpResponse::CODE_STATUS = {
-    { 200, "OK" },
-    { 400, "Bad Request" },
-    { 403, "Forbidden" },
-    { 404, "Not Found" },
-};
-
 const unordered_map<int, string> HttpResponse::CODE_PATH = {
     { 400, "/400.html" },
     { 403, "/403.html" },
@@ -49,9 +20,9 @@ HttpResponse::~HttpResponse() {
     UnmapFile();
 }
 
-void HttpResponse::Init(const string& srcDir, string& path, bool isKeepAlive, int code){
+void HttpResponse::Init(const string& srcDir, string_view path, bool isKeepAlive, int code){
     assert(srcDir != "");
-    if(mmFile_) { UnmapFile(); }
+    UnmapFile();
     code_ = code;
     isKeepAlive_ = isKeepAlive;
     path_ = path;
@@ -76,35 +47,162 @@ void HttpResponse::MakeResponse(Buffer& buff) {
     AddHeader_(buff);
     AddContent_(buff);
 }
-void HttpResponse::MakeResponse_my(Buffer& buff,string data_path) 
+void HttpResponse::MakeResponse_my(Buffer& buff,string data_path, string_view range) 
 {
     if(data_path[0]!='.')
         data_path="."+data_path;
     // cout<<"make data_path:"<<data_path<<endl;
-    LOG_INFO("Issue documents:%s", data_path.c_str());
-    buff.Append("HTTP/1.1 200 OK\r\n");
-    if(data_path.find(".ts") != std::string::npos)
-    {
-        buff.Append("Content-Type: video/MP2T\r\n");
-    }else{
-        buff.Append("Content-Type: application/vnd.apple.mpegurl\r\n");
-    }
-    buff.Append("Cache-Control: no-cache\r\n");
-    buff.Append("Connection: close\r\n");
+    LOG_DEBUG("Issue documents:%s", data_path.c_str());     // 每个请求的明细见访问日志
+    // JIT 虚拟目录：从源 MP4 即时封装（或命中缓存）
+    std::shared_ptr<const std::string> jitBody;
+    bool isJit = JitPackager::Instance()->Serve(data_path, &jitBody);
+    // 媒体分片走长期 fd；单文件存储时旧式分片名映射为码率文件内的区间
+    std::shared_ptr<CachedFile> media;
+    off_t mediaSize = 0;
+    time_t mtime = 0;
+    uint64_t sliceBase = 0;
+    if (!isJit && IsMedia_(data_path)) {
+        media = FdCache::Instance()->Open(data_path, &mediaSize, &mtime);
+        std::string whole;
+        uint64_t off = 0, sliceLen = 0;
+        if (!media && RangeIndex::Instance()->Resolve(data_path, &whole, &off, &sliceLen)) {
+            media = FdCache::Instance()->Open(whole, &mediaSize, &mtime);
+            if (media && off + sliceLen <= (uint64_t)mediaSize) {
+                sliceBase = off;
+                mediaSize = sliceLen;
+            } else {
+                media = nullptr;
+            }
+        }
+    }
     struct stat st{};
-    if (stat(data_path.c_str(), &st) == 0)
-        buff.Append("Content-Length: " + std::to_string(st.st_size) + "\r\n");
-    buff.Append("\r\n");  
-    std::ifstream file(data_path, std::ios::binary | std::ios::ate);
-    if (!file.is_open()) {
+    bool found = isJit || media || stat(data_path.c_str(), &st) == 0;
+    size_t total = isJit ? jitBody->size() : media ? mediaSize : st.st_size;
+
+    // Range: I 帧列表/字节区间播放只取分片中的一段
+    size_t begin = 0, len = total;
+    bool partial = !range.empty() && ParseRange_(range, total, &begin, &len);
+    // 按后缀区分 m3u8 / ts / CMAF 分片 / DASH MPD，未知后缀按播放列表处理
+    int mime = MimeOfPath(data_path, MIME_M3U8);
+    std::string_view date = HttpDate::DateLine();
+    // 所有响应都带 Content-Length（错误为 0），保活连接上才能分清响应边界
+    auto notFound = [&] {
+        code_ = 404;
+        buff.Append(HeaderTemplate::Instance()->Get(404, mime, isKeepAlive_));
+        buff.Append(date.data(), date.size());
+        HeaderTemplate::AppendContentLength(buff, 0);
+    };
+    if(!found) {
+        notFound();
         return;
     }
-    size_t sz = file.tellg();
-    file.seekg(0);
+    if(!range.empty() && !partial && range.compare(0, 6, "bytes=") == 0 && begin >= total) {
+        code_ = 416;
+        buff.Append(HeaderTemplate::Instance()->Get(416, mime, isKeepAlive_));
+        buff.Append(date.data(), date.size());
+        buff.Append("Content-Range: bytes */");
+        HeaderTemplate::AppendNumber(buff, total);
+        buff.Append("\r\n");
+        HeaderTemplate::AppendContentLength(buff, 0);
+        return;
+    }
+
+    // 普通文件先把响应体读出来再写头：打不开（如目录）或读不满都按 404，头里的长度才可信
+    std::string body;
+    if (!isJit && !media) {
+        std::ifstream file(data_path, std::ios::binary);
+        body.resize(len);
+        if (!file.is_open() || !file.seekg(begin) || !file.read(&body[0], len)) {
+            notFound();
+            return;
+        }
+    }
 
-    std::string body(sz, '\0');
-    file.read(&body[0], sz);   
-    buff.Append(body);            
+    code_ = partial ? 206 : 200;
+    buff.Append(HeaderTemplate::Instance()->Get(code_, mime, isKeepAlive_));
+    buff.Append(date.data(), date.size());
+    buff.Append("Cache-Control: no-cache\r\nAccept-Ranges: bytes\r\n");
+    if (media) {
+        std::string_view modified = HttpDate::LastModifiedLine(mtime);
+        buff.Append(modified.data(), modified.size());
+    }
+    if (partial) {
+        buff.Append("Content-Range: bytes ");
+        HeaderTemplate::AppendNumber(buff, begin);
+        buff.Append("-");
+        HeaderTemplate::AppendNumber(buff, begin + len - 1);
+        buff.Append("/");
+        HeaderTemplate::AppendNumber(buff, total);
+        buff.Append("\r\n");
+    }
+    HeaderTemplate::AppendContentLength(buff, len);
+    if (isJit) {
+        buff.Append(jitBody->data() + begin, len);
+        return;
+    }
+    if (media) {
+        file_ = media;
+        fileOffset_ = sliceBase + begin;
+        fileRemain_ = len;
+        return;
+    }
+    buff.Append(body);
+}
+
+ssize_t HttpResponse::SendBody(int sockFd) {
+    if (!file_ || fileRemain_ == 0) return 0;
+    ssize_t len = sendfile(sockFd, file_->fd, &fileOffset_, fileRemain_);
+    if (len > 0) {
+        fileRemain_ -= len;
+        if (fileRemain_ == 0) file_.reset();
+    }
+    return len;
+}
+
+bool HttpResponse::IsMedia_(string_view path) {
+    size_t dot = path.find_last_of('.');
+    if (dot == string_view::npos) return false;
+    string_view suffix = path.substr(dot);
+    return suffix == ".ts" || suffix == ".m4s" || suffix == ".mp4";
+}
+
+// 解析 "bytes=a-b" / "bytes=a-" / "bytes=-n"，只支持单区间；不可满足时 begin 置为 total
+bool HttpResponse::ParseRange_(string_view range, size_t total, size_t* begin, size_t* len) {
+    if(range.compare(0, 6, "bytes=") != 0 || range.find(',') != string_view::npos) return false;
+    size_t dash = range.find('-', 6);
+    if(dash == string_view::npos) return false;
+    string_view first = range.substr(6, dash - 6), last = range.substr(dash + 1);
+    // 两段都必须是纯数字（strtoull 需要 '\0' 结尾，这里直接逐位累加）
+    auto parse = [](string_view digits, unsigned long long* v) {
+        *v = 0;
+        for(char c : digits) {
+            if(c < '0' || c > '9') return false;
+            *v = *v * 10 + (c - '0');
+        }
+        return true;
+    };
+    if(first.empty()) {     // 后缀区间
+        unsigned long long n = 0;
+        if(last.empty() || !parse(last, &n) || n == 0) return false;
+        if(n > total) n = total;
+        *begin = total - n;
+        *len = n;
+        return n > 0;
+    }
+    unsigned long long a = 0;
+    if(!parse(first, &a)) return false;
+    unsigned long long b = total ? total - 1 : 0;
+    if(!last.empty()) {
+        if(!parse(last, &b) || b < a) return false;
+        if(b >= total) b = total - 1;
+    }
+    if(a >= total) {
+        *begin = total;
+        return false;
+    }
+    *begin = a;
+    *len = b - a + 1;
+    return true;
 }
 
 char* HttpResponse::File() {
@@ -122,27 +220,21 @@ void HttpResponse::ErrorHtml_() {
     }
 }
 
+// 状态行与 Content-Type、Connection 一起取预先拼好的模板
 void HttpResponse::AddStateLine_(Buffer& buff) {
-    string status;
-    if(CODE_STATUS.count(code_) == 1) {
-        status = CODE_STATUS.find(code_)->second;
-    }
-    else {
+    if(FindStatus(code_) < 0) {
         code_ = 400;
-        status = CODE_STATUS.find(400)->second;
     }
-    buff.Append("HTTP/1.1 " + to_string(code_) + " " + status + "\r\n");
+    buff.Append(HeaderTemplate::Instance()->Get(code_, MimeOfPath(path_), isKeepAlive_));
 }
 
 void HttpResponse::AddHeader_(Buffer& buff) {
-    buff.Append("Connection: ");
-    if(isKeepAlive_) {
-        buff.Append("keep-alive\r\n");
-        buff.Append("keep-alive: max=6, timeout=120\r\n");
-    } else{
-        buff.Append("close\r\n");
+    std::string_view date = HttpDate::DateLine();
+    buff.Append(date.data(), date.size());
+    if(code_ == 200) {
+        std::string_view modified = HttpDate::LastModifiedLine(mmFileStat_.st_mtime);
+        buff.Append(modified.data(), modified.size());
     }
-    buff.Append("Content-type: " + GetFileType_() + "\r\n");
 }
 
 void HttpResponse::AddContent_(Buffer& buff) {
@@ -154,14 +246,15 @@ void HttpResponse::AddContent_(Buffer& buff) {
 
     //将文件映射到内存提高文件的访问速度  MAP_PRIVATE 建立一个写入时拷贝的私有映射
     LOG_DEBUG("file path %s", (srcDir_ + path_).data());
-    int* mmRet = (int*)mmap(0, mmFileStat_.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
-    if(*mmRet == -1) {
+    void* mmRet = mmap(0, mmFileStat_.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
+    if(mmRet == MAP_FAILED) {
+        close(srcFd);
         ErrorContent(buff, "File NotFound!");
         return; 
     }
     mmFile_ = (char*)mmRet;
     close(srcFd);
-    buff.Append("Content-length: " + to_string(mmFileStat_.st_size) + "\r\n\r\n");
+    HeaderTemplate::AppendContentLength(buff, mmFileStat_.st_size);
 }
 
 void HttpResponse::UnmapFile() {
@@ -169,36 +262,33 @@ void HttpResponse::UnmapFile() {
         munmap(mmFile_, mmFileStat_.st_size);
         mmFile_ = nullptr;
     }
+    file_.reset();
+    fileRemain_ = 0;
 }
 
-// 判断文件类型 
-string HttpResponse::GetFileType_() {
-    string::size_type idx = path_.find_last_of('.');
-    if(idx == string::npos) {   // 最大值 find函数在找不到指定值得情况下会返回string::npos
-        return "text/plain";
-    }
-    string suffix = path_.substr(idx);
-    if(SUFFIX_TYPE.count(suffix) == 1) {
-        return SUFFIX_TYPE.find(suffix)->second;
-    }
-    return "text/plain";
+void HttpResponse::MakeBusy(Buffer& buff) {
+    code_ = 503;
+    file_.reset();
+    fileRemain_ = 0;
+    buff.Append(HeaderTemplate::Instance()->Get(503, MIME_PLAIN, isKeepAlive_));
+    std::string_view date = HttpDate::DateLine();
+    buff.Append(date.data(), date.size());
+    buff.Append("Retry-After: 1\r\n");
+    HeaderTemplate::AppendContentLength(buff, 0);
 }
 
 void HttpResponse::ErrorContent(Buffer& buff, string message) 
 {
     string body;
-    string status;
+    int status = FindStatus(code_);
     body += "<html><title>Error</title>";
     body += "<body bgcolor=\"ffffff\">";
-    if(CODE_STATUS.count(code_) == 1) {
-        status = CODE_STATUS.find(code_)->second;
-    } else {
-        status = "Bad Request";
-    }
-    body += to_string(code_) + " : " + status  + "\n";
+    body += to_string(code_) + " : ";
+    body += status >= 0 ? HTTP_STATUS[status].text : "Bad Request";
+    body += "\n";
     body += "<p>" + message + "</p>";
     body += "<hr><em>TinyWebServer</em></body></html>";
 
-    buff.Append("Content-length: " + to_string(body.size()) + "\r\n\r\n");
+    HeaderTemplate::AppendContentLength(buff, body.size());
     buff.Append(body);
 }
@@ -2,27 +2,38 @@
 #define HTTP_RESPONSE_H
 
 #include <unordered_map>
+#include <string_view>
 #include <fcntl.h>       // open
 #include <unistd.h>      // close
 #include <sys/stat.h>    // stat
 #include <sys/mman.h>    // mmap, munmap
+#include <sys/sendfile.h>
 #include   <fstream>
 #include "../buffer/buffer.h"
 #include "../log/log.h"
+#include "../hls/jitpackager.h"
+#include "../hls/fdcache.h"
+#include "../hls/rangeindex.h"
+#include "responseheader.h"
 
 class HttpResponse {
 public:
     HttpResponse();
     ~HttpResponse();
 
-    void Init(const std::string& srcDir, std::string& path, bool isKeepAlive = false, int code = -1);
+    void Init(const std::string& srcDir, std::string_view path, bool isKeepAlive = false, int code = -1);
     void MakeResponse(Buffer& buff);
     void UnmapFile();
     char* File();
     size_t FileLen() const;
     void ErrorContent(Buffer& buff, std::string message);
     int Code() const { return code_; }
-    void MakeResponse_my(Buffer& buff,std::string data_path);
+    void MakeResponse_my(Buffer& buff,std::string data_path, std::string_view range = std::string_view());
+    void MakeBusy(Buffer& buff);    // 503，查库/读盘的通道排满时直接拒绝
+
+    // 媒体分片的响应体不进缓冲区，由连接在响应头发完后用 sendfile 从缓存的 fd 直接发送
+    size_t BodyRemain() const { return fileRemain_; }
+    ssize_t SendBody(int sockFd);
 
 private:
     void AddStateLine_(Buffer &buff);
@@ -30,7 +41,8 @@ private:
     void AddContent_(Buffer &buff);
 
     void ErrorHtml_();
-    std::string GetFileType_();
+    static bool IsMedia_(std::string_view path);
+    static bool ParseRange_(std::string_view range, size_t total, size_t* begin, size_t* len);
 
     int code_;
     bool isKeepAlive_;
@@ -41,8 +53,10 @@ private:
     char* mmFile_; 
     struct stat mmFileStat_;
 
-    static const std::unordered_map<std::string, std::string> SUFFIX_TYPE;  // 后缀类型集
-    static const std::unordered_map<int, std::string> CODE_STATUS;          // 编码状态集
+    std::shared_ptr<CachedFile> file_;  // sendfile 的源文件
+    off_t fileOffset_ = 0;
+    size_t fileRemain_ = 0;
+
     static const std::unordered_map<int, std::string> CODE_PATH;            // 编码路径集
 };
 
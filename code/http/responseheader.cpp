@@ -0,0 +1,66 @@
+#include "responseheader.h"
+
+#include <string.h>
+#include <charconv>
+
+HeaderTemplate* HeaderTemplate::Instance() {
+    static HeaderTemplate inst;
+    return &inst;
+}
+
+HeaderTemplate::HeaderTemplate() : blocks_(STATUS_COUNT * MIME_COUNT * 2) {
+    for(int s = 0; s < STATUS_COUNT; s++) {
+        for(int m = 0; m < MIME_COUNT; m++) {
+            for(int k = 0; k < 2; k++) {
+                std::string& b = blocks_[(s * MIME_COUNT + m) * 2 + k];
+                b.append("HTTP/1.1 ").append(std::to_string(HTTP_STATUS[s].code))
+                 .append(" ").append(HTTP_STATUS[s].text).append("\r\n");
+                b.append("Content-Type: ").append(MIME_TYPES[m].type).append("\r\n");
+                b.append(k ? "Connection: keep-alive\r\nKeep-Alive: max=6, timeout=120\r\n" : "Connection: close\r\n");
+            }
+        }
+    }
+}
+
+const std::string& HeaderTemplate::Get(int code, int mime, bool keepAlive) const {
+    int s = FindStatus(code);
+    assert(s >= 0 && mime >= 0 && mime < MIME_COUNT);
+    return blocks_[(s * MIME_COUNT + mime) * 2 + keepAlive];
+}
+
+void HeaderTemplate::AppendNumber(Buffer& buff, size_t n) {
+    char num[24];
+    char* end = std::to_chars(num, num + sizeof(num), n).ptr;
+    buff.Append(num, end - num);
+}
+
+void HeaderTemplate::AppendContentLength(Buffer& buff, size_t len) {
+    static const char prefix[] = "Content-Length: ";
+    char line[48];
+    memcpy(line, prefix, sizeof(prefix) - 1);
+    char* end = std::to_chars(line + sizeof(prefix) - 1, line + sizeof(line) - 4, len).ptr;
+    memcpy(end, "\r\n\r\n", 4);
+    buff.Append(line, end + 4 - line);
+}
+
+std::string_view HttpDate::DateLine() {
+    thread_local Cache cache;
+    return Format_(cache, "Date", time(nullptr));
+}
+
+std::string_view HttpDate::LastModifiedLine(time_t mtime) {
+    thread_local Cache cache;
+    return Format_(cache, "Last-Modified", mtime);
+}
+
+std::string_view HttpDate::Format_(Cache& cache, const char* name, time_t t) {
+    if(t != cache.sec) {
+        struct tm tm;
+        gmtime_r(&t, &tm);
+        int n = snprintf(cache.line, sizeof(cache.line), "%s: ", name);
+        n += strftime(cache.line + n, sizeof(cache.line) - n, "%a, %d %b %Y %H:%M:%S GMT\r\n", &tm);
+        cache.len = n;
+        cache.sec = t;
+    }
+    return std::string_view(cache.line, cache.len);
+}
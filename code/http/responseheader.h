@@ -0,0 +1,125 @@
+#ifndef RESPONSE_HEADER_H
+#define RESPONSE_HEADER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <time.h>
+#include "../buffer/buffer.h"
+
+/*
+预先序列化的响应头：状态行 + Content-Type + Connection 在启动时按 (状态码, MIME, 是否长连接) 拼好，
+生成响应时只需拷贝模板和缓存的 Date 行，再把 Content-Length 的数字写到末尾
+*/
+
+struct MimeType {
+    std::string_view suffix;
+    std::string_view type;
+};
+
+// 编译期的后缀 -> MIME 表，最后一项是未知后缀的默认值
+inline constexpr MimeType MIME_TYPES[] = {
+    { ".html",  "text/html" },
+    { ".xml",   "text/xml" },
+    { ".xhtml", "application/xhtml+xml" },
+    { ".txt",   "text/plain" },
+    { ".rtf",   "application/rtf" },
+    { ".pdf",   "application/pdf" },
+    { ".word",  "application/nsword" },
+    { ".png",   "image/png" },
+    { ".gif",   "image/gif" },
+    { ".jpg",   "image/jpeg" },
+    { ".jpeg",  "image/jpeg" },
+    { ".au",    "audio/basic" },
+    { ".mpeg",  "video/mpeg" },
+    { ".mpg",   "video/mpeg" },
+    { ".avi",   "video/x-msvideo" },
+    { ".gz",    "application/x-gzip" },
+    { ".tar",   "application/x-tar" },
+    { ".css",   "text/css" },
+    { ".js",    "text/javascript" },
+    { ".m3u8",  "application/vnd.apple.mpegurl" },
+    { ".ts",    "video/MP2T" },
+    { ".m4s",   "video/iso.segment" },
+    { ".mp4",   "video/mp4" },
+    { ".mpd",   "application/dash+xml" },
+    { "",       "text/plain" },
+};
+inline constexpr int MIME_COUNT = sizeof(MIME_TYPES) / sizeof(MIME_TYPES[0]);
+inline constexpr int MIME_PLAIN = MIME_COUNT - 1;
+
+constexpr int FindMime(std::string_view suffix) {
+    for(int i = 0; i < MIME_PLAIN; i++) {
+        if(MIME_TYPES[i].suffix == suffix) { return i; }
+    }
+    return -1;
+}
+
+// 按路径后缀取 MIME 下标，未知后缀返回 def
+constexpr int MimeOfPath(std::string_view path, int def = MIME_PLAIN) {
+    size_t dot = path.find_last_of('.');
+    int i = dot == std::string_view::npos ? -1 : FindMime(path.substr(dot));
+    return i < 0 ? def : i;
+}
+
+inline constexpr int MIME_M3U8 = FindMime(".m3u8");
+static_assert(MIME_M3U8 >= 0 && MimeOfPath("/a/index007.ts") == FindMime(".ts"), "MIME table");
+
+struct HttpStatus {
+    int code;
+    std::string_view text;
+};
+
+inline constexpr HttpStatus HTTP_STATUS[] = {
+    { 200, "OK" },
+    { 206, "Partial Content" },
+    { 400, "Bad Request" },
+    { 403, "Forbidden" },
+    { 404, "Not Found" },
+    { 416, "Range Not Satisfiable" },
+    { 503, "Service Unavailable" },
+};
+inline constexpr int STATUS_COUNT = sizeof(HTTP_STATUS) / sizeof(HTTP_STATUS[0]);
+
+// 不在表中返回 -1
+constexpr int FindStatus(int code) {
+    for(int i = 0; i < STATUS_COUNT; i++) {
+        if(HTTP_STATUS[i].code == code) { return i; }
+    }
+    return -1;
+}
+
+class HeaderTemplate {
+public:
+    static HeaderTemplate* Instance();
+
+    // 状态行 + Content-Type + Connection(+Keep-Alive)，code 必须在 HTTP_STATUS 中
+    const std::string& Get(int code, int mime, bool keepAlive) const;
+
+    // "Content-Length: n\r\n\r\n"，同时结束头部
+    static void AppendContentLength(Buffer& buff, size_t len);
+    static void AppendNumber(Buffer& buff, size_t n);
+
+private:
+    HeaderTemplate();
+    std::vector<std::string> blocks_;   // [状态][MIME][长连接]
+};
+
+// Date / Last-Modified 行的缓存，每个线程独立，不加锁
+class HttpDate {
+public:
+    // "Date: ...\r\n"，每秒最多格式化一次
+    static std::string_view DateLine();
+    // "Last-Modified: ...\r\n"，与上一次的 mtime 相同时直接复用
+    static std::string_view LastModifiedLine(time_t mtime);
+
+private:
+    struct Cache {
+        time_t sec = -1;
+        size_t len = 0;
+        char line[64];
+    };
+    static std::string_view Format_(Cache& cache, const char* name, time_t t);
+};
+
+#endif //RESPONSE_HEADER_H
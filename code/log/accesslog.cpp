@@ -0,0 +1,120 @@
+#include "accesslog.h"
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include "log.h"
+
+const char* AccessLog::FIELDS =
+    "#time\tclient\tvideo\trendition\tsegment\tstatus\tbytes\tparse_us\tbuild_us\tfirst_byte_us\tdone_us\tresult\n";
+
+AccessLog* AccessLog::Instance() {
+    static AccessLog log;
+    return &log;
+}
+
+AccessLog::~AccessLog() {
+    if(writer_) {
+        queue_->Close();    // 写线程把队列里剩下的写完后退出
+        writer_->join();
+    }
+    if(fd_ >= 0) { close(fd_); }
+}
+
+// 只在服务器启动时调用一次；之后只能改采样率
+void AccessLog::Init(const char* path, int sampleEvery, size_t queueCapacity) {
+    if(!writer_ && sampleEvery > 0) {
+        path_ = path;
+        queue_.reset(new MpscQueue<Record>(queueCapacity));
+        writer_.reset(new std::thread(&AccessLog::Run_, this));
+    }
+    sampleEvery_.store(writer_ ? sampleEvery : 0, std::memory_order_relaxed);
+}
+
+void AccessLog::Submit(Record& rec) {
+    if(!queue_ || !queue_->TryPush(std::move(rec))) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// 阶段耗时按请求开始算，微秒；没走到的阶段写 "-"
+size_t AccessLog::Format(const Record& rec, char* buf, size_t cap) {
+    time_t sec = rec.wallNs / 1000000000;
+    struct tm t;
+    localtime_r(&sec, &t);
+    char ip[INET_ADDRSTRLEN];
+    struct in_addr addr = { rec.ip };
+    inet_ntop(AF_INET, &addr, ip, sizeof(ip));
+
+    // 子路径拆成码率目录和文件名：/720p/seg_003.ts -> 720p, seg_003.ts；/master.m3u8 -> -, master.m3u8
+    std::string_view path(rec.path);
+    if(!path.empty() && path[0] == '/') { path.remove_prefix(1); }
+    size_t slash = path.rfind('/');
+    std::string_view rendition = slash == std::string_view::npos ? std::string_view() : path.substr(0, slash);
+    std::string_view segment = slash == std::string_view::npos ? path : path.substr(slash + 1);
+
+    char stages[4][24];
+    for(int i = STAGE_PARSED; i < STAGES; i++) {
+        if(rec.stage[i] && rec.stage[STAGE_START] && rec.stage[i] >= rec.stage[STAGE_START]) {
+            snprintf(stages[i - 1], sizeof(stages[0]), "%llu",
+                     (unsigned long long)((rec.stage[i] - rec.stage[STAGE_START]) / 1000));
+        } else {
+            strcpy(stages[i - 1], "-");
+        }
+    }
+    int n = snprintf(buf, cap, "%04d-%02d-%02d %02d:%02d:%02d.%06lu\t%s:%u\t%s\t%.*s\t%.*s\t%u\t%llu\t%s\t%s\t%s\t%s\t%s\n",
+                     t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec,
+                     (unsigned long)(rec.wallNs % 1000000000 / 1000), ip, (unsigned)rec.port,
+                     rec.video[0] ? rec.video : "-",
+                     rendition.empty() ? 1 : (int)rendition.size(), rendition.empty() ? "-" : rendition.data(),
+                     segment.empty() ? 1 : (int)segment.size(), segment.empty() ? "-" : segment.data(),
+                     (unsigned)rec.status, (unsigned long long)rec.bytes,
+                     stages[0], stages[1], stages[2], stages[3], rec.aborted ? "aborted" : "ok");
+    if(n < 0) { return 0; }
+    if((size_t)n >= cap) {  // 截断时保留换行
+        n = cap - 1;
+        buf[n - 1] = '\n';
+    }
+    return n;
+}
+
+void AccessLog::Rotate_(time_t now) {
+    struct tm t;
+    localtime_r(&now, &t);
+    if(fd_ >= 0 && t.tm_mday == today_) { return; }
+    char name[256];
+    snprintf(name, sizeof(name), "%s/%04d_%02d_%02d.access", path_, t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
+    if(fd_ >= 0) { close(fd_); }
+    mkdir(path_, 0777);
+    fd_ = open(name, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    today_ = t.tm_mday;
+    struct stat st;
+    if(fd_ >= 0 && fstat(fd_, &st) == 0 && st.st_size == 0) {
+        struct iovec head = { (void*)FIELDS, strlen(FIELDS) };
+        Log::WriteAll(fd_, &head, 1);
+    }
+}
+
+// 取到多少写多少：空闲时一条一写，繁忙时一批最多 BATCH 行，一次 writev
+void AccessLog::Run_() {
+    std::unique_ptr<Record[]> batch(new Record[BATCH]);
+    std::unique_ptr<char[]> lines(new char[BATCH * LINE_LEN]);
+    struct iovec iov[BATCH];
+    uint64_t reported = 0;
+    size_t n;
+    while((n = queue_->PopBulk(batch.get(), BATCH)) > 0) {
+        for(size_t i = 0; i < n; i++) {
+            char* line = lines.get() + i * LINE_LEN;
+            iov[i] = { line, Format(batch[i], line, LINE_LEN) };
+        }
+        Rotate_(time(nullptr));
+        if(fd_ >= 0) { Log::WriteAll(fd_, iov, n); }
+        uint64_t dropped = Dropped();
+        if(dropped != reported) {
+            LOG_WARN_LIMIT(1, "access log queue full, %llu records dropped in total", (unsigned long long)dropped);
+            reported = dropped;
+        }
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef ACCESS_LOG_H
+#define ACCESS_LOG_H
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <atomic>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <string_view>
+#include "mpmcqueue.h"
+
+/*
+访问日志：按采样率每 N 个请求记一条，记录各阶段时间、状态码、字节数、视频 id、码率、分片和客户端。
+请求路径上只填一个定长的 Record 投进无锁队列（满了丢弃并计数），不格式化、不碰文件；
+后台线程批量取出，格式化成一行一条、制表符分隔的文本，一批一次 writev。
+文件按天切换：<path>/YYYY_MM_DD.access，新文件第一行是 "#" 开头的字段说明
+*/
+class AccessLog {
+public:
+    // 各阶段的时间点，都是单调时钟；START 是请求的第一批字节开始解析
+    enum Stage {
+        STAGE_START,
+        STAGE_PARSED,       // 请求头收全
+        STAGE_BUILT,        // 查库、组包完成，响应已生成
+        STAGE_FIRST_BYTE,   // 第一次写出数据
+        STAGE_DONE,         // 响应全部写完
+        STAGES,
+    };
+
+    struct Record {
+        uint64_t wallNs = 0;            // 请求开始的墙上时间
+        uint64_t stage[STAGES] = {};    // 各阶段的单调时钟(ns)，0 表示没走到
+        uint64_t bytes = 0;             // 本请求写出的字节数（响应头 + 响应体）
+        uint32_t ip = 0;                // 网络字节序
+        uint16_t port = 0;
+        uint16_t status = 0;
+        bool aborted = false;           // 没写完连接就关了
+        char video[32] = {};
+        char path[64] = {};             // 视频 id 之后的子路径，如 /720p/seg_003.ts；超长截断
+    };
+
+    static AccessLog* Instance();
+
+    // sampleEvery：每 N 个请求记一条，1 为全部，0 关闭
+    void Init(const char* path, int sampleEvery, size_t queueCapacity = 4096);
+
+    // 当前请求要不要记录；关闭时只读一个原子变量
+    bool Sample() {
+        int every = sampleEvery_.load(std::memory_order_relaxed);
+        if(every <= 0) { return false; }
+        static thread_local uint32_t count = 0;
+        return ++count % every == 0;
+    }
+
+    // 请求路径上调用，不阻塞：队列满时丢掉这一条
+    void Submit(Record& rec);
+    uint64_t Dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    static uint64_t NowNs() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    }
+    static uint64_t WallNs() {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    }
+    static void Copy(char* dst, size_t cap, std::string_view src) {
+        size_t n = std::min(src.size(), cap - 1);
+        memcpy(dst, src.data(), n);
+        dst[n] = '\0';
+    }
+
+    // 一条记录格式化成一行（含换行），返回字节数；后台线程和测试用
+    static size_t Format(const Record& rec, char* buf, size_t cap);
+    static const char* FIELDS;
+
+private:
+    AccessLog() = default;
+    ~AccessLog();
+    void Run_();
+    void Rotate_(time_t now);
+
+    static const int BATCH = 256;       // 一次 writev 最多的行数
+    static const int LINE_LEN = 320;    // 一行最长字节数
+
+    std::atomic<int> sampleEvery_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::unique_ptr<MpscQueue<Record>> queue_;
+    std::unique_ptr<std::thread> writer_;
+    const char* path_ = "./log";
+    int fd_ = -1;
+    int today_ = 0;
+};
+
+#endif //ACCESS_LOG_H
@@ -0,0 +1,215 @@
+#include "binlog.h"
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <algorithm>
+#include <unordered_map>
+
+std::string BinLog::Define(uint32_t site, const char* types, const char* format) {
+    std::string rec(sizeof(Head), '\0');
+    rec.append((const char*)&site, sizeof(site));
+    rec.append(types, strlen(types) + 1);
+    rec.append(format);
+    Head head = { 0, (uint32_t)(rec.size() - sizeof(Head)) };
+    memcpy(&rec[0], &head, sizeof(head));
+    return rec;
+}
+
+namespace {
+
+struct Site {
+    std::string types;
+    std::string format;
+};
+
+// 按类型串从 payload 里依次取参数，取不到（记录被截断）时给 0 / 空串
+class ArgReader {
+public:
+    ArgReader(const std::string& types, const char* p, const char* end) : types_(types), p_(p), end_(end) {}
+
+    char Next(uint64_t* bits, std::string* str) {
+        *bits = 0;
+        str->clear();
+        if(i_ >= types_.size()) { return 0; }
+        char type = types_[i_++];
+        if(type == 's') {
+            uint32_t len = 0;
+            if(p_ + sizeof(len) <= end_) {
+                memcpy(&len, p_, sizeof(len));
+                p_ += sizeof(len);
+                if(len > (size_t)(end_ - p_)) { len = end_ - p_; }
+                str->assign(p_, len);
+                p_ += len;
+            }
+        } else if(p_ + 8 <= end_) {
+            memcpy(bits, p_, 8);
+            p_ += 8;
+        }
+        return type;
+    }
+
+private:
+    const std::string& types_;
+    size_t i_ = 0;
+    const char* p_;
+    const char* end_;
+};
+
+template<typename T>
+void Append(std::string* out, const std::string& spec, T v) {
+    char buf[256];
+    int n = snprintf(buf, sizeof(buf), spec.c_str(), v);
+    if(n <= 0) { return; }
+    if((size_t)n < sizeof(buf)) {
+        out->append(buf, n);
+        return;
+    }
+    size_t old = out->size();
+    out->resize(old + n + 1);
+    snprintf(&(*out)[old], n + 1, spec.c_str(), v);
+    out->resize(old + n);
+}
+
+int64_t AsInt(char type, uint64_t bits) {
+    if(type == 'f') { double d; memcpy(&d, &bits, 8); return (int64_t)d; }
+    return (int64_t)bits;
+}
+
+double AsDouble(char type, uint64_t bits) {
+    double d;
+    if(type == 'f') { memcpy(&d, &bits, 8); return d; }
+    return type == 'i' ? (double)(int64_t)bits : (double)bits;
+}
+
+// 逐个转换说明按长度修饰符把参数转回调用点当时的类型，再交给 snprintf，结果和文本日志一致
+void Format(const Site& site, const char* p, const char* end, std::string* out) {
+    ArgReader args(site.types, p, end);
+    const std::string& f = site.format;
+    uint64_t bits;
+    std::string str;
+    for(size_t i = 0; i < f.size(); ) {
+        if(f[i] != '%') { out->push_back(f[i++]); continue; }
+        if(i + 1 < f.size() && f[i + 1] == '%') { out->push_back('%'); i += 2; continue; }
+        std::string spec = "%";
+        size_t j = i + 1;
+        while(j < f.size() && strchr("-+ #0", f[j])) { spec.push_back(f[j++]); }
+        // 宽度、精度里的 * 各自消耗一个 int 参数，直接替换成数字
+        for(int part = 0; part < 2; part++) {
+            if(part == 1) {
+                if(j >= f.size() || f[j] != '.') { break; }
+                spec.push_back(f[j++]);
+            }
+            if(j < f.size() && f[j] == '*') {
+                char type = args.Next(&bits, &str);
+                spec += std::to_string((int)AsInt(type, bits));
+                j++;
+            }
+            while(j < f.size() && f[j] >= '0' && f[j] <= '9') { spec.push_back(f[j++]); }
+        }
+        std::string length;
+        while(j < f.size() && strchr("hlzjtL", f[j])) { length.push_back(f[j++]); }
+        if(j >= f.size()) { break; }
+        char conv = f[j++];
+        i = j;
+        char type = args.Next(&bits, &str);
+        switch(conv) {
+        case 'd': case 'i': {
+            int64_t v = AsInt(type, bits);
+            std::string s = spec + length + conv;
+            if(length.empty() || length == "h" || length == "hh") { Append(out, s, (int)v); }
+            else if(length == "l") { Append(out, s, (long)v); }
+            else if(length == "z") { Append(out, s, (ssize_t)v); }
+            else if(length == "t") { Append(out, s, (ptrdiff_t)v); }
+            else { Append(out, s, (long long)v); }
+            break;
+        }
+        case 'u': case 'o': case 'x': case 'X': {
+            uint64_t v = (uint64_t)AsInt(type, bits);
+            std::string s = spec + length + conv;
+            if(length.empty() || length == "h" || length == "hh") { Append(out, s, (unsigned)v); }
+            else if(length == "l") { Append(out, s, (unsigned long)v); }
+            else if(length == "z") { Append(out, s, (size_t)v); }
+            else if(length == "t") { Append(out, s, (ptrdiff_t)v); }
+            else { Append(out, s, (unsigned long long)v); }
+            break;
+        }
+        case 'c':
+            Append(out, spec + conv, (int)AsInt(type, bits));
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            Append(out, spec + conv, AsDouble(type, bits));
+            break;
+        case 's':
+            if(type == 's') {
+                Append(out, spec + conv, str.c_str());
+            } else {
+                Append(out, spec + "lld", (long long)AsInt(type, bits));
+            }
+            break;
+        case 'p':
+            Append(out, spec + conv, (void*)(uintptr_t)bits);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+}
+
+long BinLog::Decode(const char* data, size_t len, std::string* out) {
+    if(len < sizeof(MAGIC) || memcmp(data, MAGIC, sizeof(MAGIC)) != 0) { return -1; }
+    std::unordered_map<uint32_t, Site> sites;
+    const char* p = data + sizeof(MAGIC);
+    const char* end = data + len;
+    long count = 0;
+    time_t cachedSec = -1;
+    char prefix[64] = {0};
+    while(p + sizeof(Head) <= end) {
+        Head head;
+        memcpy(&head, p, sizeof(head));
+        p += sizeof(head);
+        if(head.len > (size_t)(end - p)) { break; }     // 最后一条没写完
+        const char* payload = p;
+        p += head.len;
+        if(head.site == 0) {
+            if(head.len < sizeof(uint32_t)) { continue; }
+            uint32_t id;
+            memcpy(&id, payload, sizeof(id));
+            const char* types = payload + sizeof(id);
+            size_t typesLen = strnlen(types, p - types);
+            Site& site = sites[id];
+            site.types.assign(types, typesLen);
+            const char* format = std::min(types + typesLen + 1, p);
+            site.format.assign(format, p - format);
+            continue;
+        }
+        if(head.len < sizeof(uint64_t) + 1) { continue; }
+        uint64_t ns;
+        memcpy(&ns, payload, sizeof(ns));
+        int level = (unsigned char)payload[sizeof(ns)];
+        time_t sec = ns / 1000000000;
+        if(sec != cachedSec) {
+            struct tm t;
+            localtime_r(&sec, &t);
+            snprintf(prefix, sizeof(prefix), "%04d-%02d-%02d %02d:%02d:%02d.",
+                     t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec);
+            cachedSec = sec;
+        }
+        char usec[16];
+        snprintf(usec, sizeof(usec), "%06ld ", (long)(ns % 1000000000 / 1000));
+        out->append(prefix);
+        out->append(usec);
+        out->append(LevelTitle(level));
+        auto it = sites.find(head.site);
+        if(it == sites.end()) {
+            out->append("<unknown format ").append(std::to_string(head.site)).append(">");
+        } else {
+            Format(it->second, payload + sizeof(ns) + 1, p, out);
+        }
+        out->push_back('\n');
+        count++;
+    }
+    return count;
+}
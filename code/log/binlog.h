@@ -0,0 +1,110 @@
+#ifndef BIN_LOG_H
+#define BIN_LOG_H
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <type_traits>
+
+/*
+二进制日志：调用点只记录格式串编号和原始参数，格式化留给离线解码（code/tool/logdecode.cpp）。
+文件以 MAGIC 开头，之后是一条条记录，每条前面是 Head：
+  site == 0 : 格式定义，payload = u32 编号 + 参数类型串（以 0 结尾）+ 格式串
+  site  > 0 : 一条日志，payload = u64 墙上时间(ns) + u8 等级 + 按类型串依次排列的参数
+参数类型：'i' int64，'u' uint64，'f' double，'p' 指针（uint64），'s' u32 长度 + 字节。
+一个文件里的定义总在用到它的日志之前，切换文件时把全部定义重写一遍，每个文件可以单独解码
+*/
+class BinLog {
+public:
+    static constexpr char MAGIC[8] = { 'H', 'L', 'S', 'B', 'L', 'O', 'G', '1' };
+    static const size_t MAX_STR = 1024;     // 单个字符串参数最多记录的字节数
+
+    struct Head {
+        uint32_t site;
+        uint32_t len;   // 之后 payload 的字节数
+    };
+
+    // 参数按调用点的静态类型编码，和 printf 的默认实参提升一致
+    template<typename T>
+    static constexpr char TypeOf() {
+        typedef std::decay_t<T> U;
+        if constexpr(std::is_same_v<U, char*> || std::is_same_v<U, const char*>) { return 's'; }
+        else if constexpr(std::is_pointer_v<U> || std::is_null_pointer_v<U>) { return 'p'; }
+        else if constexpr(std::is_floating_point_v<U>) { return 'f'; }
+        else if constexpr(std::is_enum_v<U> || std::is_signed_v<U>) { return 'i'; }
+        else { return 'u'; }
+    }
+
+    template<typename... Args>
+    static const char* Types() {
+        static constexpr char types[] = { TypeOf<Args>()..., 0 };
+        return types;
+    }
+
+    // 编好一条日志放进 buf，返回字节数；字符串超长或 buf 不够时截断
+    template<typename... Args>
+    static size_t Encode(char* buf, size_t cap, uint32_t site, int level, const struct timespec& now, Args... args) {
+        size_t n = sizeof(Head);
+        uint64_t ns = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+        memcpy(buf + n, &ns, sizeof(ns));
+        n += sizeof(ns);
+        buf[n++] = (char)level;
+        (Put_(buf, cap, &n, args), ...);
+        Head head = { site, (uint32_t)(n - sizeof(Head)) };
+        memcpy(buf, &head, sizeof(head));
+        return n;
+    }
+
+    // 文本日志和解码输出共用的等级标题，都是 9 个字节
+    static const char* LevelTitle(int level) {
+        switch(level) {
+        case 0: return "[debug]: ";
+        case 2: return "[warn] : ";
+        case 3: return "[error]: ";
+        default: return "[info] : ";
+        }
+    }
+
+    // 格式定义记录
+    static std::string Define(uint32_t site, const char* types, const char* format);
+
+    // 把一个文件的内容解码成文本，每行和文本日志的格式相同；返回解码的日志条数，不是二进制日志返回 -1
+    static long Decode(const char* data, size_t len, std::string* out);
+
+private:
+    template<typename T>
+    static void Put_(char* buf, size_t cap, size_t* n, const T& v) {
+        constexpr char type = TypeOf<T>();
+        if constexpr(type == 's') {
+            const char* s = v;
+            if(!s) { s = "(null)"; }
+            size_t len = strnlen(s, MAX_STR);
+            uint32_t room = *n + sizeof(uint32_t) < cap ? cap - *n - sizeof(uint32_t) : 0;
+            uint32_t l = len < room ? len : room;
+            if(*n + sizeof(l) > cap) { return; }
+            memcpy(buf + *n, &l, sizeof(l));
+            memcpy(buf + *n + sizeof(l), s, l);
+            *n += sizeof(l) + l;
+        } else {
+            if(*n + 8 > cap) { return; }
+            if constexpr(type == 'f') {
+                double d = v;
+                memcpy(buf + *n, &d, 8);
+            } else if constexpr(type == 'p') {
+                uint64_t p = (uint64_t)(uintptr_t)v;
+                memcpy(buf + *n, &p, 8);
+            } else if constexpr(type == 'i') {
+                int64_t i = (int64_t)v;
+                memcpy(buf + *n, &i, 8);
+            } else {
+                uint64_t u = (uint64_t)v;
+                memcpy(buf + *n, &u, 8);
+            }
+            *n += 8;
+        }
+    }
+};
+
+#endif //BIN_LOG_H
@@ -1,34 +1,52 @@
 #include "log.h"
 
+using namespace std;
+
 // 构造函数
 Log::Log() {
-    fp_ = nullptr;
-    deque_ = nullptr;
+    fd_ = -1;
     writeThread_ = nullptr;
     lineCount_ = 0;
+    fileLines_ = 0;
     toDay_ = 0;
+    isOpen_ = false;
+    level_ = 1;
+    threshold_ = INT_MAX;
     isAsync_ = false;
+    binary_ = false;
+    sitesWritten_ = 0;
+    stagingSize_ = 0;
+    wake_ = false;
+    stop_ = false;
 }
 
 Log::~Log() {
-    while(!deque_->empty()) {
-        deque_->flush();    // 唤醒消费者，处理掉剩下的任务
+    if(writeThread_) {
+        {
+            lock_guard<mutex> locker(wakeMtx_);
+            stop_ = true;
+        }
+        wakeCv_.notify_one();
+        writeThread_->join();   // 写线程把暂存区里剩下的日志写完后退出
     }
-    deque_->Close();    // 关闭队列
-    writeThread_->join();   // 等待当前线程完成手中的任务
-    if(fp_) {       // 冲洗文件缓冲区，关闭文件描述符
-        lock_guard<mutex> locker(mtx_);
-        flush();        // 清空缓冲区中的数据
-        fclose(fp_);    // 关闭日志文件
+    if(fd_ >= 0) {
+        close(fd_);
     }
 }
 
-// 唤醒阻塞队列消费者，开始写日志
+// 异步方式下叫醒写线程，不等它写完；同步方式每条日志已经直接写进文件
 void Log::flush() {
-    if(isAsync_) {  // 只有异步日志才会用到deque
-        deque_->flush();
+    if(isAsync_) {
+        Wake_();
     }
-    fflush(fp_);    // 清空输入缓冲区
+}
+
+void Log::Wake_() {
+    {
+        lock_guard<mutex> locker(wakeMtx_);
+        wake_ = true;
+    }
+    wakeCv_.notify_one();
 }
 
 // 懒汉模式 局部静态变量法（这种方法不需要加锁和解锁操作）
@@ -42,29 +60,68 @@ void Log::FlushLogThread() {
     Log::Instance()->AsyncWrite_();
 }
 
-// 写线程真正的执行函数
+// 写线程：每 FLUSH_INTERVAL_MS 或有线程的暂存区写满时写一次
 void Log::AsyncWrite_() {
-    string str = "";
-    while(deque_->pop(str)) {
-        lock_guard<mutex> locker(mtx_);
-        fputs(str.c_str(), fp_);
+    while(true) {
+        bool stop;
+        {
+            unique_lock<mutex> locker(wakeMtx_);
+            wakeCv_.wait_for(locker, std::chrono::milliseconds(FLUSH_INTERVAL_MS), [this]() { return wake_ || stop_; });
+            wake_ = false;
+            stop = stop_;
+        }
+        if(!Flush_() && stop) { break; }
+    }
+}
+
+// 交换所有暂存区，换下来的一次 writev 写完；返回是否写了东西。
+// 交换只能有一个线程做，写线程和 init 切换文件前的排空用 flushMtx_ 串行
+bool Log::Flush_() {
+    lock_guard<mutex> flushLocker(flushMtx_);
+    std::vector<Staging*> stagings;
+    {
+        lock_guard<mutex> locker(stagingMtx_);
+        for(auto& s : stagings_) { stagings.push_back(s.get()); }
+    }
+    std::vector<struct iovec> iov;
+    std::vector<std::pair<Staging*, uint32_t>> taken;
+    for(Staging* s : stagings) {
+        uint64_t w = s->state.load(std::memory_order_acquire);
+        if((uint32_t)w == 0) { continue; }
+        uint32_t idx = w >> 32;     // 只有持有 flushMtx_ 的线程改下标
+        w = s->state.exchange((uint64_t)(idx ^ 1) << 32, std::memory_order_acq_rel);
+        size_t used = (uint32_t)w;
+        while(s->committed[idx].load(std::memory_order_acquire) != used) {
+            std::this_thread::yield();  // 还有线程在往这一半拷贝
+        }
+        s->state.notify_all();      // 写满后在等交换的线程
+        iov.push_back({ s->buf[idx], used });
+        taken.emplace_back(s, idx);
+    }
+    if(!iov.empty()) {
+        WriteFile_(iov.data(), iov.size());
+    }
+    // 下一次交换回来之前清零，线程 CAS 拿到新下标时已经能看到
+    for(auto& t : taken) {
+        t.first->committed[t.second].store(0, std::memory_order_relaxed);
     }
+    return !iov.empty();
 }
 
 // 初始化日志实例
-void Log::init(int level, const char* path, const char* suffix, int maxQueCapacity) {
+void Log::init(int level, const char* path, const char* suffix, int maxQueCapacity, bool binary) {
+    if(writeThread_) { Flush_(); }     // 暂存区里按原来的方式记的日志先写进原来的文件
     isOpen_ = true;
     level_ = level;
+    threshold_ = level;
+    binary_ = binary;
     path_ = path;
     suffix_ = suffix;
     if(maxQueCapacity) {    // 异步方式
         isAsync_ = true;
-        if(!deque_) {   // 为空则创建一个
-            unique_ptr<BlockQueue<std::string>> newQue(new BlockQueue<std::string>);
-            // 因为unique_ptr不支持普通的拷贝或赋值操作,所以采用move
-            // 将动态申请的内存权给deque，newDeque被释放
-            deque_ = move(newQue);  // 左值变右值,掏空newDeque
-
+        if(!writeThread_) {
+            // 每个线程暂存区一半的大小，按平均行长从原来的队列容量折算
+            stagingSize_ = std::max((size_t)maxQueCapacity * AVG_LINE, (size_t)MAX_LINE * 4);
             unique_ptr<thread> newThread(new thread(FlushLogThread));
             writeThread_ = move(newThread);
         }
@@ -72,123 +129,207 @@ void Log::init(int level, const char* path, const char* suffix, int maxQueCapaci
         isAsync_ = false;
     }
 
-    lineCount_ = 0;
-    
     time_t timer = time(nullptr);
-    struct tm *sysTime = localtime(&timer);
-    struct tm t = *sysTime;
-    path_ = path;
-    suffix_ = suffix;
+    struct tm t;
+    localtime_r(&timer, &t);
+
+    lock_guard<mutex> locker(mtx_);
+    lineCount_ = 0;
+    Rotate_(t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
+}
+
+// 按天切换时换成当天的文件名，按行数切换时加上 -序号；持有 mtx_
+void Log::Rotate_(int year, int mon, int mday) {
     char fileName[LOG_NAME_LEN] = {0};
-    snprintf(fileName, LOG_NAME_LEN - 1, "%s/%04d_%02d_%02d%s", 
-            path_, t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, suffix_);
-    toDay_ = t.tm_mday;
+    if(toDay_ != mday || lineCount_ == 0) {
+        snprintf(fileName, LOG_NAME_LEN - 1, "%s/%04d_%02d_%02d%s", path_, year, mon, mday, suffix_);
+        toDay_ = mday;
+        lineCount_ = 0;
+    } else {
+        snprintf(fileName, LOG_NAME_LEN - 1, "%s/%04d_%02d_%02d-%d%s", path_, year, mon, mday,
+                 lineCount_ / MAX_LINES, suffix_);
+    }
+    fileLines_ = 0;
+    if(fd_ >= 0) { close(fd_); }
+    fd_ = open(fileName, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if(fd_ < 0) {
+        mkdir(path_, 0777);
+        fd_ = open(fileName, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    }
+    assert(fd_ >= 0);
+    if(binary_) {   // 每个文件都能单独解码：文件头之后把已有的格式定义全部重写一遍
+        struct iovec magic = { (void*)BinLog::MAGIC, sizeof(BinLog::MAGIC) };
+        WriteAll_(&magic, 1);
+        sitesWritten_ = 0;
+        WriteSites_();
+    }
+}
 
-    {
-        lock_guard<mutex> locker(mtx_);
-        buff_.RetrieveAll();
-        if(fp_) {   // 重新打开
-            flush();
-            fclose(fp_);
-        }
-        fp_ = fopen(fileName, "a"); // 打开文件读取并附加写入
-        if(fp_ == nullptr) {
-            mkdir(path_, 0777);
-            fp_ = fopen(fileName, "a"); // 生成目录文件（最大权限）
-        }
-        assert(fp_ != nullptr);
+// 调用点第一次写二进制日志时登记格式串；并发登记同一个调用点时只留一个编号
+uint32_t Log::RegisterSite_(std::atomic<uint32_t>& site, const char* types, const char* format) {
+    lock_guard<mutex> locker(siteMtx_);
+    uint32_t id = site.load(std::memory_order_acquire);
+    if(id == 0) {
+        id = sites_.size() + 1;
+        sites_.push_back(BinLog::Define(id, types, format));
+        site.store(id, std::memory_order_release);
     }
+    return id;
 }
 
-void Log::write(int level, const char *format, ...) {
-    struct timeval now = {0, 0};
-    gettimeofday(&now, nullptr);
-    time_t tSec = now.tv_sec;
-    struct tm *sysTime = localtime(&tSec);
-    struct tm t = *sysTime;
-    va_list vaList;
+// 把当前文件还没有的格式定义写进去；在用到它们的日志之前调用，持有 mtx_
+void Log::WriteSites_() {
+    lock_guard<mutex> locker(siteMtx_);
+    std::vector<struct iovec> iov;
+    for(size_t i = sitesWritten_; i < sites_.size(); i++) {
+        iov.push_back({ (void*)sites_[i].data(), sites_[i].size() });
+    }
+    WriteAll_(iov.data(), iov.size());
+    sitesWritten_ = sites_.size();
+}
 
-    // 日志日期 日志行数  如果不是今天或行数超了
-    if (toDay_ != t.tm_mday || (lineCount_ && (lineCount_  %  MAX_LINES == 0)))
-    {
-        unique_lock<mutex> locker(mtx_);
-        locker.unlock();
-        
-        char newFile[LOG_NAME_LEN];
-        char tail[36] = {0};
-        snprintf(tail, 36, "%04d_%02d_%02d", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
-
-        if (toDay_ != t.tm_mday)    // 时间不匹配，则替换为最新的日志文件名
-        {
-            snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s%s", path_, tail, suffix_);
-            toDay_ = t.tm_mday;
-            lineCount_ = 0;
-        }
-        else {
-            snprintf(newFile, LOG_NAME_LEN - 72, "%s/%s-%d%s", path_, tail, (lineCount_  / MAX_LINES), suffix_);
+size_t Log::CountRecords_(const char* p, size_t len) const {
+    if(!binary_) { return std::count(p, p + len, '\n'); }
+    size_t n = 0;
+    for(size_t off = 0; off + sizeof(BinLog::Head) <= len; n++) {
+        BinLog::Head head;
+        memcpy(&head, p + off, sizeof(head));
+        off += sizeof(head) + head.len;
+    }
+    return n;
+}
+
+// 切换文件只在块与块之间做：一个线程暂存区里的日志不拆开，文件可能比 MAX_LINES 多出一块
+void Log::WriteFile_(const struct iovec* iov, int cnt) {
+    struct timespec now = CoarseClock::Wall();
+    const Second& sec = Second_(now.tv_sec);
+    lock_guard<mutex> locker(mtx_);
+    if(binary_) { WriteSites_(); }
+    int begin = 0;
+    for(int i = 0; i < cnt; i++) {
+        int lines = CountRecords_(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len);
+        if(toDay_ != sec.mday || fileLines_ >= MAX_LINES) {
+            WriteAll_(iov + begin, i - begin);
+            begin = i;
+            Rotate_(sec.year, sec.mon, sec.mday);
         }
-        
-        locker.lock();
-        flush();
-        fclose(fp_);
-        fp_ = fopen(newFile, "a");
-        assert(fp_ != nullptr);
+        lineCount_ += lines;
+        fileLines_ += lines;
     }
+    WriteAll_(iov + begin, cnt - begin);
+}
 
-    // 在buffer内生成一条对应的日志信息
-    {
-        unique_lock<mutex> locker(mtx_);
-        lineCount_++;
-        int n = snprintf(buff_.BeginWrite(), 128, "%d-%02d-%02d %02d:%02d:%02d.%06ld ",
-                    t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
-                    t.tm_hour, t.tm_min, t.tm_sec, now.tv_usec);
-                    
-        buff_.HasWritten(n);
-        AppendLogLevelTitle_(level);    
-
-        va_start(vaList, format);
-        int m = vsnprintf(buff_.BeginWrite(), buff_.WritableBytes(), format, vaList);
-        va_end(vaList);
-
-        buff_.HasWritten(m);
-        buff_.Append("\n\0", 2);
-
-        if(isAsync_ && deque_ && !deque_->full()) { // 异步方式（加入阻塞队列中，等待写线程读取日志信息）
-            deque_->push_back(buff_.RetrieveAllToStr());
-        } else {    // 同步方式（直接向文件中写入日志信息）
-            fputs(buff_.Peek(), fp_);   // 同步就直接写入文件
+void Log::WriteAll(int fd, const struct iovec* iov, int cnt) {
+    struct iovec rest[IOV_MAX];
+    while(cnt > 0) {
+        int n = std::min(cnt, IOV_MAX);
+        memcpy(rest, iov, n * sizeof(struct iovec));
+        iov += n;
+        cnt -= n;
+        int first = 0;
+        while(first < n) {
+            ssize_t len = writev(fd, rest + first, n - first);
+            if(len < 0) {
+                if(errno == EINTR) { continue; }
+                return;     // 写不进去（磁盘满等）只能丢掉
+            }
+            while(first < n && (size_t)len >= rest[first].iov_len) {
+                len -= rest[first].iov_len;
+                first++;
+            }
+            if(first < n) {
+                rest[first].iov_base = static_cast<char*>(rest[first].iov_base) + len;
+                rest[first].iov_len -= len;
+            }
         }
-        buff_.RetrieveAll();    // 清空buff
     }
 }
 
-// 添加日志等级
-void Log::AppendLogLevelTitle_(int level) {
-    switch(level) {
-    case 0:
-        buff_.Append("[debug]: ", 9);
-        break;
-    case 1:
-        buff_.Append("[info] : ", 9);
-        break;
-    case 2:
-        buff_.Append("[warn] : ", 9);
-        break;
-    case 3:
-        buff_.Append("[error]: ", 9);
-        break;
-    default:
-        buff_.Append("[info] : ", 9);
-        break;
+const Log::Second& Log::Second_(time_t sec) {
+    static thread_local Second cache;
+    if(cache.sec != sec) {
+        struct tm t;
+        localtime_r(&sec, &t);
+        cache.sec = sec;
+        cache.year = t.tm_year + 1900;
+        cache.mon = t.tm_mon + 1;
+        cache.mday = t.tm_mday;
+        snprintf(cache.prefix, sizeof(cache.prefix), "%04d-%02d-%02d %02d:%02d:%02d.",
+                 cache.year, cache.mon, cache.mday, t.tm_hour, t.tm_min, t.tm_sec);
     }
+    return cache;
 }
 
-int Log::GetLevel() {
-    lock_guard<mutex> locker(mtx_);
-    return level_;
+void Log::write(int level, const char *format, ...) {
+    struct timespec now = CoarseClock::Wall();     // reactor 线程上是本轮缓存的时间
+    char line[MAX_LINE];
+    memcpy(line, Second_(now.tv_sec).prefix, PREFIX_LEN);
+    size_t n = PREFIX_LEN;
+    long usec = now.tv_nsec / 1000;
+    for(int i = 5; i >= 0; i--) {
+        line[n + i] = '0' + usec % 10;
+        usec /= 10;
+    }
+    n += 6;
+    line[n++] = ' ';
+    memcpy(line + n, BinLog::LevelTitle(level), 9);
+    n += 9;
+
+    va_list vaList;
+    va_start(vaList, format);
+    int m = vsnprintf(line + n, MAX_LINE - n - 1, format, vaList);
+    va_end(vaList);
+    if(m > 0) { n += std::min((size_t)m, MAX_LINE - n - 2); }   // 超长截断
+    line[n++] = '\n';
+
+    if(isAsync_) {
+        Append_(line, n);
+    } else {
+        struct iovec iov = { line, n };
+        WriteFile_(&iov, 1);
+    }
 }
 
-void Log::SetLevel(int level) {
-    lock_guard<mutex> locker(mtx_);
-    level_ = level;
-}
\ No newline at end of file
+Log::Staging* Log::LocalStaging_() {
+    struct Holder {
+        Staging* staging = nullptr;
+        ~Holder() { if(staging) { staging->owned.store(false, std::memory_order_release); } }
+    };
+    static thread_local Holder holder;
+    if(!holder.staging) {
+        lock_guard<mutex> locker(stagingMtx_);
+        for(auto& s : stagings_) {
+            if(!s->owned.load(std::memory_order_acquire)) {
+                s->owned.store(true, std::memory_order_relaxed);
+                holder.staging = s.get();
+                break;
+            }
+        }
+        if(!holder.staging) {
+            stagings_.emplace_back(new Staging(stagingSize_));
+            holder.staging = stagings_.back().get();
+        }
+    }
+    return holder.staging;
+}
+
+// 当前一半写满时叫醒写线程，等它交换后再写（反压，不丢日志，也不打乱本线程的顺序）
+void Log::Append_(const char* line, size_t len) {
+    Staging* s = LocalStaging_();
+    uint64_t w = s->state.load(std::memory_order_acquire);
+    while(true) {
+        uint32_t idx = w >> 32;
+        size_t used = (uint32_t)w;
+        if(used + len > s->cap) {
+            Wake_();
+            s->state.wait(w, std::memory_order_acquire);
+            w = s->state.load(std::memory_order_acquire);
+            continue;
+        }
+        if(s->state.compare_exchange_weak(w, w + len, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            memcpy(s->buf[idx] + used, line, len);
+            s->committed[idx].fetch_add(len, std::memory_order_release);
+            return;
+        }
+    }
+}
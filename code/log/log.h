@@ -4,20 +4,35 @@
 #include <mutex>
 #include <string>
 #include <thread>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <condition_variable>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>          // writev
+#include <fcntl.h>
+#include <limits.h>           // IOV_MAX
+#include <algorithm>
 #include <sys/time.h>
 #include <string.h>
 #include <stdarg.h>           // vastart va_end
 #include <assert.h>
 #include <sys/stat.h>         // mkdir
-#include "blockqueue.h"
-#include "../buffer/buffer.h"
+#include "../timer/coarseclock.h"
+#include "binlog.h"
+
+// 编译期最低等级：等级是常量的 LOG_* 低于它时条件在编译期为假，整条被编译器去掉。例如 -DLOG_MIN_LEVEL=1 去掉全部 LOG_DEBUG
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 0
+#endif
 
 class Log {
 public:
-    // 初始化日志实例（阻塞队列最大容量、日志保存路径、日志文件后缀）
+    // 初始化日志实例（异步暂存区容量、日志保存路径、日志文件后缀、是否写二进制日志）
     void init(int level, const char* path = "./log", 
                 const char* suffix =".log",
-                int maxQueueCapacity = 1024);
+                int maxQueueCapacity = 1024, bool binary = false);
 
     static Log* Instance();
     static void FlushLogThread();   // 异步写日志公有方法，调用私有方法asyncWrite
@@ -25,47 +40,169 @@ public:
     void write(int level, const char *format,...);  // 将输出内容按照标准格式整理
     void flush();
 
-    int GetLevel();
-    void SetLevel(int level);
-    bool IsOpen() { return isOpen_; }
+    // 二进制方式：只记格式串编号和原始参数，不格式化；site 是调用点的静态变量，第一次用时登记格式串
+    template<typename... Args>
+    void WriteBinary(std::atomic<uint32_t>& site, int level, const char* format, Args... args) {
+        uint32_t id = site.load(std::memory_order_acquire);
+        if(id == 0) { id = RegisterSite_(site, BinLog::Types<Args...>(), format); }
+        char rec[MAX_LINE];
+        size_t n = BinLog::Encode(rec, sizeof(rec), id, level, CoarseClock::Wall(), args...);
+        if(isAsync_) {
+            Append_(rec, n);
+        } else {
+            struct iovec iov = { rec, n };
+            WriteFile_(&iov, 1);
+        }
+    }
+    bool IsBinary() const { return binary_; }
+
+    // writev 直到全部写完，处理部分写和 EINTR；写不进去（磁盘满等）时放弃。访问日志也用
+    static void WriteAll(int fd, const struct iovec* iov, int cnt);
+
+    int GetLevel() { return level_.load(std::memory_order_relaxed); }
+    void SetLevel(int level) {
+        level_.store(level, std::memory_order_relaxed);
+        if(IsOpen()) { threshold_.store(level, std::memory_order_relaxed); }
+    }
+    bool IsOpen() { return isOpen_.load(std::memory_order_relaxed); }
+    // 调用点的运行时判断只读一个原子变量：未打开时门槛是 INT_MAX
+    bool Enabled(int level) const { return level >= threshold_.load(std::memory_order_relaxed); }
     
 private:
     Log();
-    void AppendLogLevelTitle_(int level);
     virtual ~Log();
     void AsyncWrite_(); // 异步写日志方法
+    bool Flush_();
+
+    /*
+    每个写日志的线程一块暂存区，分成两半：线程只往当前一半追加，写线程定期把两半交换，
+    再把换下来的一半和其他线程的一起 writev 进文件。追加不加锁：
+    state 高 32 位是当前一半的下标，低 32 位是已预留的长度，线程 CAS 预留后拷贝，拷完加到 committed 上；
+    写线程交换后等 committed 追上预留的长度（最多等一次 memcpy）再写
+    */
+    struct Staging {
+        explicit Staging(size_t cap) : cap(cap), buf{ new char[cap], new char[cap] } {}
+        ~Staging() { delete[] buf[0]; delete[] buf[1]; }
+        const size_t cap;
+        char* buf[2];
+        std::atomic<uint64_t> state{0};
+        std::atomic<size_t> committed[2]{};
+        std::atomic<bool> owned{true};  // 线程退出后置 false，之后新建的线程接着用
+    };
+    Staging* LocalStaging_();
+    void Append_(const char* line, size_t len);
+    void Wake_();
+    // 写入文件，按天、按行数切换文件；同步方式和写线程共用，持有 mtx_
+    void WriteFile_(const struct iovec* iov, int cnt);
+    void WriteAll_(const struct iovec* iov, int cnt) { WriteAll(fd_, iov, cnt); }
+    void Rotate_(int year, int mon, int mday);
+    size_t CountRecords_(const char* p, size_t len) const;
+    uint32_t RegisterSite_(std::atomic<uint32_t>& site, const char* types, const char* format);
+    void WriteSites_();
+
+    // 每个线程缓存当前这一秒的 "YYYY-MM-DD HH:MM:SS." 前缀，跨秒才调 localtime_r
+    struct Second {
+        time_t sec = -1;
+        int year, mon, mday;
+        char prefix[64];
+    };
+    static const Second& Second_(time_t sec);
 
 private:
     static const int LOG_PATH_LEN = 256;    // 日志文件最长文件名
     static const int LOG_NAME_LEN = 256;    // 日志最长名字
     static const int MAX_LINES = 50000;     // 日志文件内的最长日志条数
+    static const int MAX_LINE = 4096;       // 一条日志的最大长度，超出截断
+    static const int PREFIX_LEN = 20;       // "YYYY-MM-DD HH:MM:SS."
+    static const int AVG_LINE = 64;         // 暂存区容量按每行平均字节数折算
+    static const int FLUSH_INTERVAL_MS = 100;
 
     const char* path_;          //路径名
     const char* suffix_;        //后缀名
 
-    int MAX_LINES_;             // 最大日志行数
-
     int lineCount_;             //日志行数记录
+    int fileLines_;             //当前文件里的行数
     int toDay_;                 //按当天日期区分文件
 
-    bool isOpen_;               
+    std::atomic<bool> isOpen_;
  
-    Buffer buff_;       // 输出的内容，缓冲区
-    int level_;         // 日志等级
+    std::atomic<int> level_;    // 日志等级
+    std::atomic<int> threshold_;    // 打开时等于 level_，否则 INT_MAX
     bool isAsync_;      // 是否开启异步日志
+    bool binary_;       // 是否写二进制日志
+
+    std::vector<std::string> sites_;    // 二进制日志各调用点的格式定义记录，下标 + 1 是编号
+    size_t sitesWritten_;               // 当前文件里已经写过的定义数
+    std::mutex siteMtx_;
 
-    FILE* fp_;                                          //打开log的文件指针
-    std::unique_ptr<BlockQueue<std::string>> deque_;    //阻塞队列
+    int fd_;                                            //日志文件
+    std::mutex mtx_;                                    //文件及行数、日期
+
+    size_t stagingSize_;                                //每个线程暂存区一半的字节数
+    std::vector<std::unique_ptr<Staging>> stagings_;    //所有线程的暂存区，只增不减
+    std::mutex stagingMtx_;
     std::unique_ptr<std::thread> writeThread_;          //写线程的指针
-    std::mutex mtx_;                                    //同步日志必需的互斥量
+    std::mutex flushMtx_;                               //交换暂存区
+    std::mutex wakeMtx_;
+    std::condition_variable wakeCv_;
+    bool wake_;
+    bool stop_;
+};
+
+/*
+调用点限流：每秒最多放行 limit 条，多出来的只计数，之后第一条放行时报告这段时间压掉的条数。
+计数是近似的（换秒的瞬间可能多放一两条），目的是让连接进出这类日志的量不随连接数增长
+*/
+class LogLimiter {
+public:
+    bool Allow(int limit, int64_t sec, uint64_t* suppressed) {
+        int64_t window = window_.load(std::memory_order_relaxed);
+        if(window != sec && window_.compare_exchange_strong(window, sec, std::memory_order_relaxed)) {
+            count_.store(0, std::memory_order_relaxed);
+        }
+        if(count_.fetch_add(1, std::memory_order_relaxed) >= limit) {
+            suppressed_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        *suppressed = suppressed_.load(std::memory_order_relaxed) ? suppressed_.exchange(0, std::memory_order_relaxed) : 0;
+        return true;
+    }
+
+private:
+    std::atomic<int64_t> window_{-1};   // 当前计数的秒
+    std::atomic<int> count_{0};
+    std::atomic<uint64_t> suppressed_{0};
 };
 
 #define LOG_BASE(level, format, ...) \
     do {\
-        Log* log = Log::Instance();\
-        if (log->IsOpen() && log->GetLevel() <= level) {\
-            log->write(level, format, ##__VA_ARGS__); \
-            log->flush();\
+        if ((level) >= LOG_MIN_LEVEL) {\
+            Log* log = Log::Instance();\
+            if (log->Enabled(level)) {\
+                if (log->IsBinary()) {\
+                    static std::atomic<uint32_t> logSite(0);\
+                    log->WriteBinary(logSite, level, format, ##__VA_ARGS__);\
+                } else {\
+                    log->write(level, format, ##__VA_ARGS__); \
+                }\
+            }\
+        }\
+    } while(0);
+
+// 限流版本：每个调用点每秒最多 perSec 条
+#define LOG_LIMIT_BASE(level, perSec, format, ...) \
+    do {\
+        if ((level) >= LOG_MIN_LEVEL) {\
+            if (Log::Instance()->Enabled(level)) {\
+                static LogLimiter logLimiter;\
+                uint64_t logSuppressed = 0;\
+                if (logLimiter.Allow(perSec, CoarseClock::Mono().tv_sec, &logSuppressed)) {\
+                    if (logSuppressed) {\
+                        LOG_BASE(level, "(%llu similar lines suppressed at %s:%d)", (unsigned long long)logSuppressed, __FILE__, __LINE__)\
+                    }\
+                    LOG_BASE(level, format, ##__VA_ARGS__)\
+                }\
+            }\
         }\
     } while(0);
 
@@ -77,4 +214,10 @@ private:
 #define LOG_WARN(format, ...) do {LOG_BASE(2, format, ##__VA_ARGS__)} while(0);
 #define LOG_ERROR(format, ...) do {LOG_BASE(3, format, ##__VA_ARGS__)} while(0);
 
+// 每个连接、每个请求都会打的日志用这一组，不让日志量随连接数增长
+#define LOG_DEBUG_LIMIT(perSec, format, ...) do {LOG_LIMIT_BASE(0, perSec, format, ##__VA_ARGS__)} while(0);
+#define LOG_INFO_LIMIT(perSec, format, ...) do {LOG_LIMIT_BASE(1, perSec, format, ##__VA_ARGS__)} while(0);
+#define LOG_WARN_LIMIT(perSec, format, ...) do {LOG_LIMIT_BASE(2, perSec, format, ##__VA_ARGS__)} while(0);
+#define LOG_ERROR_LIMIT(perSec, format, ...) do {LOG_LIMIT_BASE(3, perSec, format, ##__VA_ARGS__)} while(0);
+
 #endif //LOG_H
\ No newline at end of file
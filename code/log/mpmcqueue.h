@@ -0,0 +1,234 @@
+#ifndef MPMC_QUEUE_H
+#define MPMC_QUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <limits.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <assert.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+/*
+futex 上的事件计数，状态字高 32 位是 epoch、低 32 位是等待者数：
+等待方先登记（等待者+1）并记下 epoch，再检查一次条件，仍不满足才睡；
+通知方只有在有人登记时才把 epoch+1、等待者清零并进内核，所以一批入队只会唤醒一次，
+其余的通知只是一次原子读
+*/
+class EventCount {
+public:
+    uint64_t Prepare() {
+        return state_.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    // 撤销登记；若期间已被通知（epoch 变了），登记已被通知方清掉
+    void Cancel(uint64_t key) {
+        uint64_t cur = state_.load(std::memory_order_relaxed);
+        while((cur >> 32) == (key >> 32)) {
+            if(state_.compare_exchange_weak(cur, cur - 1, std::memory_order_seq_cst)) { return; }
+        }
+    }
+
+    // timeoutMs < 0 表示一直等；被唤醒、超时或 epoch 已变化时返回
+    void Wait(uint64_t key, int timeoutMs) {
+        struct timespec ts = { timeoutMs / 1000, (timeoutMs % 1000) * 1000000L };
+        syscall(SYS_futex, EpochWord_(), FUTEX_WAIT_PRIVATE, (uint32_t)(key >> 32),
+                timeoutMs < 0 ? nullptr : &ts, nullptr, 0);
+        Cancel(key);
+    }
+
+    void Notify() {
+        // 与 Prepare 的 fetch_add 配对：要么等待方看到新数据，要么这里看到等待方
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t cur = state_.load(std::memory_order_relaxed);
+        while((uint32_t)cur != 0) {
+            if(state_.compare_exchange_weak(cur, ((cur >> 32) + 1) << 32, std::memory_order_seq_cst)) {
+                syscall(SYS_futex, EpochWord_(), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+                return;
+            }
+        }
+    }
+
+private:
+    static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "epoch word is the high half");
+    uint32_t* EpochWord_() { return reinterpret_cast<uint32_t*>(&state_) + 1; }
+
+    std::atomic<uint64_t> state_{0};
+};
+
+/*
+有界无锁环形队列（Vyukov）：每个槽带一个序号，生产者/消费者各自 CAS 抢下标，
+序号表明槽是空的还是已写好，full()/empty() 不需要锁。
+SingleConsumer 为 true 时消费端只有一个线程（MPSC，如日志写线程），出队不需要 CAS。
+容量向上取整到 2 的幂；T 需要可默认构造，入队出队都是移动赋值。
+*/
+template<typename T, bool SingleConsumer = false>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity = 1024) {
+        size_t cap = 2;
+        while(cap < capacity) { cap <<= 1; }
+        mask_ = cap - 1;
+        cells_.reset(new Cell[cap]);
+        for(size_t i = 0; i < cap; i++) {
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // 满了返回 false，此时 item 不会被移走
+    bool TryPush(T&& item) {
+        if(!Enqueue_(item)) { return false; }
+        notEmpty_.Notify();
+        return true;
+    }
+
+    bool TryPop(T& item) {
+        if(!Dequeue_(item)) { return false; }
+        notFull_.Notify();
+        return true;
+    }
+
+    // 尽量多地入队，遇到满就停，返回入队个数；整批只通知一次
+    template<typename It>
+    size_t TryPushBulk(It first, size_t n) {
+        size_t done = 0;
+        for(; done < n && Enqueue_(*first); ++done, ++first) {}
+        if(done > 0) { notEmpty_.Notify(); }
+        return done;
+    }
+
+    // 最多取 n 个到 out，返回个数
+    size_t TryPopBulk(T* out, size_t n) {
+        size_t done = 0;
+        for(; done < n && Dequeue_(out[done]); ++done) {}
+        if(done > 0) { notFull_.Notify(); }
+        return done;
+    }
+
+    // 满了等待；队列关闭返回 false
+    bool Push(T&& item) {
+        while(!TryPush(std::move(item))) {
+            if(closed_.load(std::memory_order_acquire)) { return false; }
+            uint64_t key = notFull_.Prepare();
+            if(Full() && !closed_.load(std::memory_order_acquire)) {
+                notFull_.Wait(key, -1);
+            } else {
+                notFull_.Cancel(key);
+            }
+        }
+        return true;
+    }
+
+    // 空了等待，timeoutMs < 0 一直等；超时或已关闭且取空时返回 0
+    size_t PopBulk(T* out, size_t n, int timeoutMs = -1) {
+        while(true) {
+            size_t got = TryPopBulk(out, n);
+            if(got > 0) { return got; }
+            if(closed_.load(std::memory_order_acquire)) { return 0; }
+            uint64_t key = notEmpty_.Prepare();
+            if(Empty() && !closed_.load(std::memory_order_acquire)) {
+                notEmpty_.Wait(key, timeoutMs);
+                if(timeoutMs >= 0) { return TryPopBulk(out, n); }
+            } else {
+                notEmpty_.Cancel(key);
+            }
+        }
+    }
+
+    bool Pop(T& item, int timeoutMs = -1) {
+        return PopBulk(&item, 1, timeoutMs) == 1;
+    }
+
+    // 唤醒所有等待者；之后 Push 失败，Pop 取完剩余的元素后返回 false
+    void Close() {
+        closed_.store(true, std::memory_order_release);
+        notEmpty_.Notify();
+        notFull_.Notify();
+    }
+
+    // 唤醒消费者（例如让它尽快把已入队的日志写出去）
+    void Wake() { notEmpty_.Notify(); }
+
+    size_t Size() const {
+        size_t tail = tail_.load(std::memory_order_acquire);
+        size_t head = head_.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+    bool Empty() const { return Size() == 0; }
+    bool Full() const { return Size() > mask_; }
+    size_t Capacity() const { return mask_ + 1; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;    // == 下标：空槽可写；== 下标+1：已写好可读
+        T data;
+    };
+
+    bool Enqueue_(T& item) {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while(true) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if(diff == 0) {
+                if(tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+            } else if(diff < 0) {
+                return false;   // 槽还没被消费，队列满
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::move(item);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Dequeue_(T& item) {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while(true) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if(diff == 0) {
+                if constexpr (SingleConsumer) {
+                    head_.store(pos + 1, std::memory_order_relaxed);
+                    break;
+                } else {
+                    if(head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) { break; }
+                }
+            } else if(diff < 0) {
+                return false;   // 槽还没写好，队列空
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+        item = std::move(cell->data);
+        cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 生产者和消费者的下标分开放在不同的缓存行
+    alignas(64) std::atomic<size_t> tail_{0};
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    std::atomic<bool> closed_{false};
+    EventCount notEmpty_;
+    EventCount notFull_;
+};
+
+template<typename T>
+using MpmcQueue = BoundedQueue<T, false>;
+
+template<typename T>
+using MpscQueue = BoundedQueue<T, true>;
+
+#endif //MPMC_QUEUE_H
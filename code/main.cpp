@@ -4,9 +4,14 @@
 int main() {
     // 守护进程 后台运行 
     WebServer server(
-        1316, 2, 60000,              // 端口 ET模式 timeoutMs 
+        1316, 2, 60000,              // 端口 ET模式 保活空闲超时timeoutMs 
         3306, "zhaobowen", "huaji513612", "hls_sever", /* Mysql配置 */
-        12, 8, true, 1, 1024);             /* 连接池数量 线程池数量 日志开关 日志等级 日志异步队列容量 */
+        12, 8, true, 1, 1024,             /* 连接池数量 线程池数量 日志开关 日志等级 日志异步队列容量 */
+        true, 256, false, false,          /* 即时打包开关 JIT分片缓存(MB) CMAF输出开关 单文件存储开关 */
+        64, 4, 2,                         /* 缓冲区内存池空闲上限(MB) 磁盘执行器线程数 转码执行器线程数 */
+        false, false,                     /* 绑核开关 协程模式开关 */
+        10000, 30000, 10000, 4096,        /* 请求头超时 上传无进展超时 写进度检查窗口(ms) 最低发送速率(B/s) */
+        false, 100);                      /* 二进制日志开关 访问日志采样(每N个请求记一条，0关闭) */
 
     server.Start();
 } 
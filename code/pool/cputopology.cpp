@@ -0,0 +1,103 @@
+#include "cputopology.h"
+
+#include <sched.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <fstream>
+
+CpuTopology* CpuTopology::Instance() {
+    static CpuTopology inst;
+    return &inst;
+}
+
+void CpuTopology::Detect() {
+    cpus_.clear();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for(int c = 0; c < CPU_SETSIZE; c++) {
+            if(CPU_ISSET(c, &set)) { cpus_.push_back(c); }
+        }
+    }
+    if(cpus_.empty()) { cpus_.push_back(0); }
+    nodeOfCpu_.assign(cpus_.back() + 1, 0);
+
+    // 节点编号可能不连续（如只有 node0、node2），没有的节点文件直接跳过
+    nodeCount_ = 1;
+    for(int node = 0; node < 1024; node++) {
+        std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if(!in) { continue; }
+        std::string list;
+        std::getline(in, list);
+        for(int c : ParseCpuList_(list)) {
+            if(c < (int)nodeOfCpu_.size()) { nodeOfCpu_[c] = node; }
+        }
+        nodeCount_ = std::max(nodeCount_, node + 1);
+    }
+    std::stable_sort(cpus_.begin(), cpus_.end(), [this](int a, int b) {
+        return nodeOfCpu_[a] < nodeOfCpu_[b];
+    });
+}
+
+int CpuTopology::NodeOf(int cpu) const {
+    return cpu >= 0 && cpu < (int)nodeOfCpu_.size() ? nodeOfCpu_[cpu] : 0;
+}
+
+std::string CpuTopology::Describe() const {
+    std::string s = std::to_string(nodeCount_) + " node(s), " + std::to_string(cpus_.size()) + " cpu(s):";
+    for(int node = 0; node < nodeCount_; node++) {
+        std::vector<int> cpus;
+        for(int c : cpus_) {
+            if(NodeOf(c) == node) { cpus.push_back(c); }
+        }
+        if(!cpus.empty()) {
+            s += " node" + std::to_string(node) + "[" + FormatCpuList(cpus) + "]";
+        }
+    }
+    return s;
+}
+
+bool CpuTopology::Pin(pthread_t thread, int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+}
+
+int CpuTopology::CurrentCpu() {
+    return sched_getcpu();
+}
+
+std::string CpuTopology::FormatCpuList(std::vector<int> cpus) {
+    std::sort(cpus.begin(), cpus.end());
+    std::string s;
+    for(size_t i = 0; i < cpus.size(); ) {
+        size_t j = i;
+        while(j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) { j++; }
+        if(!s.empty()) { s += ","; }
+        s += std::to_string(cpus[i]);
+        if(j > i) { s += "-" + std::to_string(cpus[j]); }
+        i = j + 1;
+    }
+    return s;
+}
+
+// "0-3,8-11" -> {0,1,2,3,8,9,10,11}
+std::vector<int> CpuTopology::ParseCpuList_(const std::string& list) {
+    std::vector<int> cpus;
+    const char* p = list.c_str();
+    while(*p) {
+        char* end;
+        long lo = strtol(p, &end, 10);
+        if(end == p) { break; }
+        long hi = lo;
+        p = end;
+        if(*p == '-') {
+            hi = strtol(p + 1, &end, 10);
+            p = end;
+        }
+        for(long c = lo; c <= hi; c++) { cpus.push_back((int)c); }
+        if(*p == ',') { p++; }
+    }
+    return cpus;
+}
@@ -0,0 +1,40 @@
+#ifndef CPU_TOPOLOGY_H
+#define CPU_TOPOLOGY_H
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+/*
+本进程可用的 CPU 及其所属的 NUMA 节点，启动时从 sched_getaffinity 和
+/sys/devices/system/node/node*\/cpulist 读取一次；没有 NUMA 信息时全部算作节点 0
+*/
+class CpuTopology {
+public:
+    static CpuTopology* Instance();
+
+    void Detect();
+
+    const std::vector<int>& Cpus() const { return cpus_; }     // 按节点、编号排序
+    int NodeCount() const { return nodeCount_; }
+    int NodeOf(int cpu) const;
+    const std::vector<int>& NodeOfCpu() const { return nodeOfCpu_; }    // 下标为 CPU 编号
+
+    // "2 node(s), 16 cpu(s): node0[0-7] node1[8-15]"
+    std::string Describe() const;
+
+    static bool Pin(pthread_t thread, int cpu);
+    static int CurrentCpu();
+
+    static std::string FormatCpuList(std::vector<int> cpus);   // {0,1,2,5} -> "0-2,5"
+
+private:
+    CpuTopology() = default;
+    static std::vector<int> ParseCpuList_(const std::string& list);
+
+    std::vector<int> cpus_;
+    std::vector<int> nodeOfCpu_;
+    int nodeCount_ = 1;
+};
+
+#endif //CPU_TOPOLOGY_H
@@ -0,0 +1,42 @@
+#include "executors.h"
+#include <thread>
+
+Executors* Executors::Instance() {
+    static Executors inst;
+    return &inst;
+}
+
+void Executors::Init(ThreadPool* net, int dbThreads, int diskThreads, int pipelineThreads, size_t maxQueued) {
+    assert(net && maxQueued > 0);
+    lanes_[NET].pool.store(net);
+    const int threads[KIND_COUNT] = { 0, dbThreads, diskThreads, pipelineThreads };
+    for(int k = DB; k < KIND_COUNT; k++) {
+        if(threads[k] > 0) {
+            lanes_[k].owned.reset(new ThreadPool(threads[k]));
+            lanes_[k].pool.store(lanes_[k].owned.get());
+        }
+        lanes_[k].limit = maxQueued;
+    }
+}
+
+void Executors::Close() {
+    // 任务链会在通道之间来回续（查库 -> 磁盘，磁盘 -> 查库 -> 转码），
+    // 先把所有通道切到直接执行，再逐个等线程池做完剩下的任务
+    for(Lane& lane : lanes_) {
+        lane.pool.store(nullptr);
+    }
+    // 置空之前已经读到 pool 的提交者可能还没调完 AddTask，等它们出来再析构，否则会用到已释放的线程池
+    for(Lane& lane : lanes_) {
+        while(lane.dispatching.load() != 0) {
+            std::this_thread::yield();
+        }
+    }
+    for(Lane& lane : lanes_) {
+        lane.owned.reset();
+    }
+}
+
+const char* Executors::Name(Kind kind) {
+    static const char* names[KIND_COUNT] = { "net", "db", "disk", "pipeline" };
+    return names[kind];
+}
@@ -0,0 +1,115 @@
+#ifndef EXECUTORS_H
+#define EXECUTORS_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include "threadpool.h"
+
+/*
+按工作类型分开的执行器：
+  NET      : 网络线程池（WebServer 的 threadpool_），只做解析、组包、收发这类纯 CPU 工作
+  DB       : MySQL 查询，线程数与连接池相同，多出来的线程只会在连接池的信号量上干等
+  DISK     : 文件读写（分片合并、打开媒体文件、生成列表）
+  PIPELINE : ffmpeg 转码等分钟级任务
+每条通道有排队上限，满了 Post 返回 false，由调用方给出降级处理（如 503），而不是无限堆积。
+Submit 把 work 的结果交给 then，then 在指定的通道上执行，典型用法是查库后回到网络/磁盘线程组包。
+*/
+class Executors {
+public:
+    enum Kind { NET, DB, DISK, PIPELINE, KIND_COUNT };
+
+    static Executors* Instance();
+
+    // net 由调用方持有；其余通道线程数为 0 时该通道退化为在提交线程上直接执行
+    void Init(ThreadPool* net, int dbThreads, int diskThreads, int pipelineThreads, size_t maxQueued);
+    // 做完已排队的任务并 join 阻塞通道的线程，须在 net 池析构之前调用；
+    // 之后其他线程仍可提交，任务改为在提交线程上直接执行
+    void Close();
+
+    // 有界投递，通道已满返回 false
+    template<typename F>
+    bool Post(Kind kind, F&& f) {
+        Lane& lane = lanes_[kind];
+        if(lane.inflight.fetch_add(1) >= lane.limit) {
+            lane.inflight.fetch_sub(1);
+            lane.rejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        Dispatch_(lane, [&lane, f = std::forward<F>(f)]() mutable {
+            f();
+            lane.inflight.fetch_sub(1);
+        });
+        return true;
+    }
+
+    // work 在 kind 上执行，结果交给 then 在 thenKind 上执行；续体不受排队上限限制，已经接受的请求一定能走完
+    template<typename Work, typename Then>
+    bool Submit(Kind kind, Work&& work, Kind thenKind, Then&& then) {
+        return Post(kind, [this, thenKind, work = std::forward<Work>(work), then = std::forward<Then>(then)]() mutable {
+            typedef decltype(work()) Result;
+            if constexpr (std::is_void<Result>::value) {
+                work();
+                Dispatch_(lanes_[thenKind], std::move(then));
+            } else {
+                Dispatch_(lanes_[thenKind], [then = std::move(then), result = work()]() mutable {
+                    then(std::move(result));
+                });
+            }
+        });
+    }
+
+    // 类型化的入口，调用处看得出任务会阻塞在什么上
+    template<typename Work, typename Then>
+    bool Db(Work&& work, Then&& then, Kind thenKind = NET) {
+        return Submit(DB, std::forward<Work>(work), thenKind, std::forward<Then>(then));
+    }
+
+    template<typename Work, typename Then>
+    bool Disk(Work&& work, Then&& then, Kind thenKind = NET) {
+        return Submit(DISK, std::forward<Work>(work), thenKind, std::forward<Then>(then));
+    }
+
+    template<typename F>
+    bool Pipeline(F&& f) {
+        return Post(PIPELINE, std::forward<F>(f));
+    }
+
+    size_t Inflight(Kind kind) const { return lanes_[kind].inflight.load(std::memory_order_relaxed); }
+    size_t Rejected(Kind kind) const { return lanes_[kind].rejected.load(std::memory_order_relaxed); }
+    static const char* Name(Kind kind);
+
+private:
+    Executors() = default;
+    ~Executors() { Close(); }
+
+    struct Lane {
+        std::atomic<ThreadPool*> pool{nullptr};     // 为空时在提交线程上直接执行
+        std::unique_ptr<ThreadPool> owned;
+        std::atomic<size_t> inflight{0};    // 已接受、还没执行完的任务数
+        std::atomic<size_t> rejected{0};
+        std::atomic<size_t> dispatching{0}; // 正在 Dispatch_ 里、可能已经拿到 pool 的调用数，Close 等它归零再析构线程池
+        size_t limit = SIZE_MAX;
+    };
+
+    // dispatching 与 pool 都用 seq_cst：Close 置空 pool 后看到 dispatching 为 0，
+    // 之后进来的调用一定读到空指针，不会再碰正在析构的线程池
+    template<typename F>
+    static void Dispatch_(Lane& lane, F&& f) {
+        lane.dispatching.fetch_add(1);
+        ThreadPool* pool = lane.pool.load();
+        if(pool) {
+            pool->AddTask(std::forward<F>(f));
+            lane.dispatching.fetch_sub(1);
+        } else {
+            lane.dispatching.fetch_sub(1);
+            f();
+        }
+    }
+
+    Lane lanes_[KIND_COUNT];
+};
+
+#endif //EXECUTORS_H
@@ -0,0 +1,64 @@
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <stddef.h>
+#include <new>
+
+/*
+协程帧的内存池：按 64 字节分档，每个线程一组空闲链表。
+连接协程在 reactor 线程上创建、恢复和结束，帧总是在同一个线程上申请和释放，
+不需要任何同步；连接关闭后帧留在链表里给下一个连接用，稳定状态下不再 malloc。
+超过 MAX_SIZE 的帧直接走全局 operator new。
+*/
+class FramePool {
+public:
+    static void* Allocate(size_t size) {
+        size_t cls = Class_(size);
+        if(cls >= CLASSES) { return ::operator new(size); }
+        List& list = lists_[cls];
+        if(list.head) {
+            Node* node = list.head;
+            list.head = node->next;
+            list.count--;
+            return node;
+        }
+        return ::operator new((cls + 1) * ALIGN);
+    }
+
+    static void Deallocate(void* p, size_t size) {
+        size_t cls = Class_(size);
+        if(cls >= CLASSES || lists_[cls].count >= MAX_CACHED) {
+            ::operator delete(p);
+            return;
+        }
+        List& list = lists_[cls];
+        Node* node = static_cast<Node*>(p);
+        node->next = list.head;
+        list.head = node;
+        list.count++;
+    }
+
+    // 当前线程各档缓存的帧数之和
+    static size_t Cached() {
+        size_t n = 0;
+        for(const List& list : lists_) { n += list.count; }
+        return n;
+    }
+
+private:
+    static const size_t ALIGN = 64;
+    static const size_t CLASSES = 64;           // 最大 4KB
+    static const size_t MAX_CACHED = 16384;     // 每档最多缓存的帧数，防止连接高峰过后一直占着内存
+
+    struct Node { Node* next; };
+    struct List {       // 线程局部变量零初始化
+        Node* head;
+        size_t count;
+    };
+
+    static size_t Class_(size_t size) { return (size + ALIGN - 1) / ALIGN - 1; }
+
+    static inline thread_local List lists_[CLASSES];
+};
+
+#endif //FRAME_POOL_H
@@ -0,0 +1,102 @@
+#ifndef INLINE_TASK_H
+#define INLINE_TASK_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/*
+只能移动的 void() 任务，小对象直接放在内部存储里
+bind(&WebServer::OnRead_, this, client) 这类任务只有 32 字节，入队出队都不需要堆分配；
+放不下（或移动可能抛异常）的可调用对象才退回到 new
+*/
+class InlineTask {
+public:
+    static const size_t INLINE_SIZE = 48;
+
+    InlineTask() = default;
+
+    template<typename F, typename Fn = typename std::decay<F>::type,
+             typename = typename std::enable_if<!std::is_same<Fn, InlineTask>::value>::type>
+    InlineTask(F&& f) {
+        if constexpr (IsInline_<Fn>()) {
+            new (storage_) Fn(std::forward<F>(f));
+            ops_ = &Inline_<Fn>::ops;
+        } else {
+            *reinterpret_cast<Fn**>(storage_) = new Fn(std::forward<F>(f));
+            ops_ = &Heap_<Fn>::ops;
+        }
+    }
+
+    InlineTask(InlineTask&& other) noexcept { MoveFrom_(other); }
+
+    InlineTask& operator=(InlineTask&& other) noexcept {
+        if(this != &other) {
+            Reset();
+            MoveFrom_(other);
+        }
+        return *this;
+    }
+
+    InlineTask(const InlineTask&) = delete;
+    InlineTask& operator=(const InlineTask&) = delete;
+
+    ~InlineTask() { Reset(); }
+
+    void operator()() { ops_->invoke(storage_); }
+    explicit operator bool() const { return ops_ != nullptr; }
+
+    void Reset() {
+        if(ops_) {
+            ops_->destroy(storage_);
+            ops_ = nullptr;
+        }
+    }
+
+private:
+    struct Ops {
+        void (*invoke)(void*);
+        void (*move)(void* from, void* to);     // 移动到 to 并析构 from
+        void (*destroy)(void*);
+    };
+
+    template<typename Fn>
+    static constexpr bool IsInline_() {
+        return sizeof(Fn) <= INLINE_SIZE && alignof(Fn) <= alignof(std::max_align_t)
+            && std::is_nothrow_move_constructible<Fn>::value;
+    }
+
+    template<typename Fn>
+    struct Inline_ {
+        static void Invoke(void* p) { (*static_cast<Fn*>(p))(); }
+        static void Move(void* from, void* to) {
+            new (to) Fn(std::move(*static_cast<Fn*>(from)));
+            static_cast<Fn*>(from)->~Fn();
+        }
+        static void Destroy(void* p) { static_cast<Fn*>(p)->~Fn(); }
+        static constexpr Ops ops = { Invoke, Move, Destroy };
+    };
+
+    template<typename Fn>
+    struct Heap_ {
+        static Fn*& Ptr(void* p) { return *static_cast<Fn**>(p); }
+        static void Invoke(void* p) { (*Ptr(p))(); }
+        static void Move(void* from, void* to) { *static_cast<Fn**>(to) = Ptr(from); }
+        static void Destroy(void* p) { delete Ptr(p); }
+        static constexpr Ops ops = { Invoke, Move, Destroy };
+    };
+
+    void MoveFrom_(InlineTask& other) {
+        if(other.ops_) {
+            other.ops_->move(other.storage_, storage_);
+            ops_ = other.ops_;
+            other.ops_ = nullptr;
+        }
+    }
+
+    alignas(std::max_align_t) unsigned char storage_[INLINE_SIZE];
+    const Ops* ops_ = nullptr;
+};
+
+#endif //INLINE_TASK_H
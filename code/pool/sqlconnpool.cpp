@@ -1,5 +1,7 @@
 #include "sqlconnpool.h"
 
+using namespace std;
+
 SqlConnPool* SqlConnPool::Instance() {
     static SqlConnPool pool;
     return &pool;
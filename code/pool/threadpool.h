@@ -1,66 +1,250 @@
 #ifndef THREADPOOL_H
 #define THREADPOOL_H
 
-#include <queue>
 #include <mutex>
 #include <condition_variable>
+#include <deque>
 #include <functional>
+#include <atomic>
+#include <memory>
 #include <thread>
+#include <vector>
+#include <algorithm>
+#include <iterator>
 #include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include "inlinetask.h"
 
-
+/*
+工作窃取线程池
+每个工作线程有自己的任务队列：工作线程里提交的任务进自己的队列，外部线程（reactor）轮流投递到各队列；
+自己的队列空了就从别的队列尾部偷一半。队列各自加锁，提交与取任务基本不会争同一把锁。
+唤醒按需进行：只有存在睡眠线程且没有线程正在找任务时才唤醒一个，被唤醒的线程找到任务后若还有积压再接力唤醒下一个；
+AddTasks 一次投递一批，只唤醒需要的线程数。析构时等队列里剩下的任务执行完，再 join 所有线程。
+*/
 class ThreadPool {
 public:
-    ThreadPool() = default;
-    ThreadPool(ThreadPool&&) = default;
-    // 尽量用make_shared代替new，如果通过new再传递给shared_ptr，内存是不连续的，会造成内存碎片化
-    explicit ThreadPool(int threadCount = 8) : pool_(std::make_shared<Pool>()) { // make_shared:传递右值，功能是在动态内存中分配一个对象并初始化它，返回指向此对象的shared_ptr
+    explicit ThreadPool(int threadCount = 8) : workers_(threadCount) {
         assert(threadCount > 0);
         for(int i = 0; i < threadCount; i++) {
-            std::thread([this]() {
-                std::unique_lock<std::mutex> locker(pool_->mtx_);
-                while(true) {
-                    if(!pool_->tasks.empty()) {
-                        auto task = std::move(pool_->tasks.front());    // 左值变右值,资产转移
-                        pool_->tasks.pop();
-                        locker.unlock();    // 因为已经把任务取出来了，所以可以提前解锁了
-                        task();
-                        locker.lock();      // 马上又要取任务了，上锁
-                    } else if(pool_->isClosed) {
-                        break;
-                    } else {
-                        pool_->cond_.wait(locker);    // 等待,如果任务来了就notify的
-                    }
-                    
-                }
-            }).detach();
+            workers_[i].reset(new Worker);
+        }
+        threads_.reserve(threadCount);
+        for(int i = 0; i < threadCount; i++) {
+            threads_.emplace_back([this, i]() { Run_(i); });
         }
     }
 
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
     ~ThreadPool() {
-        if(pool_) {
-            std::unique_lock<std::mutex> locker(pool_->mtx_);
-            pool_->isClosed = true;
+        {
+            std::lock_guard<std::mutex> locker(sleepMtx_);
+            isClosed_ = true;
+        }
+        sleepCond_.notify_all();  // 唤醒所有的线程，把剩下的任务做完后退出
+        for(auto& t : threads_) {
+            t.join();
         }
-        pool_->cond_.notify_all();  // 唤醒所有的线程
     }
 
     template<typename T>
     void AddTask(T&& task) {
-        std::unique_lock<std::mutex> locker(pool_->mtx_);
-        pool_->tasks.emplace(std::forward<T>(task));
-        pool_->cond_.notify_one();
+        pending_.fetch_add(1);      // 先计数再入队，计数只会多于队列里的任务
+        Push_(InlineTask(std::forward<T>(task)));
+        if(sleepers_.load() > 0 && searching_.load() == 0) {
+            Wake_(1);
+        }
+    }
+
+    // 投递到指定工作线程的队列（如绑在连接收包 CPU 上的线程），其他空闲线程仍可偷走
+    template<typename T>
+    void AddTaskTo(size_t worker, T&& task) {
+        pending_.fetch_add(1);
+        PushTo_(worker % workers_.size(), InlineTask(std::forward<T>(task)));
+        if(sleepers_.load() > 0 && searching_.load() == 0) {
+            Wake_(1);
+        }
+    }
+
+    // 一批任务只唤醒一次
+    template<typename It>
+    void AddTasks(It first, It last) {
+        size_t n = std::distance(first, last);
+        pending_.fetch_add(n);
+        for(; first != last; ++first) {
+            Push_(InlineTask(std::move(*first)));
+        }
+        if(n > 0 && sleepers_.load() > 0) {
+            Wake_(n);
+        }
+    }
+
+    size_t ThreadCount() const { return threads_.size(); }
+
+    // 第 i 个工作线程绑到 cpus[i % cpus.size()]，返回绑定成功的线程数
+    int Pin(const std::vector<int>& cpus) {
+        int pinned = 0;
+        for(size_t i = 0; i < threads_.size() && !cpus.empty(); i++) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpus[i % cpus.size()], &set);
+            pinned += pthread_setaffinity_np(threads_[i].native_handle(), sizeof(set), &set) == 0;
+        }
+        return pinned;
     }
 
 private:
-    // 用一个结构体封装起来，方便调用
-    struct Pool {
-        std::mutex mtx_;
-        std::condition_variable cond_;
-        bool isClosed;
-        std::queue<std::function<void()>> tasks; // 任务队列，函数类型为void()
+    struct Worker {
+        std::mutex mtx;
+        std::deque<InlineTask> tasks;
+        std::atomic<size_t> size{0};    // 不加锁先看一眼，空队列不去抢锁
+    };
+
+    static constexpr size_t STEAL_MAX = 32;     // 一次最多偷的任务数
+    static constexpr int SPIN_ROUNDS = 16;      // 睡眠前查找的轮数，每轮之间让出 CPU
+
+    // 当前线程所属的池及其下标，外部线程为 nullptr
+    struct Local {
+        const ThreadPool* pool = nullptr;
+        int index = -1;
     };
-    std::shared_ptr<Pool> pool_;
+    static Local& Local_() {
+        thread_local Local local;
+        return local;
+    }
+
+    void Push_(InlineTask&& task) {
+        int self = Local_().pool == this ? Local_().index : -1;
+        size_t idx = self >= 0 ? self : next_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+        PushTo_(idx, std::move(task));
+    }
+
+    void PushTo_(size_t idx, InlineTask&& task) {
+        Worker& w = *workers_[idx];
+        std::lock_guard<std::mutex> locker(w.mtx);
+        w.tasks.push_back(std::move(task));
+        w.size.store(w.tasks.size(), std::memory_order_release);
+    }
+
+    bool PopLocal_(int id, InlineTask& task) {
+        Worker& w = *workers_[id];
+        if(w.size.load(std::memory_order_acquire) == 0) { return false; }
+        std::lock_guard<std::mutex> locker(w.mtx);
+        if(w.tasks.empty()) { return false; }
+        task = std::move(w.tasks.front());
+        w.tasks.pop_front();
+        w.size.store(w.tasks.size(), std::memory_order_release);
+        return true;
+    }
+
+    // 从其他队列尾部偷最多一半：取一个直接执行，其余放进自己的队列
+    bool Steal_(int id, InlineTask& task) {
+        size_t n = workers_.size();
+        for(size_t k = 1; k < n; k++) {
+            Worker& victim = *workers_[(id + k) % n];
+            if(victim.size.load(std::memory_order_acquire) == 0) { continue; }
+            InlineTask batch[STEAL_MAX];
+            size_t got = 0;
+            {
+                std::lock_guard<std::mutex> locker(victim.mtx);
+                size_t take = std::min(STEAL_MAX, (victim.tasks.size() + 1) / 2);
+                for(; got < take; got++) {
+                    batch[got] = std::move(victim.tasks.back());
+                    victim.tasks.pop_back();
+                }
+                victim.size.store(victim.tasks.size(), std::memory_order_release);
+            }
+            if(got == 0) { continue; }
+            // batch 里是从新到旧，先执行最旧的，其余按原来的先后顺序放进自己的队列
+            task = std::move(batch[got - 1]);
+            if(got > 1) {
+                Worker& self = *workers_[id];
+                std::lock_guard<std::mutex> locker(self.mtx);
+                for(size_t i = got - 1; i > 0; i--) {
+                    self.tasks.push_back(std::move(batch[i - 1]));
+                }
+                self.size.store(self.tasks.size(), std::memory_order_release);
+            }
+            return true;
+        }
+        return false;
+    }
+
+    bool FindTask_(int id, InlineTask& task) {
+        return PopLocal_(id, task) || Steal_(id, task);
+    }
+
+    void Wake_(size_t n) {
+        std::lock_guard<std::mutex> locker(sleepMtx_);
+        if(n == 1) {
+            sleepCond_.notify_one();
+        } else {
+            for(size_t i = 0; i < n && i < workers_.size(); i++) {
+                sleepCond_.notify_one();
+            }
+        }
+    }
+
+    void Run_(int id) {
+        Local_() = Local{this, id};
+        InlineTask task;
+        bool searching = false;     // 刚被唤醒、还没找到任务
+        while(true) {
+            bool found = false;
+            for(int spin = 0; spin < SPIN_ROUNDS; spin++) {
+                found = FindTask_(id, task);
+                if(found || pending_.load() == 0) { break; }
+                std::this_thread::yield();
+            }
+            if(found) {
+                if(searching) {
+                    searching = false;
+                    // 最后一个找任务的线程找到了，还有积压就接力唤醒下一个
+                    if(searching_.fetch_sub(1) == 1 && pending_.load() > 1 && sleepers_.load() > 0) {
+                        Wake_(1);
+                    }
+                }
+                pending_.fetch_sub(1);
+                task();
+                task.Reset();
+                continue;
+            }
+            std::unique_lock<std::mutex> locker(sleepMtx_);
+            if(searching) {
+                searching = false;
+                searching_.fetch_sub(1);
+            }
+            // 先登记为睡眠再检查积压，与 AddTask 的“先计数再看睡眠数”配对，不会丢唤醒
+            sleepers_.fetch_add(1);
+            if(pending_.load() > 0) {
+                sleepers_.fetch_sub(1);
+                continue;
+            }
+            if(isClosed_) {
+                sleepers_.fetch_sub(1);
+                break;
+            }
+            sleepCond_.wait(locker);
+            sleepers_.fetch_sub(1);
+            searching = true;
+            searching_.fetch_add(1);
+        }
+        Local_() = Local();
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> next_{0};       // 外部线程投递的轮转下标
+    std::atomic<size_t> pending_{0};    // 已投递、还没被取走的任务数
+    std::atomic<int> sleepers_{0};
+    std::atomic<int> searching_{0};
+
+    std::mutex sleepMtx_;
+    std::condition_variable sleepCond_;
+    bool isClosed_ = false;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,67 @@
+#ifndef COMPLETION_QUEUE_H
+#define COMPLETION_QUEUE_H
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <assert.h>
+#include <atomic>
+#include "../log/mpmcqueue.h"
+
+class HttpConn;
+
+/*
+工作线程 -> reactor 的完成队列：工作线程处理完一个连接后不再自己调 epoll_ctl / 关闭连接，
+而是投递“重新监听读 / 重新监听写 / 关闭 / 恢复协程”，由 reactor 在下一轮循环里批量执行。
+队列是无锁 MPSC，eventfd 只在 reactor 取空之后的第一次投递时写一次。
+*/
+class CompletionQueue {
+public:
+    enum Op : uint8_t { REARM_READ, REARM_WRITE, CLOSE, RESUME };    // RESUME：协程模式下恢复连接协程
+
+    struct Completion {
+        HttpConn* client = nullptr;
+        uint32_t gen = 0;           // 投递时连接的 Generation()，对不上说明连接已被关闭复用
+        Op op = CLOSE;
+    };
+
+    explicit CompletionQueue(size_t capacity) : queue_(capacity) {
+        evfd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        assert(evfd_ >= 0);
+    }
+
+    ~CompletionQueue() { close(evfd_); }
+
+    CompletionQueue(const CompletionQueue&) = delete;
+    CompletionQueue& operator=(const CompletionQueue&) = delete;
+
+    int Fd() const { return evfd_; }
+
+    // 任意线程调用；每个连接同一时刻最多一个未处理的完成事件，容量按连接数给足时不会阻塞
+    void Post(HttpConn* client, uint32_t gen, Op op) {
+        queue_.Push(Completion{ client, gen, op });
+        if(!signaled_.exchange(true)) {
+            uint64_t one = 1;
+            ssize_t n = write(evfd_, &one, sizeof(one));
+            (void)n;
+        }
+    }
+
+    // reactor 调用：先清掉 eventfd 和标记再 Take，之后的投递会重新写 eventfd，不会漏
+    void Acknowledge() {
+        uint64_t count;
+        ssize_t r = read(evfd_, &count, sizeof(count));
+        (void)r;
+        signaled_.store(false);
+    }
+
+    size_t Take(Completion* out, size_t n) { return queue_.TryPopBulk(out, n); }
+
+    size_t Pending() const { return queue_.Size(); }
+
+private:
+    int evfd_;
+    MpscQueue<Completion> queue_;
+    std::atomic<bool> signaled_{false};
+};
+
+#endif //COMPLETION_QUEUE_H
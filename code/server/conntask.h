@@ -0,0 +1,26 @@
+#ifndef CONN_TASK_H
+#define CONN_TASK_H
+
+#include <coroutine>
+#include <exception>
+#include "../pool/framepool.h"
+
+/*
+连接协程的返回类型：创建后立即运行，结束时帧自动销毁，没有需要等待的结果。
+挂起点只有两类（见 WebServer::IoAwaiter / OffloadAwaiter），都由 reactor 恢复；
+帧从 FramePool 申请，每个连接整个生命周期只有这一次分配。
+*/
+struct ConnTask {
+    struct promise_type {
+        ConnTask get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+
+        static void* operator new(size_t size) { return FramePool::Allocate(size); }
+        static void operator delete(void* p, size_t size) { FramePool::Deallocate(p, size); }
+    };
+};
+
+#endif //CONN_TASK_H
@@ -2,12 +2,33 @@
 
 Epoller::Epoller(int maxEvent):epollFd_(epoll_create(512)), events_(maxEvent){
     assert(epollFd_ >= 0 && events_.size() > 0);
+    timerFd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    assert(timerFd_ >= 0);
+    AddFd(timerFd_, EPOLLIN);
 }
 
 Epoller::~Epoller() {
+    close(timerFd_);
     close(epollFd_);
 }
 
+bool Epoller::SetTimer(uint64_t deadlineMs) {
+    struct itimerspec its = {};
+    its.it_value.tv_sec = deadlineMs / 1000;
+    its.it_value.tv_nsec = (deadlineMs % 1000) * 1000000;
+    timerDeadline_ = deadlineMs;
+    return 0 == timerfd_settime(timerFd_, TFD_TIMER_ABSTIME, &its, nullptr);
+}
+
+uint64_t Epoller::AckTimer() {
+    uint64_t expirations;
+    ssize_t n = read(timerFd_, &expirations, sizeof(expirations));
+    (void)n;
+    uint64_t deadline = timerDeadline_;
+    timerDeadline_ = 0;
+    return deadline;
+}
+
 bool Epoller::AddFd(int fd, uint32_t events) {
     if(fd < 0) return false;
     epoll_event ev = {0};
@@ -2,6 +2,8 @@
 #define EPOLLER_H
 
 #include <sys/epoll.h> //epoll_ctl()
+#include <sys/timerfd.h>
+#include <stdint.h>
 #include <unistd.h> // close()
 #include <assert.h> // close()
 #include <vector>
@@ -18,9 +20,19 @@ public:
     int Wait(int timeoutMs = -1);
     int GetEventFd(size_t i) const;
     uint32_t GetEvents(size_t i) const;
+
+    // 定时器到期也作为一个 epoll 事件（timerfd，CLOCK_MONOTONIC 绝对时间），Wait 不再需要超时参数
+    int TimerFd() const { return timerFd_; }
+    // 设到 deadlineMs（毫秒）；0 表示取消
+    bool SetTimer(uint64_t deadlineMs);
+    uint64_t TimerDeadline() const { return timerDeadline_; }
+    // 读掉到期计数，返回刚到期的时间点
+    uint64_t AckTimer();
         
 private:
     int epollFd_;
+    int timerFd_;
+    uint64_t timerDeadline_ = 0;    // 当前设置的到期时间，0 表示未设置或已到期
     std::vector<struct epoll_event> events_;    
 };
 
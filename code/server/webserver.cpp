@@ -6,46 +6,115 @@ WebServer::WebServer(
             int port, int trigMode, int timeoutMS,
             int sqlPort, const char* sqlUser, const  char* sqlPwd,
             const char* dbName, int connPoolNum, int threadNum,
-            bool openLog, int logLevel, int logQueSize):
-            port_(port), timeoutMS_(timeoutMS), isClose_(false),
-            timer_(new HeapTimer()), threadpool_(new ThreadPool(threadNum)), epoller_(new Epoller())
+            bool openLog, int logLevel, int logQueSize,
+            bool jitPackaging, int jitCacheMB, bool cmafOutput, bool singleFileOutput,
+            int bufferPoolMB, int diskThreads, int pipelineThreads,
+            bool pinThreads, bool coroutineMode,
+            int headerTimeoutMS, int uploadTimeoutMS, int writeTimeoutMS, int minWriteRate,
+            bool binaryLog, int accessLogSample):
+            port_(port), isClose_(false), coroutine_(coroutineMode),
+            timer_(new TimingWheel()), threadpool_(new ThreadPool(threadNum)), epoller_(new Epoller()),
+            completions_(new CompletionQueue(MAX_FD))
     {
+    // timeoutMS 是保活连接的空闲超时，其余几类各自配置
+    timeouts_[HttpConn::TIMEOUT_HEADER] = headerTimeoutMS;
+    timeouts_[HttpConn::TIMEOUT_IDLE] = timeoutMS;
+    timeouts_[HttpConn::TIMEOUT_UPLOAD] = uploadTimeoutMS;
+    timeouts_[HttpConn::TIMEOUT_WRITE] = writeTimeoutMS;
+    minWriteBytes_ = (size_t)minWriteRate * writeTimeoutMS / 1000;
+    std::fill(reaped_, reaped_ + HttpConn::TIMEOUT_CLASSES, 0);
+
+    // 阻塞型工作各用各的线程：DB 线程数与连接池一致
+    Executors::Instance()->Init(threadpool_.get(), connPoolNum, diskThreads, pipelineThreads, MAX_QUEUED);
 
     // 是否打开日志标志
     if(openLog) {
-        Log::Instance()->init(logLevel, "./log", ".log", logQueSize);
+        // 二进制日志用 bin/logdecode 解码成文本
+        Log::Instance()->init(logLevel, "./log", binaryLog ? ".blog" : ".log", logQueSize, binaryLog);
+        AccessLog::Instance()->Init("./log", accessLogSample);   // 每 accessLogSample 个请求记一条，0 关闭
         if(isClose_) { LOG_ERROR("========== Server init error!=========="); }
         else {
             LOG_INFO("========== Server init ==========");
             LOG_INFO("Listen Mode: %s, OpenConn Mode: %s",
                             (listenEvent_ & EPOLLET ? "ET": "LT"),
                             (connEvent_ & EPOLLET ? "ET": "LT"));
-            LOG_INFO("LogSys level: %d", logLevel);
+            LOG_INFO("LogSys level: %d, format: %s, access log: 1/%d", logLevel, binaryLog ? "binary" : "text", accessLogSample);
             LOG_INFO("srcDir: %s", HttpConn::srcDir);
             LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d", connPoolNum, threadNum);
+            LOG_INFO("Connection mode: %s", coroutine_ ? "coroutine" : "callback");
+            LOG_INFO("Timeouts: header %dms, idle %dms, upload %dms, write %dms (min %dB/s)",
+                            headerTimeoutMS, timeoutMS, uploadTimeoutMS, writeTimeoutMS, minWriteRate);
+            LOG_INFO("Executors: db %d, disk %d, pipeline %d threads, queue limit %zu",
+                            connPoolNum, diskThreads, pipelineThreads, MAX_QUEUED);
+            // 空闲连接的常驻内存：连接对象本身 + 读缓冲区初始容量（写缓冲区的块空闲时已还给池）
+            LOG_INFO("Idle conn: HttpConn %zuB (request %zuB, response %zuB)",
+                            sizeof(HttpConn), sizeof(HttpRequest), sizeof(HttpResponse));
         }
     }
 
+    // 拓扑在分配任何缓冲区之前确定，块内存池按节点分开
+    CpuTopology::Instance()->Detect();
+    LOG_INFO("CPU topology: %s", CpuTopology::Instance()->Describe().c_str());
+    BlockPool::Instance()->SetNodes(CpuTopology::Instance()->NodeOfCpu(), CpuTopology::Instance()->NodeCount());
+    if(pinThreads) { PinThreads_(); }
+
     srcDir_ = getcwd(nullptr, 256);
     assert(srcDir_);
     strcat(srcDir_, "/resources/");
+    BlockPool::Instance()->Init(16 * 1024, (size_t)bufferPoolMB << 20);  // 写缓冲区块大小、池中空闲内存上限
     HttpConn::userCount = 0;
     HttpConn::srcDir = srcDir_;
 
     // 初始化操作
     SqlConnPool::Instance()->Init("localhost", sqlPort, sqlUser, sqlPwd, dbName, connPoolNum);  // 连接池单例的初始化
+    JitPackager::Instance()->Init(jitPackaging, (size_t)jitCacheMB << 20);   // 即时打包及其分片缓存
+    HttpRequest::useCmaf = cmafOutput;      // 转码输出格式：CMAF(HLS+DASH) 或 MPEG-TS
+    HttpRequest::singleFile = singleFileOutput;     // 每路码率单文件 + 字节区间列表
+    FdCache::Instance()->Init(1024);        // 媒体文件 fd 缓存上限
     // 初始化事件和初始化socket(监听)
     InitEventMode_(trigMode);
     if(!InitSocket_()) { isClose_ = true;}
 }
 
 WebServer::~WebServer() {
+    LOG_INFO("Timeout reaped: header %zu, idle %zu, upload %zu, write %zu",
+             reaped_[HttpConn::TIMEOUT_HEADER], reaped_[HttpConn::TIMEOUT_IDLE],
+             reaped_[HttpConn::TIMEOUT_UPLOAD], reaped_[HttpConn::TIMEOUT_WRITE]);
+    // 关闭顺序：Executors::Close 必须在网络线程池（threadpool_ 成员，函数体结束后才析构）之前，
+    // 阻塞通道剩下的任务做完时续体还会投到网络线程池。网络线程、定时器这些提交者此时还活着：
+    // Close 先把各通道切到就地执行，等已经拿到线程池指针的提交者退出 Dispatch_，再析构阻塞通道的线程池
+    Executors::Instance()->Close();
     close(listenFd_);
     isClose_ = true;
     free(srcDir_);
     SqlConnPool::Instance()->ClosePool();
 }
 
+// reactor（当前线程）绑第一个 CPU，工作线程从下一个开始依次绑定；
+// 记下每个 CPU 上的工作线程，新连接按 SO_INCOMING_CPU 交给收包 CPU 上（或同节点）的线程
+void WebServer::PinThreads_() {
+    CpuTopology* topo = CpuTopology::Instance();
+    const vector<int>& cpus = topo->Cpus();
+    bool reactorPinned = CpuTopology::Pin(pthread_self(), cpus[0]);
+
+    vector<int> workerCpus(threadpool_->ThreadCount());
+    for(size_t i = 0; i < workerCpus.size(); i++) {
+        workerCpus[i] = cpus[(i + 1) % cpus.size()];
+    }
+    int pinned = threadpool_->Pin(workerCpus);
+
+    cpuWorker_.assign(topo->NodeOfCpu().size(), -1);
+    for(int cpu : cpus) {
+        for(size_t i = 0; i < workerCpus.size(); i++) {
+            if(workerCpus[i] == cpu) { cpuWorker_[cpu] = i; break; }
+            if(cpuWorker_[cpu] < 0 && topo->NodeOf(workerCpus[i]) == topo->NodeOf(cpu)) { cpuWorker_[cpu] = i; }
+        }
+    }
+    LOG_INFO("Thread placement: reactor cpu%d%s, %d/%zu workers pinned to cpus [%s]",
+             cpus[0], reactorPinned ? "" : "(failed)", pinned, workerCpus.size(),
+             CpuTopology::FormatCpuList(workerCpus).c_str());
+}
+
 void WebServer::InitEventMode_(int trigMode) {
     listenEvent_ = EPOLLRDHUP;    // 检测socket关闭
     connEvent_ = EPOLLONESHOT | EPOLLRDHUP;     // EPOLLONESHOT由一个线程处理
@@ -72,13 +141,12 @@ void WebServer::InitEventMode_(int trigMode) {
 }
 
 void WebServer::Start() {
-    int timeMS = -1;  /* epoll wait timeout == -1 无事件将阻塞 */
     if(!isClose_) { LOG_INFO("========== Server start =========="); }
     while(!isClose_) {
-        if(timeoutMS_ > 0) {
-            timeMS = timer_->GetNextTick();     // 获取下一次的超时等待事件(至少这个时间才会有用户过期，每次关闭超时连接则需要有新的请求进来)
-        }
-        int eventCnt = epoller_->Wait(timeMS);
+        // 超时由 timerfd 唤醒，epoll_wait 不再带超时；醒来后刷新本轮的粗粒度时间
+        int eventCnt = epoller_->Wait(-1);
+        CoarseClock::Update();
+        uint64_t firedAt = 0;
         for(int i = 0; i < eventCnt; i++) {
             /* 处理事件 */
             int fd = epoller_->GetEventFd(i);
@@ -86,6 +154,16 @@ void WebServer::Start() {
             if(fd == listenFd_) {
                 DealListen_();
             }
+            else if(fd == epoller_->TimerFd()) {
+                firedAt = epoller_->AckTimer();
+            }
+            else if(fd == completions_->Fd()) {
+                DealCompletions_();
+            }
+            else if(coroutine_) {
+                assert(users_.count(fd) > 0);
+                DealCoEvent_(&users_[fd], events);
+            }
             else if(events & EPOLLIN) {
                 assert(users_.count(fd) > 0);
                 DealRead_(&users_[fd]);
@@ -95,15 +173,33 @@ void WebServer::Start() {
                 DealWrite_(&users_[fd]);
             } 
             else if(events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                // EPOLLONESHOT 下收到事件说明连接不在工作线程手里，可以直接关
                 assert(users_.count(fd) > 0);
-                DealRead_(&users_[fd]);
-                cout<<"while xunhuan close conn"<<endl;
                 CloseConn_(&users_[fd]);
             }
             else {
                 LOG_ERROR("Unexpected event");
             }
         }
+        ExpireTimers_(firedAt);
+    }
+}
+
+/*
+每轮事件处理完后执行到期的定时器，再按时间轮的下一个到期点设置 timerfd：
+到期点向上取整到 TIMER_SLACK_MS，同一时间片里到期的连接只唤醒一次；
+已设置的到期点不晚于新的到期点时不重设，读写事件把连接往后延时不产生系统调用
+*/
+void WebServer::ExpireTimers_(uint64_t firedAt) {
+    // 粗粒度时钟可能比 timerfd 慢一个内核 tick，timerfd 已经到期说明至少到了它的时间
+    uint64_t now = std::max(CoarseClock::NowMs(), firedAt);
+    timer_->Advance(now);
+    uint64_t deadline = timer_->NextDeadline();
+    if(deadline == 0) { return; }   // 没有定时器：已设置的 timerfd 到期也只是空转一次
+    deadline = (deadline + TIMER_SLACK_MS - 1) / TIMER_SLACK_MS * TIMER_SLACK_MS;
+    uint64_t armed = epoller_->TimerDeadline();
+    if(armed == 0 || deadline < armed) {
+        epoller_->SetTimer(deadline);
     }
 }
 
@@ -111,27 +207,123 @@ void WebServer::SendError_(int fd, const char*info) {
     assert(fd > 0);
     int ret = send(fd, info, strlen(info), 0);
     if(ret < 0) {
-        LOG_WARN("send error to client[%d] error!", fd);
+        LOG_WARN_LIMIT(HttpConn::CHURN_LOG_PER_SEC, "send error to client[%d] error!", fd);
     }
     close(fd);
 }
 
 void WebServer::CloseConn_(HttpConn* client) {
     assert(client);
-    LOG_INFO("Client[%d] quit!", client->GetFd());
+    LOG_DEBUG_LIMIT(HttpConn::CHURN_LOG_PER_SEC, "Client[%d] quit!", client->GetFd());
+    timer_->Cancel(client->Timer());
     epoller_->DelFd(client->GetFd());
     client->Close();
 }
 
+/*
+连接交回 epoll 等客户端时（新连接、完成事件回来、协程挂起等 IO）按它在等什么设置超时：
+请求头从开始等起算，慢慢滴进来的字节不延长；上传每收到数据重新计时；
+写响应按窗口检查进度，到期时在 OnTimeout_ 里看这个窗口发出了多少。
+同一类里重新注册事件只是把原来的截止时间放回时间轮
+*/
+void WebServer::ArmTimeout_(HttpConn* client) {
+    assert(client);
+    HttpConn::TimeoutClass cls = client->CurrentTimeoutClass();
+    HttpConn::TimeoutState& to = client->Timeout();
+    uint64_t now = CoarseClock::NowMs();
+    if(to.cls != cls || cls == HttpConn::TIMEOUT_UPLOAD) {
+        to.cls = cls;
+        to.deadline = now + timeouts_[cls];
+        to.sentMark = client->BytesSent();
+    }
+    if(timeouts_[cls] <= 0) {
+        timer_->Cancel(client->Timer());
+        return;
+    }
+    int remain = to.deadline > now ? (int)(to.deadline - now) : 0;
+    timer_->Add(client->Timer(), remain, &WebServer::OnTimer_, this, client);
+}
+
+static const char* const TIMEOUT_NAMES[HttpConn::TIMEOUT_CLASSES] = { "header", "idle", "upload", "write" };
+
+// 超时回调：连接还在工作线程手里时不能在这里关，等它的完成事件回来
+void WebServer::OnTimeout_(HttpConn* client) {
+    assert(client);
+    HttpConn::TimeoutState& to = client->Timeout();
+    // 写超时窗口里发出的字节够最低速率就开始下一个窗口，否则按慢读者关掉
+    if(to.cls == HttpConn::TIMEOUT_WRITE && !client->IsBusy() && client->BytesSent() - to.sentMark >= minWriteBytes_) {
+        to.deadline = CoarseClock::NowMs() + timeouts_[to.cls];
+        to.sentMark = client->BytesSent();
+        timer_->Add(client->Timer(), timeouts_[to.cls], &WebServer::OnTimer_, this, client);
+        return;
+    }
+    if(to.cls >= 0) {
+        reaped_[to.cls]++;
+        LOG_INFO_LIMIT(HttpConn::CHURN_LOG_PER_SEC, "Client[%d] %s timeout, reaped %zu", client->GetFd(), TIMEOUT_NAMES[to.cls], reaped_[to.cls]);
+    }
+    if(client->IsBusy()) {
+        client->SetClosePending(true);
+        return;
+    }
+    if(client->Coroutine()) {
+        // 协程挂在等待 IO 上：恢复它，由协程自己关闭
+        client->SetClosePending(true);
+        Resume_(client);
+        return;
+    }
+    CloseConn_(client);
+}
+
+void WebServer::OnTimer_(void* server, void* client) {
+    static_cast<WebServer*>(server)->OnTimeout_(static_cast<HttpConn*>(client));
+}
+
+// 工作线程投递完成事件，reactor 在下一轮循环里处理
+void WebServer::Complete_(HttpConn* client, uint32_t gen, CompletionQueue::Op op) {
+    completions_->Post(client, gen, op);
+}
+
+// 一次取完所有完成事件，统一做 epoll_ctl 和关闭；EPOLLONESHOT 下每个连接最多一条
+void WebServer::DealCompletions_() {
+    static const size_t BATCH = 256;
+    CompletionQueue::Completion batch[BATCH];
+    completions_->Acknowledge();
+    size_t n;
+    while((n = completions_->Take(batch, BATCH)) > 0) {
+        for(size_t i = 0; i < n; i++) {
+            HttpConn* client = batch[i].client;
+            if(client->Generation() != batch[i].gen) { continue; }  // 连接已关闭或被复用
+            client->SetBusy(false);
+            if(batch[i].op == CompletionQueue::RESUME) {
+                Resume_(client);
+            } else if(batch[i].op == CompletionQueue::CLOSE || client->IsClosePending()) {
+                CloseConn_(client);
+            } else {
+                ArmTimeout_(client);
+                epoller_->ModFd(client->GetFd(), connEvent_ | (batch[i].op == CompletionQueue::REARM_READ ? EPOLLIN : EPOLLOUT));
+            }
+        }
+        if(n < BATCH) { break; }
+    }
+}
+
 void WebServer::AddClient_(int fd, sockaddr_in addr) {
     assert(fd > 0);
     users_[fd].init(fd, addr);
-    if(timeoutMS_ > 0) {
-        timer_->add(fd, timeoutMS_, std::bind(&WebServer::CloseConn_, this, &users_[fd]));
+    int worker = -1;
+    if(!cpuWorker_.empty()) {
+        int cpu = -1;
+        socklen_t len = sizeof(cpu);
+        if(getsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) == 0 && cpu >= 0 && cpu < (int)cpuWorker_.size()) {
+            worker = cpuWorker_[cpu];
+        }
     }
+    users_[fd].SetWorker(worker);
+    ArmTimeout_(&users_[fd]);
     epoller_->AddFd(fd, EPOLLIN | connEvent_);
     SetFdNonblock(fd);
-    LOG_INFO("Client[%d] in!", users_[fd].GetFd());
+    LOG_DEBUG_LIMIT(HttpConn::CHURN_LOG_PER_SEC, "Client[%d] in!", users_[fd].GetFd());
+    if(coroutine_) { Serve_(&users_[fd]); }     // 请求往往随连接一起到达，协程先直接读一次
 }
 
 // 处理监听套接字，主要逻辑是accept新的套接字，并加入timer和epoller中
@@ -150,23 +342,21 @@ void WebServer::DealListen_() {
     } while(listenEvent_ & EPOLLET);
 }
 
-// 处理读事件，主要逻辑是将OnRead加入线程池的任务队列中
+// 处理读事件，主要逻辑是将OnRead加入线程池的任务队列中；
+// 连接在工作线程（含查库、组包）手里的时间不算客户端的超时，完成事件回来时 ArmTimeout_ 重新设置
 void WebServer::DealRead_(HttpConn* client) {
     assert(client);
-    ExtentTime_(client);
-    threadpool_->AddTask(std::bind(&WebServer::OnRead_, this, client)); // 这是一个右值，bind将参数和函数绑定
+    timer_->Cancel(client->Timer());
+    client->SetBusy(true);
+    PostToWorker_(client, std::bind(&WebServer::OnRead_, this, client)); // 这是一个右值，bind将参数和函数绑定
 }
 
 // 处理写事件，主要逻辑是将OnWrite加入线程池的任务队列中
 void WebServer::DealWrite_(HttpConn* client) {
     assert(client);
-    ExtentTime_(client);
-    threadpool_->AddTask(std::bind(&WebServer::OnWrite_, this, client));
-}
-
-void WebServer::ExtentTime_(HttpConn* client) {
-    assert(client);
-    if(timeoutMS_ > 0) { timer_->adjust(client->GetFd(), timeoutMS_); }
+    timer_->Cancel(client->Timer());
+    client->SetBusy(true);
+    PostToWorker_(client, std::bind(&WebServer::OnWrite_, this, client));
 }
 
 void WebServer::OnRead_(HttpConn* client) {
@@ -179,15 +369,25 @@ void WebServer::OnRead_(HttpConn* client) {
 
 /* 处理读（请求）数据的函数 */
 void WebServer::OnProcess(HttpConn* client,int len) {
+    uint32_t gen = client->Generation();
     // 首先调用process()进行逻辑处理
-    if(client->my_process(len)) {   
-        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLIN); // 响应成功，修改监听事件为写,等待OnWrite_()发送
-    } else {
-        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT);
+    if(client->my_process(len)) {
+        // 请求还没收全，继续读；对端已关闭（len == 0）时转去写，发完后关闭
+        Complete_(client, gen, len == 0 ? CompletionQueue::REARM_WRITE : CompletionQueue::REARM_READ);
+        return;
     }
-    if(len==0)
-    {
-        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT);
+    // 查库在 DB 执行器上做，打开文件、组包在磁盘执行器上做，网络线程立即返回；
+    // 连接是 EPOLLONESHOT 且处于 busy，响应写好之前不会再有事件，定时器也已摘下
+    HttpConn::MediaRequest req = client->GetMediaRequest();
+    bool queued = Executors::Instance()->Db(
+        [req]() { return HttpRequest::getHlsPathById(req.id, req.subPath); },
+        [this, client, gen, req](std::string dataPath) {
+            client->BuildResponse(req, dataPath);
+            Complete_(client, gen, CompletionQueue::REARM_WRITE);
+        }, Executors::DISK);
+    if(!queued) {
+        client->BuildBusyResponse();
+        Complete_(client, gen, CompletionQueue::REARM_WRITE);
     }
 }
 
@@ -195,25 +395,84 @@ void WebServer::OnWrite_(HttpConn* client) {
     assert(client);
     int ret = -1;
     int writeErrno = 0;
+    uint32_t gen = client->Generation();
     ret = client->write(&writeErrno);
     if(client->ToWriteBytes() == 0) {
         /* 传输完成 */
         if(client->IsKeepAlive()) {
-            // OnProcess(client);
-            epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLIN); // 回归换成监测读事件
+            client->ReleaseIdle();  // 等待下一个请求期间不占缓冲区内存
+            Complete_(client, gen, CompletionQueue::REARM_READ); // 回归换成监测读事件
             return;
         }
     }
-    else if(ret < 0) {
-        if(writeErrno == EAGAIN) {  // 缓冲区满了 
-            /* 继续传输 */
-            epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT);
-            return;
+    else if(ret > 0 || writeErrno == EAGAIN) {
+        /* 缓冲区满了，或 LT 模式下剩余不足 10KB 时 write 提前返回：继续传输 */
+        Complete_(client, gen, CompletionQueue::REARM_WRITE);
+        return;
+    }
+    Complete_(client, gen, CompletionQueue::CLOSE);
+}
+
+/*
+一个连接一个协程：读请求 -> 查库、组包（DB/磁盘执行器）-> 写响应 -> 保活则回到读。
+协程只在 reactor 线程上运行，读写都是非阻塞的，EAGAIN 时挂起等待 epoll 事件；
+超时和对端关闭都是把 closePending 置位后恢复协程，由协程走到末尾统一关闭。
+*/
+ConnTask WebServer::Serve_(HttpConn* client) {
+    while(true) {
+        int readErrno = 0;
+        ssize_t len = client->read(&readErrno);
+        if(client->my_process(len)) {
+            // 请求还没收全；对端已关闭或出错时不再等
+            if(len == 0 || (len < 0 && readErrno != EAGAIN)) { break; }
+            if(!co_await IoAwaiter{ this, client, EPOLLIN }) { break; }
+            continue;
         }
+
+        HttpConn::MediaRequest req = client->GetMediaRequest();
+        bool queued = co_await Offload_(client,
+            Executors::DB, [&req]() { return HttpRequest::getHlsPathById(req.id, req.subPath); },
+            Executors::DISK, [client, &req](std::string dataPath) { client->BuildResponse(req, dataPath); });
+        if(client->IsClosePending()) { break; }
+        if(!queued) { client->BuildBusyResponse(); }
+
+        // 组好的响应先直接写，写不完再等可写
+        bool sent = true;
+        while(true) {
+            int writeErrno = 0;
+            ssize_t ret = client->write(&writeErrno);
+            if(client->ToWriteBytes() == 0) { break; }
+            if(ret > 0) { continue; }   // LT 模式下剩余不足 10KB 时 write 提前返回
+            if(writeErrno != EAGAIN || !co_await IoAwaiter{ this, client, EPOLLOUT }) {
+                sent = false;
+                break;
+            }
+        }
+        if(!sent || !client->IsKeepAlive()) { break; }
+        client->ReleaseIdle();  // 等待下一个请求期间不占缓冲区内存
+        if(!co_await IoAwaiter{ this, client, EPOLLIN }) { break; }
     }
     CloseConn_(client);
 }
 
+// 协程模式下连接上的 epoll 事件。协程在执行器上时忽略（EPOLLONESHOT 已消耗，协程回来后会重新注册），
+// 对端半关闭时请求可能已经收全，只有不带 IN/OUT 的 RDHUP/HUP/ERR 才标记关闭
+void WebServer::DealCoEvent_(HttpConn* client, uint32_t events) {
+    assert(client);
+    if(client->IsBusy() || !client->Coroutine()) { return; }
+    if(!(events & (EPOLLIN | EPOLLOUT))) {
+        client->SetClosePending(true);
+    }
+    Resume_(client);
+}
+
+// 先清掉句柄再恢复，协程下一次挂起时会重新设置
+void WebServer::Resume_(HttpConn* client) {
+    std::coroutine_handle<> h = client->Coroutine();
+    client->SetCoroutine(nullptr);
+    h.resume();
+}
+
 /* Create listenFd */
 bool WebServer::InitSocket_() {
     int ret;
@@ -253,6 +512,7 @@ bool WebServer::InitSocket_() {
         close(listenFd_);
         return false;
     }
+    epoller_->AddFd(completions_->Fd(), EPOLLIN);    // 工作线程的完成事件
     ret = epoller_->AddFd(listenFd_,  listenEvent_ | EPOLLIN);  // 将监听套接字加入epoller
     if(ret == 0) {
         LOG_ERROR("Add listen error!");
@@ -9,13 +9,18 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <vector>
 
 #include "epoller.h"
-#include "../timer/heaptimer.h"
+#include "completionqueue.h"
+#include "conntask.h"
+#include "../timer/timingwheel.h"
 
 #include "../log/log.h"
 #include "../pool/sqlconnpool.h"
 #include "../pool/threadpool.h"
+#include "../pool/executors.h"
+#include "../pool/cputopology.h"
 
 #include "../http/httpconn.h"
 
@@ -25,7 +30,12 @@ public:
         int port, int trigMode, int timeoutMS, 
         int sqlPort, const char* sqlUser, const  char* sqlPwd, 
         const char* dbName, int connPoolNum, int threadNum,
-        bool openLog, int logLevel, int logQueSize);
+        bool openLog, int logLevel, int logQueSize,
+        bool jitPackaging = false, int jitCacheMB = 256, bool cmafOutput = false, bool singleFileOutput = false,
+        int bufferPoolMB = 64, int diskThreads = 4, int pipelineThreads = 2,
+        bool pinThreads = false, bool coroutineMode = false,
+        int headerTimeoutMS = 10000, int uploadTimeoutMS = 30000, int writeTimeoutMS = 10000, int minWriteRate = 4096,
+        bool binaryLog = false, int accessLogSample = 0);
 
     ~WebServer();
     void Start();
@@ -40,31 +50,110 @@ private:
     void DealRead_(HttpConn* client);
 
     void SendError_(int fd, const char*info);
-    void ExtentTime_(HttpConn* client);
+    void ArmTimeout_(HttpConn* client);
     void CloseConn_(HttpConn* client);
+    void OnTimeout_(HttpConn* client);
+    static void OnTimer_(void* server, void* client);   // 时间轮回调
+    void ExpireTimers_(uint64_t firedAt);
+    void Complete_(HttpConn* client, uint32_t gen, CompletionQueue::Op op);
+    void DealCompletions_();
+
+    void PinThreads_();
+    // 有指定工作线程的连接投到该线程的队列
+    template<typename F>
+    void PostToWorker_(HttpConn* client, F&& task) {
+        if(client->Worker() >= 0) {
+            threadpool_->AddTaskTo(client->Worker(), std::forward<F>(task));
+        } else {
+            threadpool_->AddTask(std::forward<F>(task));
+        }
+    }
 
     void OnRead_(HttpConn* client);
     void OnWrite_(HttpConn* client);
     void OnProcess(HttpConn* client,int len);
 
+    // 协程模式：每个连接一个协程，读、查库组包、写都在协程里顺序写出，由 reactor 恢复
+    ConnTask Serve_(HttpConn* client);
+    void DealCoEvent_(HttpConn* client, uint32_t events);
+    void Resume_(HttpConn* client);
+
+    // 等待连接可读/可写：挂起时设置超时、重新注册 EPOLLONESHOT 事件；超时或对端关闭时返回 false
+    struct IoAwaiter {
+        WebServer* server;
+        HttpConn* client;
+        uint32_t events;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) {
+            client->SetCoroutine(h);
+            server->ArmTimeout_(client);
+            server->epoller_->ModFd(client->GetFd(), server->connEvent_ | events);
+        }
+        bool await_resume() const noexcept { return !client->IsClosePending(); }
+    };
+
+    // 把工作交给执行器，做完后投递 RESUME 回到 reactor；通道已满时不挂起，返回 false
+    template<typename Submit>
+    struct OffloadAwaiter {
+        WebServer* server;
+        HttpConn* client;
+        Submit submit;
+        bool queued = false;
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> h) {
+            client->SetCoroutine(h);
+            client->SetBusy(true);
+            server->timer_->Cancel(client->Timer());    // 在服务端手里的时间不算客户端的超时
+            queued = submit();
+            if(!queued) {
+                client->SetBusy(false);
+                client->SetCoroutine(nullptr);
+            }
+            return queued;
+        }
+        bool await_resume() const noexcept { return queued; }
+    };
+
+    // work 在 kind 通道上执行，结果交给 then 在 thenKind 通道上执行（同 Executors::Submit）
+    template<typename Work, typename Then>
+    auto Offload_(HttpConn* client, Executors::Kind kind, Work&& work, Executors::Kind thenKind, Then&& then) {
+        uint32_t gen = client->Generation();
+        auto submit = [this, client, gen, kind, thenKind,
+                       work = std::forward<Work>(work), then = std::forward<Then>(then)]() mutable {
+            return Executors::Instance()->Submit(kind, std::move(work), thenKind,
+                [this, client, gen, then = std::move(then)](auto&&... result) mutable {
+                    then(std::forward<decltype(result)>(result)...);
+                    Complete_(client, gen, CompletionQueue::RESUME);
+                });
+        };
+        return OffloadAwaiter<decltype(submit)>{ this, client, std::move(submit) };
+    }
+
     static const int MAX_FD = 65536;
+    static const size_t MAX_QUEUED = 4096;     // 每个阻塞通道最多排队的任务数
+    static const uint64_t TIMER_SLACK_MS = 8;   // timerfd 到期时间向上取整到这个粒度，相近的到期合并成一次唤醒
 
     static int SetFdNonblock(int fd);
 
     int port_;
     bool openLinger_;
-    int timeoutMS_;  /* 毫秒MS */
+    int timeouts_[HttpConn::TIMEOUT_CLASSES];   // 各类超时（毫秒），0 表示不限；写超时是检查进度的窗口
+    size_t minWriteBytes_;  // 一个写超时窗口里至少要发出的字节数
+    size_t reaped_[HttpConn::TIMEOUT_CLASSES];  // 各类超时关闭的连接数
     bool isClose_;
+    bool coroutine_;    // 连接处理方式：协程 / 回调
     int listenFd_;
     char* srcDir_;
     
     uint32_t listenEvent_;  // 监听事件
     uint32_t connEvent_;    // 连接事件
    
-    std::unique_ptr<HeapTimer> timer_;
+    std::unique_ptr<TimingWheel> timer_;
     std::unique_ptr<ThreadPool> threadpool_;
     std::unique_ptr<Epoller> epoller_;
+    std::unique_ptr<CompletionQueue> completions_;  // 工作线程 -> reactor，只有 reactor 调 epoll_ctl
     std::unordered_map<int, HttpConn> users_;
+    std::vector<int> cpuWorker_;    // 下标为 CPU 编号，值为绑在该 CPU（或同节点）上的工作线程；为空表示不绑核
 };
 
 
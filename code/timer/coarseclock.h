@@ -0,0 +1,49 @@
+#ifndef COARSE_CLOCK_H
+#define COARSE_CLOCK_H
+
+#include <stdint.h>
+#include <time.h>
+
+/*
+粗粒度时钟（CLOCK_*_COARSE，精度为一个内核 tick，读取不进内核）。
+reactor 每轮 epoll_wait 返回后调用一次 Update，本轮里的定时器增删、到期和日志都用这一个时间，
+不再每次 adjust、每个堆结点各读一次时钟。
+没有调用过 Update 的线程（工作线程、执行器）每次直接读粗粒度时钟：reactor 可能在 epoll_wait 里睡很久，
+它的缓存对别的线程没有意义。
+*/
+class CoarseClock {
+public:
+    static void Update() {
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &cache_.mono);
+        clock_gettime(CLOCK_REALTIME_COARSE, &cache_.wall);
+        cache_.valid = true;
+    }
+
+    // 单调时钟，毫秒
+    static uint64_t NowMs() {
+        struct timespec ts = Mono();
+        return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    }
+
+    static struct timespec Mono() { return Read_(cache_.mono, CLOCK_MONOTONIC_COARSE); }
+    // 墙上时间，日志时间戳用
+    static struct timespec Wall() { return Read_(cache_.wall, CLOCK_REALTIME_COARSE); }
+
+private:
+    struct Cache {      // 线程局部变量零初始化
+        struct timespec mono;
+        struct timespec wall;
+        bool valid;
+    };
+
+    static struct timespec Read_(const struct timespec& cached, clockid_t id) {
+        if(cache_.valid) { return cached; }
+        struct timespec ts;
+        clock_gettime(id, &ts);
+        return ts;
+    }
+
+    static inline thread_local Cache cache_;
+};
+
+#endif //COARSE_CLOCK_H
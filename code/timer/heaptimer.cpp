@@ -1,4 +1,7 @@
 #include "heaptimer.h"
+#include <iostream>
+
+using namespace std;
 
 void HeapTimer::SwapNode_(size_t i, size_t j) {
     assert(i >= 0 && i <heap_.size());
@@ -10,12 +13,11 @@ void HeapTimer::SwapNode_(size_t i, size_t j) {
 
 void HeapTimer::siftup_(size_t i) {
     assert(i >= 0 && i < heap_.size());
-    size_t parent = (i-1) / 2;
-    while(parent >= 0) {
+    while(i > 0) {      // i 为 0 时 (i-1)/2 会下溢
+        size_t parent = (i-1) / 2;
         if(heap_[parent] > heap_[i]) {
             SwapNode_(i, parent);
             i = parent;
-            parent = (i-1)/2;
         } else {
             break;
         }
@@ -36,8 +38,9 @@ bool HeapTimer::siftdown_(size_t i, size_t n) {
             SwapNode_(index, child);
             index = child;
             child = 2*child+1;
+        } else {
+            break;  // 已经比两个孩子小
         }
-        break;  // 需要跳出循环
     }
     return index > i;
 }
@@ -0,0 +1,164 @@
+#include "timingwheel.h"
+
+TimingWheel::TimingWheel() {
+    for(WheelLink& s : slots_) { s.prev = s.next = &s; }
+    for(uint64_t& b : bitmap_) { b = 0; }
+    current_ = CoarseClock::NowMs();
+}
+
+void TimingWheel::Add(WheelNode* node, int timeoutMs, TimeoutFn fn, void* ctx, void* arg) {
+    assert(node && fn);
+    node->fn = fn;
+    node->ctx = ctx;
+    node->arg = arg;
+    Adjust(node, timeoutMs);
+}
+
+void TimingWheel::Adjust(WheelNode* node, int timeoutMs) {
+    assert(node && node->fn);
+    uint64_t expires = CoarseClock::NowMs() + (timeoutMs > 0 ? timeoutMs : 0);
+    if(node->Linked()) {
+        if(node->expires == expires) { return; }
+        Unlink_(node);
+    }
+    node->expires = expires;
+    Place_(node);
+}
+
+void TimingWheel::Cancel(WheelNode* node) {
+    if(node->Linked()) { Unlink_(node); }
+}
+
+// 按离 current_ 的距离选层，槽号取到期时间在该层的那几位
+void TimingWheel::Place_(WheelNode* node) {
+    if(node->expires < current_) { node->expires = current_; }
+    uint64_t delta = node->expires - current_;
+    if(delta >= MAX_DELTA) {
+        node->expires = current_ + MAX_DELTA - 1;
+        delta = MAX_DELTA - 1;
+    }
+    int level = 0;
+    while(level < LEVELS - 1 && delta >= ((uint64_t)1 << Shift_(level + 1))) { level++; }
+    uint64_t mask = (level == 0 ? L0_SIZE : LN_SIZE) - 1;
+    int slot = Base_(level) + ((node->expires >> Shift_(level)) & mask);
+
+    WheelLink* head = &slots_[slot];
+    node->prev = head->prev;
+    node->next = head;
+    head->prev->next = node;
+    head->prev = node;
+    node->slot = slot;
+    bitmap_[slot >> 6] |= (uint64_t)1 << (slot & 63);
+    size_++;
+}
+
+void TimingWheel::Unlink_(WheelNode* node) {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = node->next = nullptr;
+    if(Empty_(node->slot)) {
+        bitmap_[node->slot >> 6] &= ~((uint64_t)1 << (node->slot & 63));
+    }
+    size_--;
+}
+
+// current_ 走到第 0 层的整圈时，把上层当前槽的结点按新的距离重新放；上层也转完一圈时继续往上。
+// 先把整条链表摘下来再放：离得正好一整圈的结点会放回同一个槽，等下一圈
+void TimingWheel::Cascade_() {
+    for(int level = 1; level < LEVELS; level++) {
+        int idx = (current_ >> Shift_(level)) & (LN_SIZE - 1);
+        int slot = Base_(level) + idx;
+        WheelLink* head = &slots_[slot];
+        WheelLink* p = head->next;
+        head->prev = head->next = head;
+        bitmap_[slot >> 6] &= ~((uint64_t)1 << (slot & 63));
+        while(p != head) {
+            WheelNode* node = static_cast<WheelNode*>(p);
+            p = p->next;
+            size_--;
+            Place_(node);
+        }
+        if(idx != 0) { break; }
+    }
+}
+
+// 回调里可能增删别的定时器（包括同一个槽里的），每次只摘下链表头
+void TimingWheel::RunSlot_(int slot) {
+    while(!Empty_(slot)) {
+        WheelNode* node = static_cast<WheelNode*>(slots_[slot].next);
+        Unlink_(node);
+        node->fn(node->ctx, node->arg);
+    }
+}
+
+// current_ 所在这一圈里第 0 层下一个非空槽的 tick，没有则为下一圈的起点
+uint64_t TimingWheel::NextLevel0_() const {
+    uint64_t base = current_ & ~(L0_SIZE - 1);
+    for(uint64_t idx = current_ & (L0_SIZE - 1); idx < L0_SIZE; ) {
+        uint64_t word = bitmap_[idx >> 6] >> (idx & 63);
+        if(word) { return base + idx + __builtin_ctzll(word); }
+        idx = (idx | 63) + 1;
+    }
+    return base + L0_SIZE;
+}
+
+void TimingWheel::Advance(uint64_t now) {
+    if(size_ == 0) {    // 空轮直接追上，之后加入的结点按真实距离选层
+        if(current_ <= now) { current_ = now + 1; }
+        return;
+    }
+    while(current_ <= now) {
+        if((current_ & (L0_SIZE - 1)) == 0) { Cascade_(); }
+        RunSlot_(current_ & (L0_SIZE - 1));
+        current_++;
+        // 跳过空槽：直接到下一个非空槽或下一次下放（整圈的起点要处理下放，不能跳过）
+        if(current_ & (L0_SIZE - 1)) {
+            uint64_t next = NextLevel0_();
+            current_ = next <= now + 1 ? next : now + 1;
+        }
+    }
+}
+
+int64_t TimingWheel::NextEvent() const {
+    if(size_ == 0) { return -1; }
+    uint64_t next = UINT64_MAX;
+    // 第 0 层：环形找第一个非空槽，槽里的结点都在 [current_, current_ + 256) 内
+    for(uint64_t d = 0; d < L0_SIZE; ) {
+        uint64_t idx = (current_ + d) & (L0_SIZE - 1);
+        uint64_t word = bitmap_[idx >> 6] >> (idx & 63);
+        if(word) {
+            next = current_ + d + __builtin_ctzll(word);
+            break;
+        }
+        d += 64 - (idx & 63);
+    }
+    // 上层：非空槽在它的起点下放；current_ 正好是当前槽的起点时它还没下放，否则从下一个槽算起
+    for(int level = 1; level < LEVELS; level++) {
+        uint64_t word = bitmap_[Base_(level) >> 6];
+        if(!word) { continue; }
+        int shift = Shift_(level);
+        uint64_t idx = (current_ >> shift) & (LN_SIZE - 1);
+        if((current_ & (((uint64_t)1 << shift) - 1)) == 0 && ((word >> idx) & 1)) {
+            next = current_;
+            break;
+        }
+        uint64_t rotated = (idx + 1 == LN_SIZE) ? word : ((word >> (idx + 1)) | (word << (LN_SIZE - idx - 1)));
+        uint64_t k = __builtin_ctzll(rotated) + 1;
+        uint64_t start = ((current_ >> shift) + k) << shift;
+        if(start < next) { next = start; }
+    }
+    return next > current_ ? (int64_t)(next - current_) : 0;
+}
+
+uint64_t TimingWheel::NextDeadline() const {
+    int64_t ticks = NextEvent();
+    return ticks < 0 ? 0 : current_ + ticks;
+}
+
+int TimingWheel::GetNextTick() {
+    uint64_t now = CoarseClock::NowMs();
+    Advance(now);
+    int64_t ticks = NextEvent();
+    // current_ 已经是 now + 1，第一个 tick 的处理时间是 now + 1
+    return ticks < 0 ? -1 : (int)(ticks + 1);
+}
@@ -0,0 +1,83 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+#include "coarseclock.h"
+
+typedef void (*TimeoutFn)(void* ctx, void* arg);
+
+struct WheelLink {
+    WheelLink* prev = nullptr;
+    WheelLink* next = nullptr;
+};
+
+// 侵入式定时器结点，嵌在连接对象里，不单独分配；回调是普通函数指针
+struct WheelNode : WheelLink {
+    uint64_t expires = 0;   // 到期的 tick（毫秒）
+    TimeoutFn fn = nullptr;
+    void* ctx = nullptr;
+    void* arg = nullptr;
+    uint16_t slot = 0;      // 所在的槽，挂在链表上时有效
+
+    bool Linked() const { return prev != nullptr; }
+};
+
+/*
+分层时间轮，1 tick = 1ms：第 0 层 256 个槽，之后三层各 64 个槽，覆盖约 18.6 小时，更远的按最远处理。
+到期时间落在哪一层由离当前 tick 的距离决定，高层的槽在低层转完一圈时往下层重新分配。
+Add / Adjust / Cancel 都是 O(1) 的链表操作，没有查表；每层一张位图记录非空槽，
+GetNextTick 据此直接算出下一次需要处理的时间，不用逐槽扫描。
+*/
+class TimingWheel {
+public:
+    TimingWheel();
+    ~TimingWheel() = default;
+
+    TimingWheel(const TimingWheel&) = delete;
+    TimingWheel& operator=(const TimingWheel&) = delete;
+
+    // 结点已在轮上时等同于 Adjust 并替换回调
+    void Add(WheelNode* node, int timeoutMs, TimeoutFn fn, void* ctx, void* arg);
+    // 按原回调重新计时
+    void Adjust(WheelNode* node, int timeoutMs);
+    void Cancel(WheelNode* node);
+
+    // 执行到期的回调，返回距下一次需要处理的毫秒数，没有定时器返回 -1
+    int GetNextTick();
+    // 执行 now 及之前到期的回调（now 为 CoarseClock::NowMs() 的时间基准）
+    void Advance(uint64_t now);
+    // 距下一次需要处理还有多少 tick（到期或高层槽下放），没有定时器返回 -1
+    int64_t NextEvent() const;
+    // 下一次需要处理的绝对时间（毫秒），没有定时器返回 0；用来设置 timerfd
+    uint64_t NextDeadline() const;
+
+    size_t Size() const { return size_; }
+
+private:
+    static const int LEVELS = 4;
+    static const int L0_BITS = 8;
+    static const int LN_BITS = 6;
+    static const uint64_t L0_SIZE = 1 << L0_BITS;
+    static const uint64_t LN_SIZE = 1 << LN_BITS;
+    static const uint64_t MAX_DELTA = (uint64_t)1 << (L0_BITS + (LEVELS - 1) * LN_BITS);
+    static const int SLOTS = L0_SIZE + (LEVELS - 1) * LN_SIZE;
+
+    static int Shift_(int level) { return level == 0 ? 0 : L0_BITS + (level - 1) * LN_BITS; }
+    static int Base_(int level) { return level == 0 ? 0 : L0_SIZE + (level - 1) * LN_SIZE; }
+
+    void Place_(WheelNode* node);
+    void Unlink_(WheelNode* node);
+    void Cascade_();
+    void RunSlot_(int slot);
+    uint64_t NextLevel0_() const;
+    bool Empty_(int slot) const { return slots_[slot].next == &slots_[slot]; }
+
+    WheelLink slots_[SLOTS];        // 各槽的哨兵
+    uint64_t bitmap_[SLOTS / 64];   // 非空槽
+    uint64_t current_;              // 下一个要处理的 tick
+    size_t size_ = 0;
+};
+
+#endif //TIMING_WHEEL_H
@@ -0,0 +1,41 @@
+/*
+二进制日志解码：logdecode <文件>...
+按文本日志的格式输出到标准输出，每个文件自带格式定义，可以单独解码；最后一条没写完的记录忽略
+*/
+#include <stdio.h>
+#include <string>
+#include "../log/binlog.h"
+
+static bool ReadFile(const char* path, std::string* data) {
+    FILE* fp = fopen(path, "rb");
+    if(!fp) { return false; }
+    char buf[1 << 16];
+    size_t n;
+    while((n = fread(buf, 1, sizeof(buf), fp)) > 0) { data->append(buf, n); }
+    bool ok = !ferror(fp);
+    fclose(fp);
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        fprintf(stderr, "usage: %s <binary log>...\n", argv[0]);
+        return 2;
+    }
+    int failed = 0;
+    for(int i = 1; i < argc; i++) {
+        std::string data, text;
+        if(!ReadFile(argv[i], &data)) {
+            fprintf(stderr, "%s: cannot read\n", argv[i]);
+            failed++;
+            continue;
+        }
+        if(BinLog::Decode(data.data(), data.size(), &text) < 0) {
+            fprintf(stderr, "%s: not a binary log\n", argv[i]);
+            failed++;
+            continue;
+        }
+        fwrite(text.data(), 1, text.size(), stdout);
+    }
+    return failed ? 1 : 0;
+}
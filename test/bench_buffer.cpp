@@ -0,0 +1,172 @@
+/*
+Buffer 微基准：模拟 HttpConn 与 Log 的典型用法
+  read   : ReadFd 读入一个请求头 -> search "\r\n\r\n" -> RetrieveAll
+  write  : Append 响应头 + 响应体 -> 按 64KB 分批 Retrieve（模拟 writev 发送）
+  log    : snprintf 到 BeginWrite -> HasWritten -> Append 换行 -> RetrieveAll
+LegacyBuffer 保留旧实现的关键行为（原子下标、RetrieveAll 清零、vector 扩容拷贝）作为对照
+*/
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "../code/buffer/buffer.h"
+
+class LegacyBuffer {
+public:
+    LegacyBuffer(int initBuffSize = 1024) : buffer_(initBuffSize), readPos_(0), writePos_(0) {}
+    size_t WritableBytes() const { return buffer_.size() - writePos_; }
+    size_t ReadableBytes() const { return writePos_ - readPos_; }
+    const char* Peek() const { return &buffer_[readPos_]; }
+    char* BeginWrite() { return &buffer_[writePos_]; }
+    const char* BeginWriteConst() const { return &buffer_[writePos_]; }
+    void HasWritten(size_t len) { writePos_ += len; }
+    void Retrieve(size_t len) { readPos_ += len; }
+    void RetrieveAll() {
+        bzero(&buffer_[0], buffer_.size());
+        readPos_ = writePos_ = 0;
+    }
+    void Append(const char* str, size_t len) {
+        if(len > WritableBytes()) MakeSpace_(len);
+        std::copy(str, str + len, BeginWrite());
+        HasWritten(len);
+    }
+    ssize_t ReadFd(int fd, int* Errno) {
+        ssize_t len = recv(fd, BeginWrite(), WritableBytes(), 0);
+        if(len < 0) *Errno = errno;
+        else writePos_ += len;
+        return len;
+    }
+private:
+    void MakeSpace_(size_t len) {
+        if(WritableBytes() + readPos_ < len) {
+            buffer_.resize(writePos_ + len + 1);
+        } else {
+            size_t readable = ReadableBytes();
+            std::copy(&buffer_[readPos_], &buffer_[writePos_], &buffer_[0]);
+            readPos_ = 0;
+            writePos_ = readable;
+        }
+    }
+    std::vector<char> buffer_;
+    std::atomic<std::size_t> readPos_;
+    std::atomic<std::size_t> writePos_;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static double Elapsed(Clock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+}
+
+static std::string MakeRequest() {
+    std::string req = "GET /vid_1769671677_9383/720p/index007.ts HTTP/1.1\r\nHost: 127.0.0.1:1316\r\n";
+    while(req.size() < 1400) { req += "X-Padding: aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\r\n"; }
+    return req + "\r\n";
+}
+
+template<typename B>
+double BenchRead(B& buff, int rounds) {
+    int sv[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    std::string req = MakeRequest();
+    const char CRLF2[] = "\r\n\r\n";
+    size_t found = 0;
+    int err = 0;
+    Clock::time_point begin = Clock::now();
+    for(int i = 0; i < rounds; i++) {
+        ssize_t n = write(sv[1], req.data(), req.size());
+        (void)n;
+        buff.ReadFd(sv[0], &err);
+        const char* end = std::search(buff.Peek(), buff.BeginWriteConst(), CRLF2, CRLF2 + 4);
+        found += end != buff.BeginWriteConst();
+        buff.RetrieveAll();
+    }
+    double ms = Elapsed(begin);
+    close(sv[0]);
+    close(sv[1]);
+    if(found != (size_t)rounds) printf("  !! header not found %zu/%d\n", found, rounds);
+    return ms;
+}
+
+template<typename B>
+double BenchWrite(B& buff, size_t bodySize, int rounds) {
+    std::string header(220, 'h');
+    std::string body(bodySize, 'b');
+    Clock::time_point begin = Clock::now();
+    for(int i = 0; i < rounds; i++) {
+        buff.Append(header.data(), header.size());
+        buff.Append(body.data(), body.size());
+        while(buff.ReadableBytes() > 0) {
+            buff.Retrieve(std::min<size_t>(buff.ReadableBytes(), 64 * 1024));
+        }
+        buff.RetrieveAll();
+    }
+    return Elapsed(begin);
+}
+
+template<typename B>
+double BenchLog(B& buff, int rounds) {
+    Clock::time_point begin = Clock::now();
+    for(int i = 0; i < rounds; i++) {
+        int n = snprintf(buff.BeginWrite(), 128, "2026-10-18 12:00:00.%06d [info] : ", i % 1000000);
+        buff.HasWritten(n);
+        int m = snprintf(buff.BeginWrite(), buff.WritableBytes(), "Client[%d](%s:%d) in, userCount:%d", i, "127.0.0.1", 5000, 7);
+        buff.HasWritten(m);
+        buff.Append("\n\0", 2);
+        buff.RetrieveAll();
+    }
+    return Elapsed(begin);
+}
+
+int main() {
+    const int READ_ROUNDS = 200000;
+    const int LOG_ROUNDS = 2000000;
+    printf("%-34s %12s %12s %12s\n", "case", "legacy(ms)", "linear(ms)", "chained(ms)");
+    {
+        LegacyBuffer legacy(4096);
+        Buffer linear(4096);
+        printf("%-34s %12.1f %12.1f %12s\n", "read 1.4KB header x200k",
+               BenchRead(legacy, READ_ROUNDS), BenchRead(linear, READ_ROUNDS), "-");
+    }
+    const size_t sizes[] = { 4 * 1024, 256 * 1024, 5 * 1024 * 1024 };
+    const int rounds[] = { 200000, 4000, 200 };
+    for(int i = 0; i < 3; i++) {
+        // 分 4 组，每组用新的缓冲区，组内复用（同一连接上的连续响应）
+        double legacyMs = 0, linearMs = 0, chainMs = 0;
+        for(int r = 0; r < 4; r++) {
+            LegacyBuffer legacy;
+            Buffer linear;
+            Buffer chained(0, 16 * 1024);
+            legacyMs += BenchWrite(legacy, sizes[i], rounds[i] / 4);
+            linearMs += BenchWrite(linear, sizes[i], rounds[i] / 4);
+            chainMs += BenchWrite(chained, sizes[i], rounds[i] / 4);
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "write %zuKB body x%d", sizes[i] / 1024, rounds[i]);
+        printf("%-34s %12.1f %12.1f %12.1f\n", name, legacyMs, linearMs, chainMs);
+    }
+    {
+        // 新连接上的第一个大响应：从 1KB 开始增长，旧实现要反复 realloc 拷贝
+        double legacyMs = 0, linearMs = 0, chainMs = 0;
+        for(int r = 0; r < 200; r++) {
+            LegacyBuffer legacy;
+            Buffer linear;
+            Buffer chained(0, 16 * 1024);
+            legacyMs += BenchWrite(legacy, 5 * 1024 * 1024, 1);
+            linearMs += BenchWrite(linear, 5 * 1024 * 1024, 1);
+            chainMs += BenchWrite(chained, 5 * 1024 * 1024, 1);
+        }
+        printf("%-34s %12.1f %12.1f %12.1f\n", "write 5MB body, fresh buffer x200", legacyMs, linearMs, chainMs);
+    }
+    {
+        LegacyBuffer legacy(1024);
+        Buffer linear(1024);
+        printf("%-34s %12.1f %12.1f %12s\n", "log line x2M",
+               BenchLog(legacy, LOG_ROUNDS), BenchLog(linear, LOG_ROUNDS), "-");
+    }
+    return 0;
+}
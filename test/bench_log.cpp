@@ -0,0 +1,68 @@
+/*
+日志基准：T 个线程各打 N 条 LOG_INFO（和 "Client in" 一样带几个参数），异步方式，写到 ./benchlog
+  text   : 调用线程格式化成文本
+  binary : 调用线程只记格式串编号和原始参数，由 logdecode 离线格式化
+  debug filtered : 等级 1 下的 LOG_DEBUG，只剩运行时的等级判断
+  info limited   : LOG_INFO_LIMIT 每秒 10 条，绝大部分被限流计数
+  cpu ns/call : 各线程自己消耗的 CPU 时间之和 / 总条数，包括加锁等待、格式化和投递，不含写线程
+  wall ms     : 所有线程打完的时间（核数少于线程数时主要反映总的 CPU 消耗）
+*/
+#include <stdio.h>
+#include <time.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "../code/log/log.h"
+
+typedef std::chrono::steady_clock BenchClock;
+
+static const int CALLS = 50000;
+
+static double ThreadCpuNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+template<typename Call>
+static void Run(const char* mode, Call call) {
+    printf("%-16s %8s %14s %10s\n", mode, "threads", "cpu ns/call", "wall ms");
+    for(int threads : { 1, 4, 8, 16 }) {
+        std::atomic<double> cpuNs(0);
+        BenchClock::time_point begin = BenchClock::now();
+        std::vector<std::thread> workers;
+        for(int t = 0; t < threads; t++) {
+            workers.emplace_back([t, &cpuNs, &call]() {
+                double start = ThreadCpuNs();
+                for(int i = 0; i < CALLS; i++) {
+                    call(t * CALLS + i, i);
+                }
+                double used = ThreadCpuNs() - start;
+                double cur = cpuNs.load();
+                while(!cpuNs.compare_exchange_weak(cur, cur + used)) {}
+            });
+        }
+        for(std::thread& w : workers) { w.join(); }
+        double wallMs = std::chrono::duration<double, std::milli>(BenchClock::now() - begin).count();
+        printf("%-16s %8d %14.1f %10.1f\n", "", threads, cpuNs.load() / ((double)threads * CALLS), wallMs);
+    }
+}
+
+static void ClientIn(int id, int count) {
+    LOG_INFO("Client[%d](%s:%d) in, userCount:%d", id, "10.0.0.1", 5555, count);
+}
+
+int main() {
+    Log::Instance()->init(1, "./benchlog", ".log", 1024);
+    Run("text", ClientIn);
+    Run("debug filtered", [](int id, int count) {
+        LOG_DEBUG("Client[%d](%s:%d) in, userCount:%d", id, "10.0.0.1", 5555, count);
+    });
+    Run("info limited", [](int id, int count) {
+        LOG_INFO_LIMIT(10, "Client[%d](%s:%d) in, userCount:%d", id, "10.0.0.1", 5555, count);
+    });
+    Log::Instance()->init(1, "./benchlog", ".blog", 1024, true);
+    Run("binary", ClientIn);
+    return 0;
+}
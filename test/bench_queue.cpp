@@ -0,0 +1,103 @@
+/*
+日志队列基准：P 个生产者各写 N 条日志长度的字符串，1 个写线程消费
+生产者按 Log::write 的方式投递：队列满时不等待，改为同步写（这里只计数）；
+队列容量与总条数相同，测的是入队/出队本身的吞吐，sync% 应为 0
+  BlockQueue : 原来的 deque + 一把锁 + 两个条件变量，先 full() 再 push_back，两次加锁
+  MpscQueue  : 无锁有界队列 TryPush，写线程 PopBulk 批量取（完成队列、访问日志的用法；Log 已改用线程暂存区）
+  MpmcQueue  : 同一队列的多消费者版本，同样 1 个消费者，对比出队 CAS 的开销
+输出总耗时和落到同步写的比例
+*/
+#include <stdio.h>
+#include <assert.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../code/log/blockqueue.h"
+#include "../code/log/mpmcqueue.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static const char* kLine = "2024-01-01 12:00:00.000000 [info] : Client[42](10.0.0.1:5555) in, userCount:17\n";
+
+struct Result {
+    double ms;
+    double syncRatio;
+};
+
+template<typename Produce, typename Consume>
+static Result Run(int producers, size_t perProducer, Produce produce, Consume consume) {
+    std::atomic<bool> finished(false);
+    std::atomic<size_t> sync(0);
+    Clock::time_point begin = Clock::now();
+    std::thread consumer([&]() { consume(finished); });
+    std::vector<std::thread> prods;
+    for(int p = 0; p < producers; p++) {
+        prods.emplace_back([&]() {
+            size_t local = 0;
+            for(size_t i = 0; i < perProducer; i++) { local += !produce(); }
+            sync += local;
+        });
+    }
+    for(auto& t : prods) { t.join(); }
+    finished = true;
+    consumer.join();
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+    return Result{ ms, (double)sync / (producers * perProducer) };
+}
+
+static Result BenchBlockQueue(int producers, size_t perProducer) {
+    BlockQueue<std::string> q(producers * perProducer);
+    return Run(producers, perProducer,
+        [&]() {
+            if(q.full()) { return false; }
+            q.push_back(std::string(kLine));
+            return true;
+        },
+        [&](std::atomic<bool>& finished) {
+            std::string s;
+            while(!(finished && q.empty())) {
+                if(q.empty()) { std::this_thread::yield(); continue; }
+                q.pop(s);
+            }
+        });
+}
+
+template<typename Queue>
+static Result BenchBounded(int producers, size_t perProducer) {
+    Queue q(producers * perProducer);
+    return Run(producers, perProducer,
+        [&]() { return q.TryPush(std::string(kLine)); },
+        [&](std::atomic<bool>& finished) {
+            std::string batch[64];
+            while(q.PopBulk(batch, 64, 1) > 0 || !finished || !q.Empty()) {}
+        });
+}
+
+// 每种各跑 3 次取最快的一次：上一轮在另一个线程里释放的大量小块会拖慢紧接着的一轮
+template<typename Bench>
+static Result Best(Bench bench) {
+    Result best = bench();
+    for(int i = 1; i < 3; i++) {
+        Result r = bench();
+        if(r.ms < best.ms) { best = r; }
+    }
+    return best;
+}
+
+int main() {
+    const int producerCounts[] = { 1, 4, 8, 16 };
+    const size_t total = 800000;
+    printf("%-14s %22s %22s %22s\n", "producers", "BlockQueue ms (sync%)", "MpscQueue ms (sync%)", "MpmcQueue ms (sync%)");
+    for(int p : producerCounts) {
+        char name[32];
+        snprintf(name, sizeof(name), "%d x %zu", p, total / p);
+        Result a = Best([&]() { return BenchBlockQueue(p, total / p); });
+        Result b = Best([&]() { return BenchBounded<MpscQueue<std::string>>(p, total / p); });
+        Result c = Best([&]() { return BenchBounded<MpmcQueue<std::string>>(p, total / p); });
+        printf("%-14s %14.1f (%4.1f%%) %14.1f (%4.1f%%) %14.1f (%4.1f%%)\n", name,
+               a.ms, a.syncRatio * 100, b.ms, b.syncRatio * 100, c.ms, c.syncRatio * 100);
+    }
+    return 0;
+}
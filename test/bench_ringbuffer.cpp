@@ -0,0 +1,107 @@
+/*
+RingBuffer 与 Buffer(连续模式) 对比：模拟连接读路径上的混合流量
+客户端数据按随机大小的块到达（TCP 分段），解析器逐行取请求头，遇到空行后按 Content-Length
+消费请求体（上传场景）；每次只消费完整的行/已到达的请求体，残留数据留在缓冲区里等下一块。
+Buffer 在写区不足时要把残留数据搬到开头（MakeSpace_），RingBuffer 不需要
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "../code/buffer/buffer.h"
+#include "../code/buffer/ringbuffer.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// 一段请求流：若干 GET（只有头）与 POST（头 + 请求体）交替
+static std::string MakeTraffic(size_t requests, size_t bodySize) {
+    std::string stream;
+    std::string body(bodySize, 'b');
+    for(size_t i = 0; i < requests; i++) {
+        if(i % 4 == 3) {
+            stream += "POST /upload/chunk HTTP/1.1\r\nHost: 127.0.0.1:1316\r\n"
+                      "Content-Type: application/octet-stream\r\n"
+                      "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+        } else {
+            stream += "GET /vid_1769671677_9383/720p/index" + std::to_string(i % 1000) + ".ts HTTP/1.1\r\n"
+                      "Host: 127.0.0.1:1316\r\nUser-Agent: bench\r\nAccept: */*\r\nRange: bytes=0-\r\n\r\n";
+        }
+    }
+    return stream;
+}
+
+struct Parser {
+    size_t bodyLeft = 0;
+    size_t contentLength = 0;
+    size_t headers = 0;
+    size_t requests = 0;
+
+    template<typename B>
+    void Consume(B& buff) {
+        const char CRLF[] = "\r\n";
+        while(buff.ReadableBytes() > 0) {
+            if(bodyLeft > 0) {
+                size_t n = std::min(bodyLeft, buff.ReadableBytes());
+                buff.Retrieve(n);
+                bodyLeft -= n;
+                if(bodyLeft == 0) requests++;
+                continue;
+            }
+            const char* end = std::search(buff.Peek(), buff.BeginWriteConst(), CRLF, CRLF + 2);
+            if(end == buff.BeginWriteConst()) return;   // 半行，等下一块
+            size_t len = end - buff.Peek();
+            if(len == 0) {      // 头结束
+                bodyLeft = contentLength;
+                contentLength = 0;
+                if(bodyLeft == 0) requests++;
+            } else {
+                headers++;
+                if(len > 16 && strncmp(buff.Peek(), "Content-Length: ", 16) == 0) {
+                    contentLength = strtoul(buff.Peek() + 16, nullptr, 10);
+                }
+            }
+            buff.RetrieveUntil(end + 2);
+        }
+    }
+};
+
+template<typename B>
+double Run(B& buff, const std::string& stream, const std::vector<size_t>& chunks, Parser* parser) {
+    Clock::time_point begin = Clock::now();
+    size_t pos = 0, i = 0;
+    while(pos < stream.size()) {
+        size_t n = std::min(chunks[i++ % chunks.size()], stream.size() - pos);
+        buff.Append(stream.data() + pos, n);
+        pos += n;
+        parser->Consume(buff);
+    }
+    return std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+}
+
+int main() {
+    srand(20261018);
+    std::vector<size_t> chunks(4096);
+    for(auto& c : chunks) c = 512 + rand() % (16 * 1024);      // TCP 分段大小
+
+    const size_t bodySizes[] = { 2 * 1024, 64 * 1024, 1024 * 1024 };
+    printf("%-28s %12s %12s %10s\n", "traffic", "Buffer(ms)", "Ring(ms)", "requests");
+    for(size_t bodySize : bodySizes) {
+        std::string stream = MakeTraffic(bodySize >= 1024 * 1024 ? 2000 : 100000, bodySize);
+        Parser p1, p2;
+        Buffer linear(16 * 1024);
+        RingBuffer ring(16 * 1024);
+        double linearMs = Run(linear, stream, chunks, &p1);
+        double ringMs = Run(ring, stream, chunks, &p2);
+        if(p1.requests != p2.requests || p1.headers != p2.headers) {
+            printf("parse mismatch: %zu/%zu vs %zu/%zu\n", p1.requests, p1.headers, p2.requests, p2.headers);
+            return 1;
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "mixed, body %zuKB (%zuMB)", bodySize / 1024, stream.size() >> 20);
+        printf("%-28s %12.1f %12.1f %10zu\n", name, linearMs, ringMs, p1.requests);
+    }
+    return 0;
+}
@@ -0,0 +1,147 @@
+/*
+线程池争用基准：8/16/32 个工作线程
+  reactor : 一个线程不停投递 bind(this, client) 形式的小任务（模拟 epoll 线程分发读写事件）
+  producers: 4 个外部线程同时投递
+  fan-out : 任务在工作线程里再派生子任务（工作线程自己提交，走本地队列）
+LegacyThreadPool 保留旧实现的关键行为（单队列 + 一把锁 + 每次 notify_one + std::function）作为对照
+*/
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <queue>
+#include <thread>
+#include <vector>
+#include "../code/pool/threadpool.h"
+
+class LegacyThreadPool {
+public:
+    explicit LegacyThreadPool(int threadCount) : pool_(std::make_shared<Pool>()) {
+        for(int i = 0; i < threadCount; i++) {
+            std::thread([pool = pool_]() {
+                std::unique_lock<std::mutex> locker(pool->mtx_);
+                while(true) {
+                    if(!pool->tasks.empty()) {
+                        auto task = std::move(pool->tasks.front());
+                        pool->tasks.pop();
+                        locker.unlock();
+                        task();
+                        locker.lock();
+                    } else if(pool->isClosed) {
+                        break;
+                    } else {
+                        pool->cond_.wait(locker);
+                    }
+                }
+            }).detach();
+        }
+    }
+    ~LegacyThreadPool() {
+        {
+            std::unique_lock<std::mutex> locker(pool_->mtx_);
+            pool_->isClosed = true;
+        }
+        pool_->cond_.notify_all();
+    }
+    template<typename T>
+    void AddTask(T&& task) {
+        std::unique_lock<std::mutex> locker(pool_->mtx_);
+        pool_->tasks.emplace(std::forward<T>(task));
+        pool_->cond_.notify_one();
+    }
+private:
+    struct Pool {
+        std::mutex mtx_;
+        std::condition_variable cond_;
+        bool isClosed = false;
+        std::queue<std::function<void()>> tasks;
+    };
+    std::shared_ptr<Pool> pool_;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+// 模拟 WebServer::OnRead_(client)：一点点计算
+struct Server {
+    std::atomic<size_t> done{0};
+    void OnEvent(size_t* client) {
+        size_t x = *client;
+        for(int i = 0; i < 64; i++) { x = x * 6364136223846793005ULL + 1442695040888963407ULL; }
+        *client = x;
+        done.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+static void WaitDone(Server& server, size_t total) {
+    while(server.done.load(std::memory_order_relaxed) < total) { std::this_thread::yield(); }
+}
+
+template<typename Pool>
+double BenchProducers(int threads, int producers, size_t tasksPerProducer) {
+    Server server;
+    std::vector<size_t> clients(1024);
+    Pool pool(threads);
+    Clock::time_point begin = Clock::now();
+    std::vector<std::thread> ths;
+    for(int p = 0; p < producers; p++) {
+        ths.emplace_back([&, p]() {
+            for(size_t i = 0; i < tasksPerProducer; i++) {
+                pool.AddTask(std::bind(&Server::OnEvent, &server, &clients[(p * 131 + i) % clients.size()]));
+            }
+        });
+    }
+    for(auto& t : ths) { t.join(); }
+    WaitDone(server, producers * tasksPerProducer);
+    return std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+}
+
+template<typename Pool>
+struct FanOut {
+    Pool* pool;
+    Server* server;
+    size_t* client;
+    void Spawn(int depth) {
+        server->OnEvent(client);
+        if(depth == 0) return;
+        for(int i = 0; i < 4; i++) {
+            pool->AddTask(std::bind(&FanOut::Spawn, this, depth - 1));
+        }
+    }
+};
+
+template<typename Pool>
+double BenchFanOut(int threads, int roots, int depth) {
+    Server server;
+    size_t client = 1;
+    Pool pool(threads);
+    FanOut<Pool> fan{&pool, &server, &client};
+    size_t perRoot = 0;
+    for(int d = 0, n = 1; d <= depth; d++, n *= 4) { perRoot += n; }
+    Clock::time_point begin = Clock::now();
+    for(int r = 0; r < roots; r++) {
+        pool.AddTask(std::bind(&FanOut<Pool>::Spawn, &fan, depth));
+    }
+    WaitDone(server, perRoot * roots);
+    return std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+}
+
+int main() {
+    const int threadCounts[] = { 8, 16, 32 };
+    printf("%-32s %12s %14s\n", "case", "legacy(ms)", "stealing(ms)");
+    for(int threads : threadCounts) {
+        char name[64];
+        snprintf(name, sizeof(name), "reactor x1M, %d threads", threads);
+        printf("%-32s %12.1f %14.1f\n", name,
+               BenchProducers<LegacyThreadPool>(threads, 1, 1000000),
+               BenchProducers<ThreadPool>(threads, 1, 1000000));
+        snprintf(name, sizeof(name), "4 producers x250k, %d threads", threads);
+        printf("%-32s %12.1f %14.1f\n", name,
+               BenchProducers<LegacyThreadPool>(threads, 4, 250000),
+               BenchProducers<ThreadPool>(threads, 4, 250000));
+        snprintf(name, sizeof(name), "fan-out 64x4^7, %d threads", threads);
+        printf("%-32s %12.1f %14.1f\n", name,
+               BenchFanOut<LegacyThreadPool>(threads, 64, 7),
+               BenchFanOut<ThreadPool>(threads, 64, 7));
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+/*
+定时器基准：10 万个连接定时器
+  add    : 逐个加入，超时 1~60s 随机
+  adjust : 100 万次随机挑一个连接重新计时（每次读写事件都会调一次）
+  expire : 全部换成 0~100ms 的短超时，等它们都到期后一次处理完
+HeapTimer 是原来的小根堆 + unordered_map + std::function，TimingWheel 是分层时间轮 + 侵入式结点 + 函数指针
+*/
+#include <stdio.h>
+#include <assert.h>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include "../code/timer/heaptimer.h"
+#include "../code/timer/timingwheel.h"
+
+typedef std::chrono::steady_clock BenchClock;
+
+static const int TIMERS = 100000;
+static const int ADJUSTS = 1000000;
+
+struct Result {
+    double addMs, adjustMs, expireMs;
+    size_t fired;
+};
+
+static double Since(BenchClock::time_point begin) {
+    return std::chrono::duration<double, std::milli>(BenchClock::now() - begin).count();
+}
+
+static Result BenchHeap(const std::vector<int>& timeouts, const std::vector<int>& picks, const std::vector<int>& shorts) {
+    HeapTimer timer;
+    size_t fired = 0;
+    Result r;
+    BenchClock::time_point begin = BenchClock::now();
+    for(int i = 0; i < TIMERS; i++) {
+        timer.add(i, timeouts[i], [&fired]() { fired++; });
+    }
+    r.addMs = Since(begin);
+
+    begin = BenchClock::now();
+    for(int i = 0; i < ADJUSTS; i++) {
+        timer.adjust(picks[i], timeouts[i % TIMERS]);
+    }
+    r.adjustMs = Since(begin);
+
+    for(int i = 0; i < TIMERS; i++) {
+        timer.add(i, shorts[i], [&fired]() { fired++; });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(120));
+    begin = BenchClock::now();
+    timer.GetNextTick();
+    r.expireMs = Since(begin);
+    r.fired = fired;
+    return r;
+}
+
+static void CountFired(void* ctx, void*) { (*static_cast<size_t*>(ctx))++; }
+
+static Result BenchWheel(const std::vector<int>& timeouts, const std::vector<int>& picks, const std::vector<int>& shorts) {
+    TimingWheel timer;
+    std::vector<WheelNode> nodes(TIMERS);   // 服务器里结点嵌在 HttpConn 中
+    size_t fired = 0;
+    Result r;
+    BenchClock::time_point begin = BenchClock::now();
+    for(int i = 0; i < TIMERS; i++) {
+        timer.Add(&nodes[i], timeouts[i], CountFired, &fired, nullptr);
+    }
+    r.addMs = Since(begin);
+
+    begin = BenchClock::now();
+    for(int i = 0; i < ADJUSTS; i++) {
+        timer.Adjust(&nodes[picks[i]], timeouts[i % TIMERS]);
+    }
+    r.adjustMs = Since(begin);
+
+    for(int i = 0; i < TIMERS; i++) {
+        timer.Adjust(&nodes[i], shorts[i]);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(120));
+    begin = BenchClock::now();
+    timer.GetNextTick();
+    r.expireMs = Since(begin);
+    r.fired = fired;
+    return r;
+}
+
+int main() {
+    std::mt19937 rng(1);
+    std::vector<int> timeouts(TIMERS), picks(ADJUSTS), shorts(TIMERS);
+    for(int& t : timeouts) { t = 1000 + rng() % 59000; }
+    for(int& p : picks) { p = rng() % TIMERS; }
+    for(int& t : shorts) { t = rng() % 100; }
+
+    Result heap = BenchHeap(timeouts, picks, shorts);
+    Result wheel = BenchWheel(timeouts, picks, shorts);
+    assert(heap.fired == TIMERS && wheel.fired == TIMERS);
+
+    printf("%d timers, %d adjusts\n", TIMERS, ADJUSTS);
+    printf("%-12s %10s %12s %12s\n", "", "add ms", "adjust ns", "expire ms");
+    printf("%-12s %10.2f %12.1f %12.2f\n", "HeapTimer", heap.addMs, heap.adjustMs * 1e6 / ADJUSTS, heap.expireMs);
+    printf("%-12s %10.2f %12.1f %12.2f\n", "TimingWheel", wheel.addMs, wheel.adjustMs * 1e6 / ADJUSTS, wheel.expireMs);
+    return 0;
+}
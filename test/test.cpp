@@ -1,12 +1,381 @@
 #include "../code/log/log.h"
 #include "../code/pool/threadpool.h"
+#include "../code/pool/executors.h"
+#include "../code/http/httprequest.h"
+#include "../code/http/httpconn.h"
+#include "../code/server/conntask.h"
+#include "../code/hls/rangeindex.h"
 #include <features.h>
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+#include <sys/socket.h>
 
 #if __GLIBC__ == 2 && __GLIBC_MINOR__ < 30
 #include <sys/syscall.h>
 #define gettid() syscall(SYS_gettid)
 #endif
 
+// 统计全局堆分配次数，检查请求路径上还剩多少次 malloc
+static std::atomic<size_t> allocCount(0);
+
+void* operator new(size_t size) {
+    allocCount++;
+    void* p = malloc(size ? size : 1);
+    if(!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// 解析请求行/请求头 -> 截取视频 id -> 读 Range -> 复位，arena 预热后每个请求应当不再 malloc
+void TestRequestAlloc() {
+    const std::string req = "GET /vid_1769671677_9383/720p/index007.ts HTTP/1.1\r\n"
+        "Host: 127.0.0.1:1316\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko)\r\n"
+        "Accept: */*\r\nAccept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+        "Referer: http://127.0.0.1:1316/video.html\r\nRange: bytes=0-1023\r\n\r\n";
+    const int WARMUP = 16, ROUNDS = 10000;
+    HttpRequest request;
+    StreamBuffer readBuff;
+    size_t allocs = 0;
+    for(int i = 0; i < WARMUP + ROUNDS; i++) {
+        size_t before = allocCount;
+        readBuff.Append(req.data(), req.size());
+        bool more = request.my_parse(readBuff);
+        const HttpRequest::String& id = request.re_path();
+        std::string_view range = request.GetHeader("range");
+        std::string_view agent = request.GetHeader("user-agent");
+        assert(!more && id == "vid_1769671677_9383");
+        assert(range == "bytes=0-1023" && agent.size() > 60);
+        (void)more; (void)agent;
+        readBuff.RetrieveAll();
+        request.Init();
+        if(i >= WARMUP) allocs += allocCount - before;
+    }
+    printf("request allocations: %.2f per request (%d requests)\n", (double)allocs / ROUNDS, ROUNDS);
+    assert(allocs == 0);
+}
+
+// 协程帧从 FramePool 分配：预热后创建、运行到结束再销毁一个连接协程不应再 malloc
+static ConnTask CountTask(int* counter, std::string_view name) {
+    char local[256];    // 帧里有较大的局部变量
+    snprintf(local, sizeof(local), "%.*s", (int)name.size(), name.data());
+    *counter += local[0] == 'c';
+    co_return;
+}
+
+void TestFramePool() {
+    const int WARMUP = 16, ROUNDS = 10000;
+    int counter = 0;
+    size_t allocs = 0;
+    for(int i = 0; i < WARMUP + ROUNDS; i++) {
+        size_t before = allocCount;
+        CountTask(&counter, "conn");
+        if(i >= WARMUP) allocs += allocCount - before;
+    }
+    printf("coroutine frame allocations: %.2f per task, %zu cached\n", (double)allocs / ROUNDS, FramePool::Cached());
+    assert(counter == WARMUP + ROUNDS && allocs == 0 && FramePool::Cached() > 0);
+}
+
+// 连接在各阶段交回 epoll 时应当落到的超时分类：新连接/半个请求头 -> header，响应没写完 -> write，
+// 保活发完 -> idle，带 multipart 请求体的 POST -> upload
+void TestTimeoutClass() {
+    int fds[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    HttpConn::srcDir = "./";
+    HttpConn conn;
+    conn.init(fds[0], sockaddr_in());
+    int err = 0;
+    auto feed = [&](const char* data) {
+        assert(send(fds[1], data, strlen(data), 0) == (ssize_t)strlen(data));
+        return conn.my_process(conn.read(&err));
+    };
+    assert(conn.CurrentTimeoutClass() == HttpConn::TIMEOUT_HEADER);
+    assert(feed("GET /vid_1/index.m3u8 HTTP/1.1\r\nHo"));
+    assert(conn.CurrentTimeoutClass() == HttpConn::TIMEOUT_HEADER);
+    assert(!feed("st: x\r\n\r\n"));
+    conn.BuildBusyResponse();
+    assert(conn.CurrentTimeoutClass() == HttpConn::TIMEOUT_WRITE);
+    while(conn.ToWriteBytes() > 0) { assert(conn.write(&err) > 0); }
+    assert(conn.BytesSent() > 0);
+    conn.ReleaseIdle();
+    assert(conn.CurrentTimeoutClass() == HttpConn::TIMEOUT_IDLE);
+    assert(feed("POST /upload HTTP/1.1\r\nContent-Type: multipart/form-data; boundary=xyz\r\n"
+                "Content-Length: 100000\r\n\r\n"));
+    assert(conn.CurrentTimeoutClass() == HttpConn::TIMEOUT_UPLOAD);
+    conn.Close();
+    close(fds[1]);
+    printf("timeout classes: ok\n");
+}
+
+// 完成请求的 JSON 只在可读区里找：同一个连接的缓冲区复用后，可读区之外还留着上一个请求的字节
+void TestUploadComplete() {
+    StreamBuffer buff;
+    const char* first = "POST /upload/complete HTTP/1.1\r\nContent-Type: application/json\r\n\r\n"
+                        "{\"upload_id\":\"upload-first-0123456789\",\"filename\":\"first-video.mp4\",\"total_chunks\":12}";
+    const char* second = "POST /upload/complete HTTP/1.1\r\n\r\n{\"upload_id\":\"u2\"}";
+    HttpRequest::UploadCompletion done;
+    buff.Append(first, strlen(first));
+    HttpRequest::ParseUploadComplete(buff, &done);
+    assert(done.uploadId == "upload-first-0123456789" && done.filename == "first-video.mp4" && done.totalChunks == 12);
+    assert(buff.ReadableBytes() == 0);
+    buff.RetrieveAll();
+    buff.Append(second, strlen(second));
+    HttpRequest::ParseUploadComplete(buff, &done);
+    assert(done.uploadId == "u2" && done.filename.empty() && done.totalChunks == -1);
+    assert(buff.ReadableBytes() == 0);
+    printf("upload complete: ok\n");
+}
+
+// Range：206 的区间和 sendfile 长度、不可满足时 416、格式不支持时退回整个文件 200
+void TestRange() {
+    mkdir("./testrange", 0777);
+    FILE* fp = fopen("./testrange/seg.ts", "wb");
+    assert(fp);
+    std::string content(1000, 'x');
+    fwrite(content.data(), 1, content.size(), fp);
+    fclose(fp);
+    fp = fopen("./testrange/empty.ts", "wb");
+    assert(fp);
+    fclose(fp);
+
+    struct Case {
+        const char* path;
+        const char* range;
+        int code;
+        size_t body;
+        const char* contentRange;   // nullptr 表示不应该有 Content-Range
+    } cases[] = {
+        { "./testrange/seg.ts", "", 200, 1000, nullptr },
+        { "./testrange/seg.ts", "bytes=0-99", 206, 100, "Content-Range: bytes 0-99/1000\r\n" },
+        { "./testrange/seg.ts", "bytes=-100", 206, 100, "Content-Range: bytes 900-999/1000\r\n" },
+        { "./testrange/seg.ts", "bytes=-5000", 206, 1000, "Content-Range: bytes 0-999/1000\r\n" },     // 后缀比文件长
+        { "./testrange/seg.ts", "bytes=900-", 206, 100, "Content-Range: bytes 900-999/1000\r\n" },
+        { "./testrange/seg.ts", "bytes=900-5000", 206, 100, "Content-Range: bytes 900-999/1000\r\n" },  // 结束位置截到文件尾
+        { "./testrange/seg.ts", "bytes=1000-", 416, 0, "Content-Range: bytes */1000\r\n" },
+        { "./testrange/seg.ts", "bytes=5000-6000", 416, 0, "Content-Range: bytes */1000\r\n" },
+        { "./testrange/seg.ts", "bytes=abc-", 200, 1000, nullptr },
+        { "./testrange/seg.ts", "bytes=50-10", 200, 1000, nullptr },
+        { "./testrange/seg.ts", "bytes=0-1,5-9", 200, 1000, nullptr },  // 多区间不支持
+        { "./testrange/seg.ts", "items=0-9", 200, 1000, nullptr },
+        { "./testrange/empty.ts", "", 200, 0, nullptr },
+        { "./testrange/empty.ts", "bytes=0-", 416, 0, "Content-Range: bytes */0\r\n" },
+        { "./testrange/empty.ts", "bytes=-10", 416, 0, "Content-Range: bytes */0\r\n" },
+        { "./testrange/missing.ts", "", 404, 0, nullptr },              // 不存在的文件也要带 Content-Length
+        { "./testrange/missing.ts", "bytes=0-99", 404, 0, nullptr },
+        { "./testrange", "", 404, 0, nullptr },                         // 目录能 stat 但读不出内容
+    };
+    for(const Case& c : cases) {
+        HttpResponse resp;
+        resp.Init("./", c.path, false, 200);
+        Buffer buff;
+        resp.MakeResponse_my(buff, c.path, c.range);
+        std::string head = buff.RetrieveAllToStr();
+        assert(resp.Code() == c.code);
+        assert(resp.BodyRemain() == c.body);
+        assert(head.find("Content-Length: " + std::to_string(c.body) + "\r\n") != std::string::npos);
+        if(c.contentRange) {
+            assert(head.find(c.contentRange) != std::string::npos);
+        } else {
+            assert(head.find("Content-Range") == std::string::npos);
+        }
+    }
+    printf("range: ok\n");
+}
+
+// 单文件存储的分片名映射：转码中的列表变长后能取到新分片，非单文件列表、不存在的目录都返回 false
+void TestRangeIndex() {
+    mkdir("./testrangeindex", 0777);
+    mkdir("./testrangeindex/single", 0777);
+    mkdir("./testrangeindex/multi", 0777);
+    FILE* fp = fopen("./testrangeindex/single/index.m3u8", "w");
+    assert(fp);
+    fputs("#EXTM3U\n#EXT-X-PLAYLIST-TYPE:EVENT\n#EXTINF:4.0,\n#EXT-X-BYTERANGE:1000@0\nindex.ts\n", fp);
+    fclose(fp);
+    fp = fopen("./testrangeindex/multi/index.m3u8", "w");
+    assert(fp);
+    fputs("#EXTM3U\n#EXTINF:4.0,\nindex0.ts\n#EXT-X-ENDLIST\n", fp);
+    fclose(fp);
+
+    RangeIndex* index = RangeIndex::Instance();
+    std::string file;
+    uint64_t off = 0, len = 0;
+    assert(index->Resolve("./testrangeindex/single/index0.ts", &file, &off, &len));
+    assert(file == "./testrangeindex/single/index.ts" && off == 0 && len == 1000);
+    assert(!index->Resolve("./testrangeindex/single/index1.ts", &file, &off, &len));
+
+    // 追加一段并结束，列表大小变了，缓存失效
+    fp = fopen("./testrangeindex/single/index.m3u8", "a");
+    assert(fp);
+    fputs("#EXTINF:4.0,\n#EXT-X-BYTERANGE:500\nindex.ts\n#EXT-X-ENDLIST\n", fp);
+    fclose(fp);
+    assert(index->Resolve("./testrangeindex/single/index1.ts", &file, &off, &len));
+    assert(off == 1000 && len == 500);
+
+    assert(!index->Resolve("./testrangeindex/multi/index0.ts", &file, &off, &len));
+    assert(!index->Resolve("./testrangeindex/multi/index0.ts", &file, &off, &len));
+    assert(!index->Resolve("./testrangeindex/missing/index0.ts", &file, &off, &len));
+    printf("range index: ok\n");
+}
+
+// 保活：HTTP/1.1 默认保活、Connection 不区分大小写；真实的请求、响应写完后按服务器的做法进入 idle 超时
+void TestKeepAlive() {
+    struct Case { const char* request; bool keepAlive; } cases[] = {
+        { "GET /vid_1/index.m3u8 HTTP/1.1\r\nHost: x\r\n\r\n", true },
+        { "GET /vid_1/index.m3u8 HTTP/1.1\r\nConnection: Keep-Alive\r\n\r\n", true },
+        { "GET /vid_1/index.m3u8 HTTP/1.1\r\nConnection: Close\r\n\r\n", false },
+        { "GET /vid_1/index.m3u8 HTTP/1.0\r\n\r\n", false },
+        { "GET /vid_1/index.m3u8 HTTP/1.0\r\nconnection: upgrade, keep-alive\r\n\r\n", true },
+    };
+    HttpConn::srcDir = "./";
+    for(const Case& c : cases) {
+        int fds[2], err = 0;
+        assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+        HttpConn conn;
+        conn.init(fds[0], sockaddr_in());
+        for(int round = 0; round < 2; round++) {    // 保活连接上的第二个请求走同一条路径
+            assert(send(fds[1], c.request, strlen(c.request), 0) == (ssize_t)strlen(c.request));
+            assert(!conn.my_process(conn.read(&err)));
+            assert(conn.IsKeepAlive() == c.keepAlive);
+            conn.BuildBusyResponse();
+            while(conn.ToWriteBytes() > 0) { assert(conn.write(&err) > 0); }
+            char resp[1024];
+            ssize_t n = recv(fds[1], resp, sizeof(resp) - 1, 0);
+            assert(n > 0);
+            resp[n] = '\0';
+            assert(strstr(resp, c.keepAlive ? "Connection: keep-alive" : "Connection: close"));
+            if(!c.keepAlive) { break; }
+            conn.ReleaseIdle();     // 同 WebServer::OnWrite_ / Serve_ 的保活分支
+            assert(conn.CurrentTimeoutClass() == HttpConn::TIMEOUT_IDLE);
+        }
+        conn.Close();
+        close(fds[1]);
+    }
+    printf("keep-alive: ok\n");
+}
+
+// 访问日志：一条记录的格式，以及采样的请求从解析到写完 / 中途关闭各记一行
+void TestAccessLog() {
+    AccessLog::Record rec;
+    rec.wallNs = 1000000000ull * 1700000000 + 123456000;
+    rec.stage[AccessLog::STAGE_START] = 5000000;
+    rec.stage[AccessLog::STAGE_PARSED] = 5012000;
+    rec.stage[AccessLog::STAGE_BUILT] = 5340000;
+    rec.ip = htonl(0x0a000002);
+    rec.port = 5555;
+    rec.status = 206;
+    rec.bytes = 123456;
+    AccessLog::Copy(rec.video, sizeof(rec.video), "vid_7");
+    AccessLog::Copy(rec.path, sizeof(rec.path), "/720p/seg_3.ts");
+    char line[320];
+    std::string text(line, AccessLog::Format(rec, line, sizeof(line)));
+    assert(text.substr(text.find('\t')) == "\t10.0.0.2:5555\tvid_7\t720p\tseg_3.ts\t206\t123456\t12\t340\t-\t-\tok\n");
+
+    AccessLog::Instance()->Init("./testaccess", 1);
+    HttpConn::srcDir = "./";
+    sockaddr_in addr = sockaddr_in();
+    addr.sin_addr.s_addr = htonl(0x0a000003);
+    addr.sin_port = htons(4444);
+    const char* requests[] = { "GET /vid_8/480p/seg_1.ts HTTP/1.1\r\n\r\n", "GET /vid_9/master.m3u8 HTTP/1.1\r\n\r\n" };
+    for(int i = 0; i < 2; i++) {
+        int fds[2], err = 0;
+        assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+        HttpConn conn;
+        conn.init(fds[0], addr);
+        assert(send(fds[1], requests[i], strlen(requests[i]), 0) == (ssize_t)strlen(requests[i]));
+        assert(!conn.my_process(conn.read(&err)));
+        conn.BuildBusyResponse();
+        while(i == 0 && conn.ToWriteBytes() > 0) { assert(conn.write(&err) > 0); }
+        conn.Close();   // 第二个请求没写就关了
+        close(fds[1]);
+    }
+
+    time_t now = time(nullptr);
+    struct tm t;
+    localtime_r(&now, &t);
+    char path[64];
+    snprintf(path, sizeof(path), "./testaccess/%04d_%02d_%02d.access", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
+    std::string data;
+    for(int wait = 0; wait < 100; wait++) {    // 后台线程异步写
+        FILE* fp = fopen(path, "r");
+        if(fp) {
+            data.assign(1 << 16, '\0');
+            data.resize(fread(&data[0], 1, data.size(), fp));
+            fclose(fp);
+            if(data.find("vid_9") != std::string::npos) { break; }
+        }
+        usleep(10000);
+    }
+    assert(data.find("\t10.0.0.3:4444\tvid_8\t480p\tseg_1.ts\t503\t") != std::string::npos);
+    assert(data.find("\tvid_9\t-\tmaster.m3u8\t503\t0\t") != std::string::npos);
+    assert(data.find("\taborted\n") != std::string::npos);
+    printf("access log: ok\n");
+}
+
+// 二进制日志解码出来的每一行和文本日志相同（时间戳除外）
+void TestBinaryLog() {
+    Log::Instance()->init(0, "./testbinlog", ".blog", 0, true);
+    LOG_INFO("Client[%d](%s:%d) in, userCount:%d", 7, "10.0.0.1", 5555, 3);
+    LOG_WARN("live:%zuKB pooled:%zuKB %.2f%% %ld", (size_t)12, (size_t)34, 56.789, -9L);
+    LOG_ERROR("%-6s|%5d|%x|%c|%*d", "ab", 42, 255u, 'z', 4, 1);
+    LOG_DEBUG("no args");
+    const char* expect[] = {
+        "[info] : Client[7](10.0.0.1:5555) in, userCount:3",
+        "[warn] : live:12KB pooled:34KB 56.79% -9",
+        "[error]: ab    |   42|ff|z|   1",
+        "[debug]: no args",
+    };
+
+    time_t now = time(nullptr);
+    struct tm t;
+    localtime_r(&now, &t);
+    char path[64];
+    snprintf(path, sizeof(path), "./testbinlog/%04d_%02d_%02d.blog", t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
+    FILE* fp = fopen(path, "rb");
+    assert(fp);
+    std::string data(1 << 20, '\0'), text;
+    data.resize(fread(&data[0], 1, data.size(), fp));
+    fclose(fp);
+    long n = BinLog::Decode(data.data(), data.size(), &text);
+    assert(n >= 4);
+    std::vector<std::string> lines;
+    for(size_t pos = 0, end; (end = text.find('\n', pos)) != std::string::npos; pos = end + 1) {
+        lines.push_back(text.substr(pos, end - pos));
+    }
+    for(int i = 0; i < 4; i++) {
+        const std::string& line = lines[lines.size() - 4 + i];
+        assert(line.size() > 27 && line.substr(27) == expect[i]);     // "YYYY-MM-DD HH:MM:SS.uuuuuu "
+    }
+    printf("binary log: %ld records decoded\n", n);
+}
+
+// 限流：同一秒里超过上限的只计数，下一秒第一条放行时带出压掉的条数；关掉的等级只读一次原子变量
+void TestLogLimiter() {
+    LogLimiter limiter;
+    uint64_t suppressed = 0;
+    int allowed = 0;
+    for(int i = 0; i < 100; i++) {
+        if(limiter.Allow(3, 1000, &suppressed)) { allowed++; }
+        assert(suppressed == 0);
+    }
+    assert(allowed == 3);
+    assert(limiter.Allow(3, 1001, &suppressed) && suppressed == 97);
+    assert(limiter.Allow(3, 1001, &suppressed) && suppressed == 0);
+
+    Log::Instance()->init(2, "./testlog1", ".log", 0);
+    assert(!Log::Instance()->Enabled(1) && Log::Instance()->Enabled(2));
+    int evaluated = 0;
+    LOG_INFO_LIMIT(1, "%d", evaluated++);
+    LOG_INFO("%d", evaluated++);
+    assert(evaluated == 0);     // 被过滤的调用点不求值参数
+    Log::Instance()->SetLevel(1);
+    for(int i = 0; i < 5; i++) { LOG_INFO_LIMIT(1, "limited %d", evaluated++); }
+    assert(evaluated >= 1 && evaluated < 5);    // 可能正好跨秒，多放一条
+    printf("log limiter: ok\n");
+}
+
 void TestLog() {
     int cnt = 0, level = 0;
     Log::Instance()->init(level, "./testlog1", ".log", 0);
@@ -30,6 +399,31 @@ void TestLog() {
     }
 }
 
+// 关闭执行器时其他线程还在提交：Close 之后的任务就地执行，已接受的任务一个不丢
+void TestExecutorsClose() {
+    for(int round = 0; round < 20; round++) {
+        ThreadPool net(2);
+        Executors* ex = Executors::Instance();
+        ex->Init(&net, 2, 2, 1, 1 << 20);
+        std::atomic<bool> stop(false);
+        std::atomic<size_t> accepted(0), done(0);
+        std::vector<std::thread> producers;
+        for(int i = 0; i < 4; i++) {
+            producers.emplace_back([&] {
+                while(!stop.load()) {
+                    if(ex->Db([] { return 1; }, [&](int) { done++; }, Executors::DISK)) { accepted++; }
+                }
+            });
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        ex->Close();
+        stop = true;
+        for(auto& t : producers) { t.join(); }
+        assert(done.load() == accepted.load());
+    }
+    printf("executors close: ok\n");
+}
+
 void ThreadLogTask(int i, int cnt) {
     for(int j = 0; j < 10000; j++ ){
         LOG_BASE(i,"PID:[%04d]======= %05d ========= ", gettid(), cnt++);
@@ -46,6 +440,17 @@ void TestThreadPool() {
 }
 
 int main() {
+    TestRequestAlloc();
+    TestFramePool();
+    TestTimeoutClass();
+    TestKeepAlive();
+    TestRange();
+    TestRangeIndex();
+    TestUploadComplete();
+    TestAccessLog();
+    TestBinaryLog();
+    TestLogLimiter();
+    TestExecutorsClose();
     TestLog();
     TestThreadPool();
 }
\ No newline at end of file